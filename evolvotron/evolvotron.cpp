@@ -50,6 +50,8 @@ int main(int argc,char* argv[])
   bool jitter;
   bool menuhide;
   uint multisample;
+  std::string precision;
+  real sample_budget;
   bool spheremap;
   std::vector<std::string> startup;
   bool startup_shuffle;
@@ -64,6 +66,8 @@ int main(int argc,char* argv[])
       ("jitter,j"     ,bool_switch(&jitter)                           ,"Enable rendering jitter")
       ("multisample,m",value<uint>(&multisample)->default_value(1)    ,"Multisampling grid (NxN)")
       ("menuhide,M"   ,bool_switch(&menuhide)                         ,"Hide menus")
+      ("precision"    ,value<std::string>(&precision)->default_value("double"),"Evaluation precision (float or double)")
+      ("sample-budget",value<real>(&sample_budget)->default_value(0.0),"Multisample adaptively, averaging at most this many samples per pixel (0 multisamples every pixel)")
       ("spheremap,p"  ,bool_switch(&spheremap)                        ,"Generate spheremaps")
       ("startup,S"    ,value<std::vector<std::string> >(&startup)     ,"Startup function (multiples allowed, or positional)")
       ("shuffle,U"    ,bool_switch(&startup_shuffle)                  ,"Shuffle startup functions")
@@ -163,6 +167,18 @@ int main(int argc,char* argv[])
       return 1;
     }
 
+  if (precision!="float" && precision!="double")
+    {
+      std::cerr << "--precision option argument must be float or double\n";
+      return 1;
+    }
+
+  if (sample_budget<0.0)
+    {
+      std::cerr << "--sample-budget must not be negative\n";
+      return 1;
+    }
+
   if (frames<1)
     {
       std::cerr << "Must specify at least 1 frame\n";
@@ -222,6 +238,8 @@ int main(int argc,char* argv[])
        autocool,
        jitter,
        multisample,
+       (precision=="float"),
+       sample_budget,
        debug,
        linear,
        spheremap,
@@ -0,0 +1,1223 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+/*! \file
+  \brief Benchmarks and self-checks of evolvotron's function evaluation and rendering machinery.
+*/
+
+#include "frame_renderer.h"
+#include "function_node_info.h"
+#include "function_profile.h"
+#include "function_registry.h"
+#include "function_top.h"
+#include "mutatable_image.h"
+#include "mutatable_image_computer_farm.h"
+#include "mutatable_image_computer_task.h"
+#include "mutation_parameters.h"
+#include "noise.h"
+#include "pass_tiling.h"
+#include "platform_specific.h"
+#include "random.h"
+#include "simd_kernels.h"
+#include "transform.h"
+
+#include <QBuffer>
+
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#include <boost/program_options.hpp>
+
+//! Time the noise generator at each octave of the multiscale noise functions, over points covering an image, and write the throughputs to a stream.
+/*! Compares evaluating a point at a time (as Function::evaluate does) with batches of a tile row (as the renderer's batch path does),
+  for one channel and for three.
+ */
+static void write_noise_benchmark(std::ostream& out,int width,int height)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  std::vector<XYZ> points;
+  for (int row=0;row<height;row++)
+    for (int col=0;col<width;col++)
+      points.push_back(XYZ(-1.0+2.0*(col+0.5)/width,1.0-2.0*(row+0.5)/height,0.0));
+  const size_t n=points.size();
+  const size_t batch=FrameRenderer::tile_side();
+
+  const Noise noise0(0);
+  const Noise noise1(1);
+  const Noise noise2(2);
+
+  out << "Million points per second\n";
+  out << "octave\tpoint\tbatch\tpoint x3\tbatch x3\n";
+  real check=0.0;
+  for (uint octave=0;octave<8;octave++)
+    {
+      const real k=(1<<octave);
+      std::vector<XYZ> kp(n);
+      for (size_t i=0;i<n;i++)
+	kp[i]=k*points[i];
+
+      std::vector<real> v(batch);
+      std::vector<XYZ> v3(batch);
+      Clock::duration t[4];
+
+      Clock::time_point t0=Clock::now();
+      for (size_t i=0;i<n;i++)
+	check+=noise0(kp[i]);
+      t[0]=Clock::now()-t0;
+
+      t0=Clock::now();
+      for (size_t i=0;i<n;i+=batch)
+	{
+	  const size_t m=std::min(batch,n-i);
+	  noise0(&kp[i],&v[0],m);
+	  check+=v[0];
+	}
+      t[1]=Clock::now()-t0;
+
+      t0=Clock::now();
+      for (size_t i=0;i<n;i++)
+	check+=noise0(kp[i])+noise1(kp[i])+noise2(kp[i]);
+      t[2]=Clock::now()-t0;
+
+      t0=Clock::now();
+      for (size_t i=0;i<n;i+=batch)
+	{
+	  const size_t m=std::min(batch,n-i);
+	  Noise::evaluate(noise0,noise1,noise2,&kp[i],&v3[0],m);
+	  check+=v3[0].x();
+	}
+      t[3]=Clock::now()-t0;
+
+      out << octave;
+      for (uint j=0;j<4;j++)
+	out << "\t" << n/std::chrono::duration<double,std::micro>(t[j]).count();
+      out << "\n";
+    }
+
+  // Octaves as summed by the multiscale noise functions:
+  // one batch call per octave, as they used to, against a single fused call.
+  out << "\n8 octave fBm, million points per second\n";
+  out << "channels\tloop\tfused\n";
+  for (uint channels=1;channels<=3;channels+=2)
+    {
+      std::vector<XYZ> kp(batch);
+      std::vector<XYZ> v3(batch);
+      std::vector<real> v(batch);
+      std::vector<real> t(batch);
+      Clock::duration times[2];
+
+      Clock::time_point t0=Clock::now();
+      for (size_t i=0;i<n;i+=batch)
+	{
+	  const size_t m=std::min(batch,n-i);
+	  for (uint octave=0;octave<8;octave++)
+	    {
+	      const real k=(1<<octave);
+	      for (size_t j=0;j<m;j++)
+		kp[j]=k*points[i+j];
+	      if (channels==1)
+		noise0(&kp[0],&v[0],m);
+	      else
+		Noise::evaluate(noise0,noise1,noise2,&kp[0],&v3[0],m);
+	      for (size_t j=0;j<m;j++)
+		t[j]=(octave==0 ? 0.0 : t[j])+(channels==1 ? v[j] : v3[j].x())/k;
+	    }
+	  check+=t[0];
+	}
+      times[0]=Clock::now()-t0;
+
+      t0=Clock::now();
+      for (size_t i=0;i<n;i+=batch)
+	{
+	  const size_t m=std::min(batch,n-i);
+	  if (channels==1)
+	    noise0.fbm(&points[i],&v[0],m,8);
+	  else
+	    Noise::fbm(noise0,noise1,noise2,&points[i],&v3[0],m,8);
+	  check+=(channels==1 ? v[0] : v3[0].x());
+	}
+      times[1]=Clock::now()-t0;
+
+      out << channels;
+      for (uint j=0;j<2;j++)
+	out << "\t" << n/std::chrono::duration<double,std::micro>(times[j]).count();
+      out << "\n";
+    }
+
+  // Using the values stops the evaluation being optimised away.
+  std::clog << "Noise checksum " << check << "\n";
+}
+
+//! Time one of write_kernel_benchmark's kernels (by index into its table of names) over n points in blocks, and return the time per point in nanoseconds.
+template <typename T> static double time_kernel(const SimdKernels::Table<T>& kernels,uint kernel,const T* k,const BasicXYZBlock<T>& a,const BasicXYZBlock<T>& b,BasicXYZBlock<T>& d,size_t n,real& check)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  const size_t m=3*a.stride();
+  const Clock::time_point t0=Clock::now();
+  for (size_t i=0;i<n;i+=a.size())
+    {
+      switch (kernel)
+	{
+	case 0: kernels.transform(k,a.data(),d.data(),a.stride()); break;
+	case 1: kernels.cone(a.data(),d.data(),a.stride()); break;
+	case 2: kernels.add(a.data(),b.data(),d.data(),m); break;
+	case 3: kernels.multiply(a.data(),b.data(),d.data(),m); break;
+	case 4: kernels.divide(a.data(),b.data(),d.data(),m); break;
+	case 5: kernels.maximum(a.data(),b.data(),d.data(),m); break;
+	case 6: kernels.minimum(a.data(),b.data(),d.data(),m); break;
+	case 7: kernels.exp(a.data(),d.data(),m); break;
+	case 8: kernels.sin(a.data(),d.data(),m); break;
+	case 9: kernels.cos(a.data(),d.data(),m); break;
+	}
+      check+=d.x()[0];
+    }
+  return std::chrono::duration<double,std::nano>(Clock::now()-t0).count()/n;
+}
+
+//! Time the batch kernels of each kernel set this CPU supports, over points covering an image, and write the times per point to a stream.
+/*! The points are processed in blocks of 256 (the length of the compute threads' runs) held in XYZBlocks,
+  as the function programs hold them.
+  Each kernel set has a column for its double precision kernels and one for its single precision ones
+  (the same points, rounded to float).
+  For comparison, the first row transforms the points one at a time from an array of XYZ with Transform::transformed,
+  as the batch path did before XYZBlock.
+ */
+static void write_kernel_benchmark(std::ostream& out,int width,int height)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  std::vector<const SimdKernels*> kernel_sets(1,&SimdKernels::scalar());
+  if (SimdKernels::sse2()) kernel_sets.push_back(SimdKernels::sse2());
+  if (SimdKernels::avx2()) kernel_sets.push_back(SimdKernels::avx2());
+
+  const size_t n=static_cast<size_t>(width)*height;
+  const size_t block=256;
+
+  Random01 r01(23);
+  std::vector<real> k(12);
+  for (uint i=0;i<12;i++)
+    k[i]=2.0*r01()-1.0;
+  const Transform transform(k);
+  const std::vector<float> kf(k.begin(),k.end());
+
+  XYZBlock a(block);
+  XYZBlock b(block);
+  XYZBlock d(block);
+  std::vector<XYZ> p(block);
+  std::vector<XYZ> q(block);
+  for (size_t i=0;i<block;i++)
+    {
+      a.set(i,XYZ(2.0*r01()-1.0,2.0*r01()-1.0,2.0*r01()-1.0));
+      b.set(i,XYZ(2.0*r01()-1.0,2.0*r01()-1.0,2.0*r01()-1.0));
+      p[i]=a[i];
+    }
+  XYZfBlock af(block);
+  XYZfBlock bf(block);
+  XYZfBlock df(block);
+  for (size_t i=0;i<block;i++)
+    {
+      af.set(i,XYZf(a[i]));
+      bf.set(i,XYZf(b[i]));
+    }
+
+  real check=0.0;
+  out << "Nanoseconds per point (" << block << " point blocks)\n";
+  out << "kernel";
+  for (size_t s=0;s<kernel_sets.size();s++)
+    out << "\t" << kernel_sets[s]->name << "\t" << kernel_sets[s]->name << " float";
+  out << "\n";
+
+  Clock::time_point t0=Clock::now();
+  for (size_t i=0;i<n;i+=block)
+    {
+      for (size_t j=0;j<block;j++)
+	q[j]=transform.transformed(p[j]);
+      check+=q[0].x();
+    }
+  out << "transformed\t" << std::chrono::duration<double,std::nano>(Clock::now()-t0).count()/n << "\n";
+
+  const char*const names[]={"transform","cone","add","multiply","divide","maximum","minimum","exp","sin","cos"};
+  for (uint kernel=0;kernel<sizeof(names)/sizeof(names[0]);kernel++)
+    {
+      out << names[kernel];
+      for (size_t s=0;s<kernel_sets.size();s++)
+	{
+	  out << "\t" << time_kernel(kernel_sets[s]->double_table,kernel,&k[0],a,b,d,n,check);
+	  out << "\t" << time_kernel(kernel_sets[s]->float_table,kernel,&kf[0],af,bf,df,n,check);
+	}
+      out << "\n";
+    }
+
+  // Using the values stops the evaluation being optimised away.
+  std::clog << "Kernel checksum " << check << "\n";
+}
+
+//! Time a compute farm rendering an image in small fragments, with from 1 to 64 threads, and write the throughputs to a stream.
+/*! The fragments are pushed with a spread of priorities (as from a number of displays' images of different costs),
+  and collected by polling the farm as the GUI thread does.
+  With 1x1 pixel fragments the time is mostly the farm's own overhead of queueing and handing over tasks;
+  with 16x16 ones it's mostly evaluating the function.
+ */
+static void write_farm_benchmark(std::ostream& out,int width,int height)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  MutationParameters mutation_parameters(23,false,false);
+  std::unique_ptr<FunctionTop> fn(FunctionTop::initial(mutation_parameters));
+  const boost::shared_ptr<const MutatableImage> image(new MutatableImage(fn,false,false,false));
+  const QSize size(width,height);
+
+  out << "Thousand fragments per second (" << width << "x" << height << " image)\n";
+  out << "threads\t1x1\t16x16\n";
+  for (uint threads=1;threads<=64;threads*=2)
+    {
+      out << threads;
+      for (int side=1;side<=16;side*=16)
+	{
+	  MutatableImageComputerFarm farm(threads,0);
+
+	  const int across=(width+side-1)/side;
+	  const int down=(height+side-1)/side;
+	  const uint fragments=across*down;
+
+	  const Clock::time_point t0=Clock::now();
+	  for (uint i=0;i<fragments;i++)
+	    {
+	      const int x=(i%across)*side;
+	      const int y=(i/across)*side;
+	      farm.push_todo
+		(
+		 boost::shared_ptr<MutatableImageComputerTask>
+		 (
+		  new MutatableImageComputerTask
+		  (
+		   0,
+		   image,
+		   (i*7919)%1000,
+		   QSize(x,y),
+		   QSize(std::min(side,width-x),std::min(side,height-y)),
+		   size,
+		   size,
+		   1,
+		   0,
+		   i,
+		   fragments,
+		   false,
+		   1,
+		   false,
+		   0.0,
+		   i,
+		   boost::shared_ptr<const MutatableImageComputerTask::Fragments>()
+		   )
+		  )
+		 );
+	    }
+
+	  uint done=0;
+	  while (done<fragments)
+	    {
+	      QThread::msleep(1);
+	      while (farm.pop_done())
+		done++;
+	    }
+	  out << "\t" << 1e-3*fragments/std::chrono::duration<double>(Clock::now()-t0).count();
+	}
+      out << "\n";
+    }
+}
+
+//! Time how long a compute farm's thread takes to abandon an expensive task when it's aborted, and write the latencies to a stream.
+/*! One thread computes a whole image (of a random function, 4x4 multisampled) as a single fragment,
+  which is aborted at a range of times after it's queued.
+  The latency is from MutatableImageComputerFarm::abort_all to the thread being idle again.
+  Compute threads poll for aborts after every run of up to 256 pixels,
+  so it should be within the time the thread takes for a run, which is written alongside.
+ */
+static void write_abort_benchmark(std::ostream& out,int width,int height)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  MutationParameters mutation_parameters(23,false,false);
+  std::unique_ptr<FunctionTop> fn(FunctionTop::initial(mutation_parameters));
+  const boost::shared_ptr<const MutatableImage> image(new MutatableImage(fn,false,false,false));
+  const QSize size(width,height);
+  const uint multisample=4;
+
+  out << "Abort latency (" << width << "x" << height << " image, " << multisample << "x" << multisample << " multisampled)\n";
+  out << "abort after ms\tpixels computed\tms per 256 pixels\tlatency ms\n";
+  for (uint delay=10;delay<=320;delay*=2)
+    {
+      MutatableImageComputerFarm farm(1,0);
+      const boost::shared_ptr<MutatableImageComputerTask> task
+	(
+	 new MutatableImageComputerTask
+	 (
+	  0,
+	  image,
+	  0,
+	  QSize(0,0),
+	  size,
+	  size,
+	  size,
+	  1,
+	  0,
+	  0,
+	  1,
+	  false,
+	  multisample,
+	  false,
+	  0.0,
+	  0,
+	  boost::shared_ptr<const MutatableImageComputerTask::Fragments>()
+	  )
+	 );
+
+      const Clock::time_point t0=Clock::now();
+      farm.push_todo(task);
+      QThread::msleep(delay);
+
+      const Clock::time_point t1=Clock::now();
+      farm.abort_all();
+      while (farm.tasks()>0)
+	{
+	  farm.pop_done();
+	  QThread::usleep(100);
+	}
+      const Clock::time_point t2=Clock::now();
+
+      out << delay;
+      if (task->completed())
+	{
+	  out << "\tcompleted before the abort\n";
+	  break;
+	}
+      const uint pixels=task->current_pixel();
+      out
+	<< "\t" << pixels
+	<< "\t" << (pixels ? 256.0*std::chrono::duration<double,std::milli>(t1-t0).count()/pixels : 0.0)
+	<< "\t" << std::chrono::duration<double,std::milli>(t2-t1).count()
+	<< "\n";
+    }
+}
+
+//! Compute a pass of an image as the given fragments on a compute farm, returning the wall clock time in seconds.
+/*! Fragments are pushed in order with increasing priorities, so the farm starts them in that order.
+  The completed tasks are appended to done (in the order they complete).
+ */
+static double compute_fragments(MutatableImageComputerFarm& farm,const boost::shared_ptr<const MutatableImage>& image,const QSize& render_size,const QSize& full_size,const std::vector<PassTiling::Region>& fragments,std::vector<boost::shared_ptr<const MutatableImageComputerTask> >& done)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  const Clock::time_point t0=Clock::now();
+  for (uint f=0;f<fragments.size();f++)
+    {
+      farm.push_todo
+	(
+	 boost::shared_ptr<MutatableImageComputerTask>
+	 (
+	  new MutatableImageComputerTask
+	  (
+	   0,
+	   image,
+	   f,
+	   QSize(static_cast<int>(fragments[f].x0),static_cast<int>(fragments[f].y0)),
+	   QSize(static_cast<int>(fragments[f].x1-fragments[f].x0),static_cast<int>(fragments[f].y1-fragments[f].y0)),
+	   render_size,
+	   full_size,
+	   1,
+	   0,
+	   f,
+	   fragments.size(),
+	   false,
+	   1,
+	   false,
+	   0.0,
+	   f,
+	   boost::shared_ptr<const MutatableImageComputerTask::Fragments>()
+	   )
+	  )
+	 );
+    }
+
+  const size_t target=done.size()+fragments.size();
+  while (done.size()<target)
+    {
+      QThread::usleep(100);
+      while (const boost::shared_ptr<const MutatableImageComputerTask> task=farm.pop_done())
+	done.push_back(task);
+    }
+  return std::chrono::duration<double>(Clock::now()-t0).count();
+}
+
+//! Time a compute farm computing an image in row strips and in cost-adapted tiles (as MutatableImageDisplay fragments passes), and write the times to a stream.
+/*! The cost map is measured, as the display measures it from an earlier pass,
+  from a half resolution pass of the image (of a random function) in an 8x8 grid of fragments.
+  The full resolution pass is then computed as 4 row strips per thread (as the display used to split passes)
+  and as the tiles PassTiling chooses from the cost map (as the display splits them now).
+  Utilisation is the threads' total compute time over the time they were available for.
+ */
+static void write_tiles_benchmark(std::ostream& out,int width,int height)
+{
+  MutationParameters mutation_parameters(23,false,false);
+  std::unique_ptr<FunctionTop> fn(FunctionTop::initial(mutation_parameters));
+  const boost::shared_ptr<const MutatableImage> image(new MutatableImage(fn,false,false,false));
+  const QSize size(width,height);
+  const QSize half_size((width+1)/2,(height+1)/2);
+
+  std::vector<PassTiling::Region> grid;
+  const int n=8;
+  for (int j=0;j<n;j++)
+    for (int i=0;i<n;i++)
+      {
+	const PassTiling::Region region=
+	  {
+	    real((half_size.width()*i)/n),
+	    real((half_size.height()*j)/n),
+	    real((half_size.width()*(i+1))/n),
+	    real((half_size.height()*(j+1))/n),
+	    0.0
+	  };
+	if (region.x1>region.x0 && region.y1>region.y0)
+	  grid.push_back(region);
+      }
+
+  std::vector<boost::shared_ptr<const MutatableImageComputerTask> > measured;
+  {
+    MutatableImageComputerFarm farm(1,0);
+    compute_fragments(farm,image,half_size,size,grid,measured);
+  }
+
+  // The cost map, in microseconds at full resolution (4 times the half resolution pixels).
+  std::vector<PassTiling::Region> regions;
+  real pass_cost=0.0;
+  real most_expensive=0.0;
+  for (uint f=0;f<measured.size();f++)
+    {
+      const MutatableImageComputerTask& fragment=*measured[f];
+      const PassTiling::Region region=
+	{
+	  2.0*fragment.fragment_origin().width(),
+	  2.0*fragment.fragment_origin().height(),
+	  2.0*(fragment.fragment_origin().width()+fragment.fragment_size().width()),
+	  2.0*(fragment.fragment_origin().height()+fragment.fragment_size().height()),
+	  4e-3*fragment.compute_time()
+	};
+      regions.push_back(region);
+      pass_cost+=region.cost;
+      most_expensive=std::max(most_expensive,region.cost);
+    }
+
+  out << "Row strips vs cost-adapted tiles (" << width << "x" << height << " image, estimated " << 1e-3*pass_cost << "ms";
+  out << ", most expensive 1/" << n*n << " of it " << (pass_cost>0.0 ? most_expensive*measured.size()/pass_cost : 0.0) << " times the average)\n";
+  out << "threads\tstrips\tstrips ms\tstrips utilisation\ttiles\ttiles ms\ttiles utilisation\n";
+  for (uint threads=1;threads<=64;threads*=2)
+    {
+      std::vector<PassTiling::Region> strips;
+      const int nstrips=std::min(4*static_cast<int>(threads),height);
+      for (int s=0;s<nstrips;s++)
+	{
+	  const PassTiling::Region strip={0.0,real((height*s)/nstrips),real(width),real((height*(s+1))/nstrips),0.0};
+	  strips.push_back(strip);
+	}
+
+      std::vector<PassTiling::Region> tiles;
+      PassTiling::split(width,height,std::max(1000.0,pass_cost/(4*threads)),16,regions,tiles);
+
+      out << threads;
+      const std::vector<PassTiling::Region>*const passes[2]={&strips,&tiles};
+      for (uint p=0;p<2;p++)
+	{
+	  MutatableImageComputerFarm farm(threads,0);
+	  std::vector<boost::shared_ptr<const MutatableImageComputerTask> > done;
+	  const double wall=compute_fragments(farm,image,size,size,*passes[p],done);
+
+	  real busy=0.0;
+	  for (uint f=0;f<done.size();f++)
+	    busy+=1e-9*done[f]->compute_time();
+
+	  out << "\t" << passes[p]->size() << "\t" << 1e3*wall << "\t" << 100.0*busy/(wall*threads) << "%";
+	}
+      out << "\n";
+    }
+}
+
+//! Time computing the single sampled resolution levels of images with and without reusing the previous level's samples, and write the times to a stream.
+/*! Each of a number of random functions' images is computed as a sequence of levels (as MutatableImageDisplay computes its passes),
+  from the lowest resolution at least 4x4 up to full resolution, each level a single fragment, on a one thread compute farm;
+  once with each level's tasks given the previous level's fragments (so they can copy a quarter of their samples from it) and once without.
+  The times are the compute thread's time for each level, summed over the images.
+  The full resolution images should be identical either way.
+ */
+static void write_levels_benchmark(std::ostream& out,int width,int height)
+{
+  const QSize size(width,height);
+  const uint images=10;
+
+  std::vector<uint> levels;
+  std::vector<QSize> level_sizes;
+  for (int level=12;level>=0;level--)
+    {
+      const int s=(1<<level);
+      const QSize render_size((width+s-1)/s,(height+s-1)/s);
+      if ((render_size.width()>=4 && render_size.height()>=4) || level==0)
+	{
+	  levels.push_back(level);
+	  level_sizes.push_back(render_size);
+	}
+    }
+
+  std::vector<real> times[2];
+  times[0].resize(levels.size(),0.0);
+  times[1].resize(levels.size(),0.0);
+  bool identical=true;
+
+  for (uint i=0;i<images;i++)
+    {
+      MutationParameters mutation_parameters(23+i,false,false);
+      std::unique_ptr<FunctionTop> fn(FunctionTop::initial(mutation_parameters));
+      const boost::shared_ptr<const MutatableImage> image(new MutatableImage(fn,false,false,false));
+
+      QImage full_resolution[2];
+      for (uint reuse=0;reuse<2;reuse++)
+	{
+	  MutatableImageComputerFarm farm(1,0);
+
+	  std::vector<boost::shared_ptr<MutatableImageComputerTask> > tasks;
+	  boost::shared_ptr<MutatableImageComputerTask::Fragments> previous_pass;
+	  for (uint l=0;l<levels.size();l++)
+	    {
+	      const boost::shared_ptr<MutatableImageComputerTask> task
+		(
+		 new MutatableImageComputerTask
+		 (
+		  0,
+		  image,
+		  l,
+		  QSize(0,0),
+		  level_sizes[l],
+		  level_sizes[l],
+		  size,
+		  1,
+		  levels[l],
+		  0,
+		  1,
+		  false,
+		  1,
+		  false,
+		  0.0,
+		  l,
+		  (reuse ? previous_pass : boost::shared_ptr<MutatableImageComputerTask::Fragments>())
+		  )
+		 );
+	      previous_pass.reset(new MutatableImageComputerTask::Fragments(1,task));
+	      tasks.push_back(task);
+	      farm.push_todo(task);
+	    }
+
+	  uint done=0;
+	  while (done<tasks.size())
+	    {
+	      QThread::msleep(1);
+	      while (farm.pop_done())
+		done++;
+	    }
+
+	  for (uint l=0;l<levels.size();l++)
+	    times[reuse][l]+=1e-6*tasks[l]->compute_time();
+	  full_resolution[reuse]=tasks.back()->images()[0];
+	}
+      identical=(identical && full_resolution[0]==full_resolution[1]);
+    }
+
+  out << "Single sampled levels with and without reusing the previous level's samples (" << width << "x" << height << " image, " << images << " random functions)\n";
+  out << "level\tpixels\tms\tms reusing\n";
+  uint total_pixels=0;
+  real total_times[2]={0.0,0.0};
+  for (uint l=0;l<levels.size();l++)
+    {
+      const uint pixels=level_sizes[l].width()*level_sizes[l].height();
+      out << levels[l] << "\t" << pixels << "\t" << times[0][l] << "\t" << times[1][l] << "\n";
+      total_pixels+=pixels;
+      total_times[0]+=times[0][l];
+      total_times[1]+=times[1][l];
+    }
+  out << "total\t" << total_pixels << "\t" << total_times[0] << "\t" << total_times[1] << "\n";
+  out << "Full resolution images " << (identical ? "identical" : "DIFFER") << "\n";
+}
+
+//! Encode a frame's image (0xRRGGBB pixels in row order) as a PNG in memory, as saving it to a .png file would.
+static void encode_frame(const std::vector<uint>& image_data,int width,int height)
+{
+  const QImage image
+    (
+     reinterpret_cast<const uchar*>(&(image_data[0])),
+     width,
+     height,
+     QImage::Format_RGB32
+     );
+
+  QByteArray bytes;
+  QBuffer buffer(&bytes);
+  buffer.open(QIODevice::WriteOnly);
+  image.save(&buffer,"PNG");
+}
+
+//! Time rendering and encoding an animation's frames one after another and pipelined through a FrameRenderer, and write the frame rates to a stream.
+/*! The frames of a random function are encoded as PNGs (in memory, so the disk doesn't come into it).
+  One after another, the time is that to render all the frames (taking each as soon as it's completed, and keeping them)
+  plus that to encode them all afterwards.
+  Pipelined, a FrameRenderer renders the frames while this thread encodes those completed, as rendering to files does.
+ */
+static void write_frames_benchmark(std::ostream& out,int width,int height,uint frames,uint threads)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  MutationParameters mutation_parameters(23,false,false);
+  std::unique_ptr<FunctionTop> fn(FunctionTop::initial(mutation_parameters));
+  const boost::shared_ptr<const MutatableImage> image(new MutatableImage(fn,false,false,false));
+
+  std::vector<std::vector<uint> > rendered(frames);
+  const Clock::time_point t0=Clock::now();
+  {
+    FrameRenderer renderer(*image,width,height,frames,false,1,false,0.0,threads,height,false);
+    for (uint frame=0;frame<frames;frame++)
+      renderer.take_band(rendered[frame]);
+  }
+  const Clock::time_point t1=Clock::now();
+  for (uint frame=0;frame<frames;frame++)
+    encode_frame(rendered[frame],width,height);
+  const Clock::time_point t2=Clock::now();
+  rendered.clear();
+
+  const double render_time=std::chrono::duration<double>(t1-t0).count();
+  const double encode_time=std::chrono::duration<double>(t2-t1).count();
+
+  std::vector<uint> image_data;
+  const Clock::time_point t3=Clock::now();
+  {
+    FrameRenderer renderer(*image,width,height,frames,false,1,false,0.0,threads,height,false);
+    for (uint frame=0;frame<frames;frame++)
+      {
+	renderer.take_band(image_data);
+	encode_frame(image_data,width,height);
+      }
+  }
+  const double pipelined_time=std::chrono::duration<double>(Clock::now()-t3).count();
+
+  out << "Rendering and encoding " << frames << " frames (" << width << "x" << height << " PNG, " << threads << " threads)\n";
+  out << "render ms per frame\tencode ms per frame\tserial fps\tpipelined fps\n";
+  out
+    << 1e3*render_time/frames
+    << "\t" << 1e3*encode_time/frames
+    << "\t" << frames/(render_time+encode_time)
+    << "\t" << frames/pipelined_time
+    << "\n";
+}
+
+//! Build a chain of nodes from type names (outermost first, the last a leaf) for write_stencil_benchmark.
+/*! Iterative types are given their iteration count after a colon (FunctionAverageRing:16).
+  Function types with parameters get fixed ones: a FunctionGradient's channel weights, a FunctionFilter3D's sample spacings,
+  a ring's radius, a kaleidoscope's or windmill's sectors (5 of them) or a FunctionTransform's rotation and shift.
+ */
+static std::unique_ptr<FunctionNode> stencil_chain(const FunctionRegistry& function_registry,const std::vector<std::string>& types)
+{
+  FunctionNodeInfo root;
+  FunctionNodeInfo* info=&root;
+  for (uint i=0;i<types.size();i++)
+    {
+      if (i>0)
+	{
+	  info->args().push_back(new FunctionNodeInfo());
+	  info=&info->args().back();
+	}
+
+      const std::string::size_type colon=types[i].find(':');
+      const std::string type=types[i].substr(0,colon);
+      info->type(type);
+      if (colon!=std::string::npos)
+	info->iterations(atoi(types[i].c_str()+colon+1));
+
+      if (type=="FunctionGradient")
+	{
+	  info->params().push_back(0.5);
+	  info->params().push_back(0.3);
+	  info->params().push_back(0.2);
+	}
+      else if (type=="FunctionFilter3D")
+	{
+	  info->params().push_back(0.01);
+	  info->params().push_back(0.01);
+	  info->params().push_back(0.01);
+	}
+      else if (type=="FunctionAverageRing" || type=="FunctionFilterRing")
+	{
+	  info->params().push_back(0.1);
+	}
+      else if (type=="FunctionKaleidoscope" || type=="FunctionWindmill")
+	{
+	  info->params().push_back(0.3);
+	}
+      else if (type=="FunctionTransform")
+	{
+	  const real p[12]={0.1,0.2,0.0,0.8,0.6,0.0,-0.6,0.8,0.0,0.0,0.0,1.0};
+	  info->params().assign(p,p+12);
+	}
+    }
+
+  std::string report;
+  return std::unique_ptr<FunctionNode>((*function_registry.lookup(root.type())->create_fn)(function_registry,root,report));
+}
+
+//! Time finite difference stencils (FunctionGradient, FunctionCurl...) and nests of them, the ring filters and the kaleidoscope folds, evaluated a point at a time and in batches, and write the times to a stream.
+/*! Points covering an image are evaluated one at a time (as Function::evaluate does) and in batches of a tile row (as the renderer does).
+  Batches send each stencil's or ring's samples to its argument as one batch, and share repeated points in nested stencils (see FunctionNode::evaluate_stencil).
+  The batched results should be exactly the same as evaluating a point at a time: the number which aren't bitwise identical is written too.
+ */
+static void write_stencil_benchmark(std::ostream& out,const FunctionRegistry& function_registry,int width,int height)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  std::vector<XYZ> points;
+  for (int row=0;row<height;row++)
+    for (int col=0;col<width;col++)
+      points.push_back(XYZ(-1.0+2.0*(col+0.5)/width,1.0-2.0*(row+0.5)/height,0.0));
+  const size_t n=points.size();
+  const size_t batch=FrameRenderer::tile_side();
+
+  const char*const cases[]=
+    {
+      "FunctionGradient FunctionNoiseOneChannel",
+      "FunctionCurl FunctionNoiseThreeChannel",
+      "FunctionFilter3D FunctionNoiseThreeChannel",
+      "FunctionGradient FunctionDivergence FunctionNoiseThreeChannel",
+      "FunctionCurl FunctionCurl FunctionNoiseThreeChannel",
+      "FunctionDivergence FunctionScalarLaplacian FunctionNoiseThreeChannel",
+      "FunctionCurl FunctionCurl FunctionCurl FunctionNoiseThreeChannel",
+      "FunctionGradient FunctionDivergence FunctionCurl FunctionNoiseThreeChannel",
+      "FunctionAverageRing:16 FunctionTransform",
+      "FunctionAverageRing:256 FunctionTransform",
+      "FunctionAverageRing:16 FunctionNoiseThreeChannel",
+      "FunctionAverageRing:64 FunctionNoiseThreeChannel",
+      "FunctionAverageRing:256 FunctionNoiseThreeChannel",
+      "FunctionFilterRing:256 FunctionTransform",
+      "FunctionFilterRing:64 FunctionNoiseThreeChannel",
+      "FunctionFilterRing:256 FunctionNoiseThreeChannel",
+      "FunctionKaleidoscope FunctionTransform",
+      "FunctionWindmill FunctionTransform"
+    };
+
+  out << "Nanoseconds per point (" << width << "x" << height << " points)\n";
+  out << "function\tpoint\tbatch\tspeedup\tmismatches\n";
+  for (uint c=0;c<sizeof(cases)/sizeof(cases[0]);c++)
+    {
+      std::vector<std::string> types;
+      std::istringstream in(cases[c]);
+      std::string type;
+      while (in >> type)
+	types.push_back(type);
+      const std::unique_ptr<FunctionNode> fn(stencil_chain(function_registry,types));
+
+      std::vector<XYZ> expected(n);
+      const Clock::time_point t0=Clock::now();
+      for (size_t i=0;i<n;i++)
+	expected[i]=(*fn)(points[i]);
+      const Clock::time_point t1=Clock::now();
+
+      std::vector<XYZ> actual(n);
+      const Clock::time_point t2=Clock::now();
+      for (size_t i=0;i<n;i+=batch)
+	(*fn)(&points[i],&actual[i],std::min(batch,n-i));
+      const Clock::time_point t3=Clock::now();
+
+      uint mismatches=0;
+      for (size_t i=0;i<n;i++)
+	if (memcmp(&expected[i],&actual[i],sizeof(XYZ))!=0)
+	  mismatches++;
+
+      std::string name;
+      for (uint i=0;i<types.size();i++)
+	name+=types[i].substr(std::string("Function").size(),types[i].find(':')-std::string("Function").size())+(i+1<types.size() ? "(" : "");
+      name+=std::string(types.size()-1,')');
+
+      const double point_ns=std::chrono::duration<double,std::nano>(t1-t0).count()/n;
+      const double batch_ns=std::chrono::duration<double,std::nano>(t3-t2).count()/n;
+      out << name;
+      if (fn->iterations())
+	out << " x" << fn->iterations();
+      out << "\t" << point_ns << "\t" << batch_ns << "\t" << point_ns/batch_ns << "\t" << mismatches << "\n";
+    }
+}
+
+//! Distance between two doubles in units in the last place (0 if they're identical, or both NaN).
+static double ulps(double a,double b)
+{
+  if (a==b || (std::isnan(a) && std::isnan(b)))
+    return 0.0;
+  if (std::isnan(a) || std::isnan(b))
+    return std::numeric_limits<double>::infinity();
+
+  // Map the sign-magnitude bit patterns onto an unsigned scale where neighbouring reals differ by 1.
+  unsigned long long int ia;
+  unsigned long long int ib;
+  memcpy(&ia,&a,sizeof(ia));
+  memcpy(&ib,&b,sizeof(ib));
+  const unsigned long long int sign=1ULL<<63;
+  ia=((ia&sign) ? sign-(ia&~sign) : sign+ia);
+  ib=((ib&sign) ? sign-(ib&~sign) : sign+ib);
+  return static_cast<double>(ia>ib ? ia-ib : ib-ia);
+}
+
+//! Distance between two floats in units in the last place, as for doubles.
+static double ulps(float a,float b)
+{
+  if (a==b || (std::isnan(a) && std::isnan(b)))
+    return 0.0;
+  if (std::isnan(a) || std::isnan(b))
+    return std::numeric_limits<double>::infinity();
+
+  uint ia;
+  uint ib;
+  memcpy(&ia,&a,sizeof(ia));
+  memcpy(&ib,&b,sizeof(ib));
+  const uint sign=1U<<31;
+  ia=((ia&sign) ? sign-(ia&~sign) : sign+ia);
+  ib=((ib&sign) ? sign-(ib&~sign) : sign+ib);
+  return static_cast<double>(ia>ib ? ia-ib : ib-ia);
+}
+
+//! Write the largest difference between a vector kernel's results and the scalar kernel's to a stream, and return whether it's within a tolerance (in ulps).
+template <typename T> static bool check_kernel(std::ostream& out,const std::string& kernels,const char* name,const std::vector<T>& expected,const std::vector<T>& actual,double tolerance)
+{
+  double worst=0.0;
+  for (size_t i=0;i<expected.size();i++)
+    worst=std::max(worst,ulps(expected[i],actual[i]));
+
+  const bool ok=(worst<=tolerance);
+  out << kernels << "\t" << name << "\t" << worst << " ulp\t" << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+//! Check one vector kernel table against the scalar kernels' table of the same precision, writing the largest differences to a stream, and return whether every kernel passed.
+/*! The double precision inputs (laid out as for check_kernels) are rounded to the table's precision.
+ */
+template <typename T> static bool check_table(std::ostream& out,const std::string& name,const SimdKernels::Table<T>& scalar,const SimdKernels::Table<T>& kernels,const std::vector<double>& a_in,const std::vector<double>& b_in,const double* k_in,const std::vector<double>& z_in,const std::vector<double>& c_in,uint iterations,size_t m)
+{
+  const std::vector<T> a(a_in.begin(),a_in.end());
+  const std::vector<T> b(b_in.begin(),b_in.end());
+  const std::vector<T> k(k_in,k_in+12);
+  const std::vector<T> z(z_in.begin(),z_in.end());
+  const std::vector<T> c(c_in.begin(),c_in.end());
+
+  std::vector<T> expected(3*m);
+  std::vector<T> actual(3*m);
+  std::vector<uint> expected_counts(m);
+  std::vector<uint> actual_counts(m);
+  bool ok=true;
+
+  scalar.add(&a[0],&b[0],&expected[0],3*m);
+  kernels.add(&a[0],&b[0],&actual[0],3*m);
+  ok=check_kernel(out,name,"add",expected,actual,0.0) && ok;
+
+  scalar.multiply(&a[0],&b[0],&expected[0],3*m);
+  kernels.multiply(&a[0],&b[0],&actual[0],3*m);
+  ok=check_kernel(out,name,"multiply",expected,actual,0.0) && ok;
+
+  scalar.divide(&a[0],&b[0],&expected[0],3*m);
+  kernels.divide(&a[0],&b[0],&actual[0],3*m);
+  ok=check_kernel(out,name,"divide",expected,actual,0.0) && ok;
+
+  scalar.maximum(&a[0],&b[0],&expected[0],3*m);
+  kernels.maximum(&a[0],&b[0],&actual[0],3*m);
+  ok=check_kernel(out,name,"maximum",expected,actual,0.0) && ok;
+
+  scalar.minimum(&a[0],&b[0],&expected[0],3*m);
+  kernels.minimum(&a[0],&b[0],&actual[0],3*m);
+  ok=check_kernel(out,name,"minimum",expected,actual,0.0) && ok;
+
+  scalar.exp(&a[0],&expected[0],3*m);
+  kernels.exp(&a[0],&actual[0],3*m);
+  ok=check_kernel(out,name,"exp",expected,actual,2.0) && ok;
+
+  scalar.sin(&a[0],&expected[0],3*m);
+  kernels.sin(&a[0],&actual[0],3*m);
+  ok=check_kernel(out,name,"sin",expected,actual,2.0) && ok;
+
+  scalar.cos(&a[0],&expected[0],3*m);
+  kernels.cos(&a[0],&actual[0],3*m);
+  ok=check_kernel(out,name,"cos",expected,actual,2.0) && ok;
+
+  scalar.transform(&k[0],&a[0],&expected[0],m);
+  kernels.transform(&k[0],&a[0],&actual[0],m);
+  ok=check_kernel(out,name,"transform",expected,actual,0.0) && ok;
+
+  scalar.cone(&a[0],&expected[0],m);
+  kernels.cone(&a[0],&actual[0],m);
+  ok=check_kernel(out,name,"cone",expected,actual,0.0) && ok;
+
+  scalar.escape_time(&z[0],&c[0],iterations,&expected_counts[0],m);
+  kernels.escape_time(&z[0],&c[0],iterations,&actual_counts[0],m);
+  ok=check_kernel(out,name,"escape_time",std::vector<double>(expected_counts.begin(),expected_counts.end()),std::vector<double>(actual_counts.begin(),actual_counts.end()),0.0) && ok;
+
+  return ok;
+}
+
+//! Check each of the vector kernel sets this CPU supports against the scalar kernels, writing the largest differences to a stream.
+/*! The inputs are random over several ranges, plus the special values (zeros, infinities, NaNs, denormals and the edges of exp's range),
+  and their number isn't a multiple of any vector width so the tails are covered too.
+  Everything must be bit identical to the scalar results, except exp, sin and cos which must be within 2 ulp
+  (as documented for SimdKernels).
+  Returns whether every kernel passed.
+ */
+static bool check_kernels(std::ostream& out)
+{
+  const SimdKernels& scalar=SimdKernels::scalar();
+  std::vector<const SimdKernels*> vector_kernels;
+  if (SimdKernels::sse2()) vector_kernels.push_back(SimdKernels::sse2());
+  if (SimdKernels::avx2()) vector_kernels.push_back(SimdKernels::avx2());
+  if (vector_kernels.empty())
+    {
+      out << "No vector kernels supported; nothing to check\n";
+      return true;
+    }
+
+  Random01 r01(23);
+  const size_t m=4099;
+
+  // Operands for the componentwise kernels (and 3*m reals is m points for the others).
+  const real special[]=
+    {
+      0.0,-0.0,1.0,-1.0,
+      std::numeric_limits<real>::infinity(),-std::numeric_limits<real>::infinity(),std::numeric_limits<real>::quiet_NaN(),
+      std::numeric_limits<real>::denorm_min(),1e-310,709.7,709.9,-708.3,-745.1,-745.2,
+      1073741823.0,1073741824.0,-1073741825.0,1e300
+    };
+  const size_t specials=sizeof(special)/sizeof(special[0]);
+  const real ranges[]={1.0,10.0,1000.0,1e6,1e12};
+  std::vector<real> a(3*m);
+  std::vector<real> b(3*m);
+  for (size_t i=0;i<3*m;i++)
+    {
+      const real range=ranges[i%5];
+      a[i]=(i<specials ? special[i] : range*(2.0*r01()-1.0));
+      b[i]=(i<specials ? special[specials-1-i] : range*(2.0*r01()-1.0));
+    }
+  // Some equal operands, so the max and min ties are covered.
+  for (size_t i=specials;i<3*m;i+=7)
+    b[i]=a[i];
+
+  // Transform components.
+  real k[12];
+  for (uint i=0;i<12;i++)
+    k[i]=4.0*r01()-2.0;
+
+  // Escape time starting points (including zero, for the Mandelbrot set's shortcuts) and constants.
+  std::vector<real> z(2*m);
+  std::vector<real> c(2*m);
+  for (size_t i=0;i<m;i++)
+    {
+      const bool mandelbrot=(i%3==0);
+      z[i]=(mandelbrot ? 0.0 : 3.0*r01()-1.5);
+      z[m+i]=(mandelbrot ? 0.0 : 3.0*r01()-1.5);
+      c[i]=3.0*r01()-2.0;
+      c[m+i]=3.0*r01()-1.5;
+    }
+  const uint iterations=256;
+
+  // Noise tables for three channels.
+  std::vector<int> permutation_tables(3*Noise::N);
+  std::vector<double> gradient_tables(3*4*Noise::N);
+  const int* permutations[3];
+  const double* gradients[3];
+  for (uint channel=0;channel<3;channel++)
+    {
+      int*const p=&permutation_tables[channel*Noise::N];
+      for (int i=0;i<Noise::N;i++)
+	p[i]=i;
+      for (int i=Noise::N-1;i>0;i--)
+	std::swap(p[i],p[static_cast<int>(r01()*(i+1))%(i+1)]);
+      for (uint i=0;i<4*Noise::N;i++)
+	gradient_tables[channel*4*Noise::N+i]=(i%4==3 ? 0.0 : 2.0*r01()-1.0);
+      permutations[channel]=p;
+      gradients[channel]=&gradient_tables[channel*4*Noise::N];
+    }
+  std::vector<real> points(3*m);
+  for (size_t i=0;i<3*m;i++)
+    points[i]=(i%m<16 ? 0.0 : 64.0*r01()-32.0);
+  const uint octaves=8;
+
+  std::vector<real> expected(3*m);
+  std::vector<real> actual(3*m);
+  bool ok=true;
+  for (size_t j=0;j<vector_kernels.size();j++)
+    {
+      const SimdKernels& kernels=*vector_kernels[j];
+
+      ok=check_table(out,kernels.name,scalar.double_table,kernels.double_table,a,b,k,z,c,iterations,m) && ok;
+      ok=check_table(out,std::string(kernels.name)+" float",scalar.float_table,kernels.float_table,a,b,k,z,c,iterations,m) && ok;
+
+      scalar.noise(permutations,gradients,3,octaves,&points[0],&expected[0],m);
+      kernels.noise(permutations,gradients,3,octaves,&points[0],&actual[0],m);
+      ok=check_kernel(out,kernels.name,"noise",expected,actual,0.0) && ok;
+    }
+  return ok;
+}
+
+//! Write a table of the cost of each function type, from profiling random functions built around it, to a stream.
+/*! The table is in the form FunctionProfile::write_costs writes, to be pasted into function_cost.cpp.
+ */
+static void write_cost_calibration(std::ostream& out,const FunctionRegistry& function_registry,uint functions,int width,int height)
+{
+  MutationParameters mutation_parameters(23,false,false);
+  FunctionProfile::Calibrations calibrations;
+  for (FunctionRegistry::const_iterator it=function_registry.begin();it!=function_registry.end();it++)
+    {
+      std::clog << it->first << "\n";
+      for (uint i=0;i<functions;i++)
+	{
+	  std::unique_ptr<FunctionTop> fn(FunctionTop::initial(mutation_parameters,it->second));
+	  const boost::shared_ptr<const MutatableImage> image(new MutatableImage(fn,false,false,false));
+	  image->profile(width,height,1,1)->calibrate(calibrations);
+	}
+    }
+  FunctionProfile::write_costs(out,calibrations);
+}
+
+//! Application code
+int main(int argc,char* argv[])
+{
+  {
+    bool benchmark_abort;
+    bool benchmark_farm;
+    bool benchmark_frames;
+    bool benchmark_kernels;
+    bool benchmark_levels;
+    bool benchmark_noise;
+    bool benchmark_stencils;
+    bool benchmark_tiles;
+    uint calibrate_costs;
+    bool check_simd_kernels;
+    uint frames;
+    bool help;
+    std::string size;
+    uint threads;
+    bool verbose;
+    
+    boost::program_options::options_description options_desc("Options");
+    {
+      using namespace boost::program_options;
+      options_desc.add_options()
+	("benchmark-abort",bool_switch(&benchmark_abort)   ,"Time how long a compute thread takes to abandon an aborted task (computing a 4x4 multisampled image at --size) and write the latencies to stdout")
+	("benchmark-farm",bool_switch(&benchmark_farm)     ,"Time the compute farm used by evolvotron rendering an image (at --size) in 1x1 and 16x16 pixel fragments with 1 to 64 threads and write the throughputs to stdout")
+	("benchmark-frames",bool_switch(&benchmark_frames) ,"Time rendering a random function's --frames frames (at --size, with --threads threads) and encoding them as PNGs, one after another and pipelined, and write the frame rates to stdout")
+	("benchmark-kernels",bool_switch(&benchmark_kernels),"Time the batch kernels of each SIMD kernel set (over --size points) and write the times per point to stdout")
+	("benchmark-levels",bool_switch(&benchmark_levels) ,"Time computing the resolution levels of random functions' images (at --size) with and without reusing the previous level's samples and write the times to stdout")
+	("benchmark-noise",bool_switch(&benchmark_noise)   ,"Time the noise generator at each octave of the multiscale noise functions (at --size) and write the throughputs to stdout")
+	("benchmark-stencils",bool_switch(&benchmark_stencils),"Time finite difference functions (Gradient, Curl...) and nests of them, ring filters and kaleidoscopes evaluated a point at a time and in batches (over --size points) and write the times per point to stdout")
+	("benchmark-tiles",bool_switch(&benchmark_tiles)   ,"Time the compute farm used by evolvotron computing an image (at --size) in row strips and in tiles adapted to its measured cost with 1 to 64 threads and write the times and utilisations to stdout")
+	("calibrate-costs",value<uint>(&calibrate_costs)->default_value(0),"Profile this many random functions built around each function type (at --size) and write the table of function costs used for estimating rendering costs to stdout")
+	("check-kernels",bool_switch(&check_simd_kernels)   ,"Check the vector kernels this CPU supports against the scalar ones and write the largest differences to stdout (exits with status 1 if any are out of tolerance)")
+	("frames,f"     ,value<uint>(&frames)->default_value(8)    ,"Frames rendered by --benchmark-frames")
+	("help,h"       ,bool_switch(&help)                        ,"Print command-line options help message and exit")
+	("size,s"       ,value<std::string>(&size)->default_value("512x512"),"Image size (or number of points) used by the benchmarks")
+	("threads,t"    ,value<uint>(&threads)->default_value(get_number_of_processors()),"Number of rendering threads used by --benchmark-frames")
+	("verbose,v"    ,bool_switch(&verbose)                     ,"Log some details to stderr")
+	;
+    }
+
+    boost::program_options::variables_map options;
+    boost::program_options::store
+      (
+       boost::program_options::command_line_parser(argc,argv)
+       .options(options_desc).run()
+       ,options
+       );
+    boost::program_options::notify(options);
+    
+    if (help)
+      {
+	std::cerr << options_desc;
+	return 0;
+      }
+
+    if (verbose)
+      std::clog.rdbuf(std::cerr.rdbuf());
+    else
+      std::clog.rdbuf(sink_ostream.rdbuf());
+
+    const std::string::size_type p=size.find("x");
+    if (p==std::string::npos || p==0 || p==size.size()-1)
+      {
+	std::cerr << "--size option argument isn't in <width>x<height> format\n";
+	return 1;
+      }
+    else
+      {
+	size[p]=' ';
+      }
+    int width=512;
+    int height=512;
+    std::stringstream(size) >> width >> height;
+    
+    if (frames<1)
+      {
+	std::cerr << "Must specify at least 1 frame (option: -f <frames>)\n";
+	return 1;
+      }
+
+    if (threads<1)
+      {
+	std::cerr << "Must specify at least 1 thread (option: -t <threads>)\n";
+	return 1;
+      }
+
+    if (check_simd_kernels)
+      return (check_kernels(std::cout) ? 0 : 1);
+
+    FunctionRegistry function_registry;
+
+    if (benchmark_abort)
+      write_abort_benchmark(std::cout,width,height);
+    else if (benchmark_farm)
+      write_farm_benchmark(std::cout,width,height);
+    else if (benchmark_frames)
+      write_frames_benchmark(std::cout,width,height,frames,threads);
+    else if (benchmark_kernels)
+      write_kernel_benchmark(std::cout,width,height);
+    else if (benchmark_levels)
+      write_levels_benchmark(std::cout,width,height);
+    else if (benchmark_noise)
+      write_noise_benchmark(std::cout,width,height);
+    else if (benchmark_stencils)
+      write_stencil_benchmark(std::cout,function_registry,width,height);
+    else if (benchmark_tiles)
+      write_tiles_benchmark(std::cout,width,height);
+    else if (calibrate_costs)
+      write_cost_calibration(std::cout,function_registry,calibrate_costs,width,height);
+    else
+      {
+	std::cerr << "Must specify a benchmark or check to run (see --help)\n";
+	return 1;
+      }
+  }
+  
+  return 0;
+}
@@ -34,6 +34,7 @@ int main(int argc,char* argv[])
     bool genesis;
     bool help;
     bool linear;
+    std::string precision;
     bool spheremap;
     bool verbose;
 
@@ -44,6 +45,7 @@ int main(int argc,char* argv[])
 	("genesis,g"  ,bool_switch(&genesis)  ,"Create a new function to stdout (without this option, a function will be read from stdin)")
 	("help,h"     ,bool_switch(&help)     ,"Print command-line options help message and exit")
 	("linear,l"   ,bool_switch(&linear)   ,"Sweep z linearly in animations")
+	("precision"  ,value<std::string>(&precision)->default_value("double"),"Precision the function will be rendered in (float or double); with float, warn if it renders visibly differently from double")
 	("spheremap,p",bool_switch(&spheremap),"Generate spheremap")
 	("verbose,v"  ,bool_switch(&verbose)  ,"Log some details to stderr")
 	;
@@ -63,6 +65,12 @@ int main(int argc,char* argv[])
       std::clog.rdbuf(std::cerr.rdbuf());
     else
       std::clog.rdbuf(sink_ostream.rdbuf());
+
+    if (precision!="float" && precision!="double")
+      {
+	std::cerr << "--precision option argument must be float or double\n";
+	return 1;
+      }
     
     // Normally would use time(0) to seed random number generator
     // but can imagine several of these starting up virtually simultaneously
@@ -105,6 +113,41 @@ int main(int argc,char* argv[])
 	imagefn_out=imagefn_in->mutated(mutation_parameters);
       }
     
+    if (precision=="float")
+      {
+	// Mutation itself never evaluates the function, so just check the result on a small image rendered both ways.
+	const int size=64;
+	XYZBlock colours(size);
+	XYZBlock float_colours(size);
+	MutatableImage::Scratch scratch;
+	double squared_error=0.0;
+	for (int row=0;row<size;row++)
+	  {
+	    imagefn_out->get_rgb(0,row,0,size,size,1,0,1,false,colours,scratch);
+	    imagefn_out->get_rgb(0,row,0,size,size,1,0,1,true,float_colours,scratch);
+	    for (int col=0;col<size;col++)
+	      {
+		squared_error+=sqr(static_cast<double>(lrint(colours.x()[col])-lrint(float_colours.x()[col])));
+		squared_error+=sqr(static_cast<double>(lrint(colours.y()[col])-lrint(float_colours.y()[col])));
+		squared_error+=sqr(static_cast<double>(lrint(colours.z()[col])-lrint(float_colours.z()[col])));
+	      }
+	  }
+
+	const double mse=squared_error/(3.0*size*size);
+	std::clog << "PSNR between float and double evaluation of a " << size << "x" << size << " preview ";
+	if (mse==0.0)
+	  {
+	    std::clog << "infinite (identical)\n";
+	  }
+	else
+	  {
+	    const double psnr=10.0*log10(255.0*255.0/mse);
+	    std::clog << psnr << "dB\n";
+	    if (psnr<40.0)
+	      std::cerr << "evolvotron_mutate: Warning: Function renders visibly differently in single precision (PSNR " << psnr << "dB); render it in double\n";
+	  }
+      }
+
     imagefn_out->save_function(std::cout);
   }
     
@@ -21,22 +21,92 @@
   \brief Standalone renderer for evolvotron function files.
 */
 
+#include "frame_renderer.h"
+#include "function_profile.h"
 #include "function_registry.h"
 #include "mutatable_image.h"
-#include "random.h"
+#include "platform_specific.h"
 
 #include <boost/program_options.hpp>
 
+//! Write the header for a frame in one of the formats for --output - (see the --stream-format option), or for a PPM file.
+/*! The y4m stream header is written before frame 0.
+ */
+static void write_frame_header(std::ostream& out,const std::string& format,int width,int height,uint frame,int fps)
+{
+  if (format=="y4m")
+    {
+      if (frame==0)
+	out << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C444\n";
+      out << "FRAME\n";
+    }
+  else if (format=="ppm")
+    {
+      out << "P6\n" << width << " " << height << "\n255\n";
+    }
+}
+
+//! Write rows of a frame's pixels (following write_frame_header), without going through QImage.
+/*! The y4m format is planar, so it can only be written a whole frame at a time.
+  Returns false if the stream couldn't be written.
+ */
+static bool write_rows(std::ostream& out,const std::string& format,const std::vector<uint>& image_data)
+{
+  const size_t pixels=image_data.size();
+  std::vector<unsigned char> data;
+
+  if (format=="y4m")
+    {
+      // Full resolution (4:4:4) Y, Cb and Cr planes, in the "studio" range of ITU-R BT.601.
+      data.resize(3*pixels);
+      for (size_t i=0;i<pixels;i++)
+	{
+	  const int r=(image_data[i]>>16)&0xff;
+	  const int g=(image_data[i]>>8)&0xff;
+	  const int b=image_data[i]&0xff;
+	  data[i]=((66*r+129*g+25*b+128)>>8)+16;
+	  data[pixels+i]=((-38*r-74*g+112*b+128)>>8)+128;
+	  data[2*pixels+i]=((112*r-94*g-18*b+128)>>8)+128;
+	}
+    }
+  else
+    {
+      const uint channels=(format=="rgba" ? 4 : 3);
+      data.resize(channels*pixels);
+      for (size_t i=0;i<pixels;i++)
+	{
+	  data[channels*i  ]=(image_data[i]>>16)&0xff;
+	  data[channels*i+1]=(image_data[i]>>8)&0xff;
+	  data[channels*i+2]=image_data[i]&0xff;
+	  if (channels==4) data[channels*i+3]=0xff;
+	}
+    }
+
+  if (!data.empty())
+    out.write(reinterpret_cast<const char*>(&data[0]),data.size());
+  out.flush();
+  return static_cast<bool>(out);
+}
+
 //! Application code
 int main(int argc,char* argv[])
 {
   {
     uint frames;
+    int fps;
     bool help;
     bool jitter;
+    uint max_memory;
     int multisample;
     std::string output_filename;
+    std::string precision;
+    bool profile;
+    std::string profile_stacks_filename;
+    bool psnr;
+    real sample_budget;
     std::string size;
+    std::string stream_format;
+    uint threads;
     bool verbose;
     
     boost::program_options::options_description options_desc("Options");
@@ -44,12 +114,21 @@ int main(int argc,char* argv[])
     {
       using namespace boost::program_options;
       options_desc.add_options()
+	("fps"          ,value<int>(&fps)->default_value(8)        ,"Animation speed (frames-per-second) recorded in y4m output")
 	("frames,f"     ,value<uint>(&frames)->default_value(1)    ,"Frames in an animation")
 	("help,h"       ,bool_switch(&help)                        ,"Print command-line options help message and exit")
 	("jitter,j"     ,bool_switch(&jitter)                      ,"Enable rendering jitter")
+	("max-memory"   ,value<uint>(&max_memory)->default_value(0),"Most memory (in megabytes) for images being rendered and written, by rendering and writing frames in bands of rows (0 for no limit)")
 	("multisample,m",value<int>(&multisample)->default_value(1),"Multisampling grid (NxN)")
-	("output,o"     ,value<std::string>(&output_filename)      ,"Output filename (.png or .ppm suffix).  (Or use first positional argument.)")
+	("output,o"     ,value<std::string>(&output_filename)      ,"Output filename (.png or .ppm suffix), or - to stream frames to stdout.  (Or use first positional argument.)")
+	("precision"    ,value<std::string>(&precision)->default_value("double"),"Evaluation precision (float or double)")
+	("profile"      ,bool_switch(&profile)                     ,"Also profile the function's evaluation and report the cost of each function type to stderr")
+	("profile-stacks",value<std::string>(&profile_stacks_filename),"Write the profile as collapsed stacks (for flamegraph.pl) to the named file (implies --profile)")
+	("psnr"         ,bool_switch(&psnr)                        ,"Also render in the other precision and report the PSNR between the two to stderr")
+	("sample-budget",value<real>(&sample_budget)->default_value(0.0),"Multisample adaptively, averaging at most this many samples per pixel (0 multisamples every pixel)")
 	("size,s"       ,value<std::string>(&size)->default_value("512x515"),"Generated image size")
+	("stream-format",value<std::string>(&stream_format)->default_value("ppm"),"Format of frames streamed to stdout by --output - (ppm, rgb, rgba or y4m)")
+	("threads,t"    ,value<uint>(&threads)->default_value(get_number_of_processors()),"Number of rendering threads")
 	("verbose,v"    ,bool_switch(&verbose)                     ,"Log some details to stderr")
 	;
       pos_options_desc.add("output",1);
@@ -96,14 +175,66 @@ int main(int argc,char* argv[])
 	return 1;
       }
 
+    if (precision!="float" && precision!="double")
+      {
+	std::cerr << "--precision option argument must be float or double\n";
+	return 1;
+      }
+    const bool single_precision=(precision=="float");
+
+    if (sample_budget<0.0)
+      {
+	std::cerr << "--sample-budget must not be negative\n";
+	return 1;
+      }
+
+    if (threads<1)
+      {
+	std::cerr << "Must specify at least 1 thread (option: -t <threads>)\n";
+	return 1;
+      }
+
+    FunctionRegistry function_registry;
+
     if (output_filename.empty())
       {
 	std::cerr << "Must specify an output filename\n";
 	return 1;
       }
+
+    if (stream_format!="ppm" && stream_format!="rgb" && stream_format!="rgba" && stream_format!="y4m")
+      {
+	std::cerr << "--stream-format option argument must be ppm, rgb, rgba or y4m\n";
+	return 1;
+      }
+
+    if (fps<1)
+      {
+	std::cerr << "Must specify framerate of at least 1\n";
+	return 1;
+      }
     
-    FunctionRegistry function_registry;
-    
+    // Frames are rendered (and written) in bands of rows if they'd take more memory than allowed.
+    int band_rows=height;
+    if (max_memory)
+      {
+	band_rows=FrameRenderer::band_rows_for_memory(max_memory*1048576ULL,width);
+	if (band_rows==0)
+	  {
+	    std::cerr << "--max-memory option argument is too small for images " << width << " pixels wide\n";
+	    return 1;
+	  }
+	band_rows=std::min(band_rows,height);
+      }
+    const bool banded=(band_rows<height);
+
+    // Without QImage, bands can only be written as PPM files, or streamed in a format which isn't planar.
+    if (banded && (output_filename=="-" ? stream_format=="y4m" : !QString::fromLocal8Bit(output_filename.c_str()).toUpper().endsWith(".PPM")))
+      {
+	std::cerr << "--max-memory option needs a .ppm output filename, or --output - with a --stream-format other than y4m, for images this big\n";
+	return 1;
+      }
+
     std::string report;
     const boost::shared_ptr<const MutatableImage> imagefn(MutatableImage::load_function(function_registry,std::cin,report));
 
@@ -117,96 +248,157 @@ int main(int argc,char* argv[])
 	std::cerr << "evolvotron_render: Warning: Function loaded with warnings:\n" << report;
       }
 
-    // Seed value pretty unimportant; only used for sample jitter.
-    Random01 r01(23);
+    if (profile || !profile_stacks_filename.empty())
+      {
+	std::clog << "Profiling...\n";
+	const std::unique_ptr<FunctionProfile> function_profile(imagefn->profile(width,height,frames,multisample));
+	function_profile->report(std::cerr);
+
+	if (!profile_stacks_filename.empty())
+	  {
+	    std::ofstream stacks(profile_stacks_filename.c_str());
+	    function_profile->collapsed_stacks(stacks);
+	    if (!stacks)
+	      {
+		std::cerr << "evolvotron_render: Error: Couldn't write file " << profile_stacks_filename << "\n";
+		return 1;
+	      }
+	  }
+      }
+
+    // Frames are rendered by the renderer's threads while this one saves them, in order, as they complete.
+    FrameRenderer renderer(*imagefn,width,height,frames,jitter,multisample,single_precision,sample_budget,threads,band_rows,true);
+
+    // For --psnr, the same frames again in the other precision, taken in step with the ones saved.
+    std::unique_ptr<FrameRenderer> other_renderer;
+    if (psnr)
+      other_renderer.reset(new FrameRenderer(*imagefn,width,height,frames,jitter,multisample,!single_precision,sample_budget,threads,band_rows,false));
+
+    if (banded)
+      std::clog << "Rendering in bands of " << band_rows << " rows\n";
 
     for (uint frame=0;frame<frames;frame++)
       {
+	QString save_filename(QString::fromLocal8Bit(output_filename.c_str()));
+	const char* save_format="PPM";
+	if (output_filename!="-")
+	  {
+	    if (save_filename.toUpper().endsWith(".PPM"))
+	      {
+		save_format="PPM";
+	      }
+	    else if (save_filename.toUpper().endsWith(".PNG"))
+	      {
+		save_format="PNG";
+	      }
+	    else
+	      {
+		std::cerr 
+		  << "evolvotron_render: Warning: Unrecognised file suffix.  File will be written in "
+		  << save_format
+		  << " format.\n";
+	      }
+
+	    if (frames>1)
+	      {
+		QString frame_component = QString::asprintf(".f%06d",frame);
+		int insert_point=save_filename.lastIndexOf(QString("."));
+		if (insert_point==-1)
+		  {
+		    save_filename.append(frame_component);
+		  }
+		else
+		  {
+		    save_filename.insert(insert_point,frame_component);
+		  }
+	      }
+	  }
+
+	// Bands are written straight out as they're taken (unless the whole frame is saved through QImage).
+	std::ofstream save_file;
+	std::ostream* out=0;
+	if (output_filename=="-")
+	  {
+	    out=&std::cout;
+	    write_frame_header(*out,stream_format,width,height,frame,fps);
+	  }
+	else if (banded)
+	  {
+	    save_file.open(save_filename.toLocal8Bit().data(),std::ios::binary);
+	    out=&save_file;
+	    write_frame_header(*out,"ppm",width,height,frame,fps);
+	  }
+
 	std::vector<uint> image_data;
-	image_data.reserve(width*height);
-  
-	uint pixels=0;
-	uint report=1;
-	const uint reports=20;
-	for (int row=0;row<height;row++)
-	  for (int col=0;col<width;col++)
-	    {
-	      const XYZ v(imagefn->sampling_coordinate(col,row,frame,width,height,frames));
-	    
-	      const XYZ colour(imagefn->get_rgb(col,row,frame,width,height,frames,(jitter ? &r01 : 0),multisample));
-	    
-	      const uint col0=lrint(clamped(colour.x(),0.0,255.0));
-	      const uint col1=lrint(clamped(colour.y(),0.0,255.0));
-	      const uint col2=lrint(clamped(colour.z(),0.0,255.0));
-
-	      image_data.push_back(((col0<<16)|(col1<<8)|(col2)));
-
-	      pixels++;
-	      if (pixels>=(report*width*height)/reports)
-		{
-		  std::clog << "[" << (100*report)/reports << "%]";
-		  report++;
-		}
-	    }
-	std::clog << "\n";
+	std::vector<uint> other_image_data;
+	unsigned long long int samples=0;
+	double squared_error=0.0;
+	for (uint band=0;band<renderer.bands();band++)
+	  {
+	    samples+=renderer.take_band(image_data);
 
-	{
-	  //! \todo If filename is "-", write PPM to stdout (QImage save only supports write-to-a-filenames though)
-	  QString save_filename(QString::fromLocal8Bit(output_filename.c_str()));
-
-	  const char* save_format="PPM";
-	  if (save_filename.toUpper().endsWith(".PPM"))
-	    {
-	      save_format="PPM";
-	    }
-	  else if (save_filename.toUpper().endsWith(".PNG"))
-	    {
-	      save_format="PNG";
-	    }
-	  else
-	    {
-	      std::cerr 
-		<< "evolvotron_render: Warning: Unrecognised file suffix.  File will be written in "
-		<< save_format
-		<< " format.\n";
-	    }
-
-	  if (frames>1)
-	    {
-	      QString frame_component = QString::asprintf(".f%06d",frame);
-	      int insert_point=save_filename.lastIndexOf(QString("."));
-	      if (insert_point==-1)
-		{
-		  save_filename.append(frame_component);
-		}
-	      else
-		{
-		  save_filename.insert(insert_point,frame_component);
-		}
-	    }
-    
-	  QImage image
-	    (
-	     reinterpret_cast<uchar*>(&(image_data[0])),
-	     width,
-	     height,
-	     QImage::Format_RGB32
-	     );
-
-	  if (!image.save(save_filename,save_format))
-	    {
-	      std::cerr 
-		<< "evolvotron_render: Error: Couldn't save file "
-		<< save_filename.toLocal8Bit().data()
-		<< "\n";
-	      return 1;
-	    }
+	    if (other_renderer)
+	      {
+		other_renderer->take_band(other_image_data);
+		for (size_t i=0;i<image_data.size();i++)
+		  for (uint shift=0;shift<24;shift+=8)
+		    squared_error+=sqr(static_cast<double>((image_data[i]>>shift)&0xff)-static_cast<double>((other_image_data[i]>>shift)&0xff));
+	      }
+
+	    // Bands are taken from the renderer in order, so they're written in order however they were rendered.
+	    if (out && !write_rows(*out,(output_filename=="-" ? stream_format : "ppm"),image_data))
+	      {
+		std::cerr << "evolvotron_render: Error: Couldn't write frame to ";
+		if (output_filename=="-")
+		  std::cerr << "standard output\n";
+		else
+		  std::cerr << "file " << save_filename.toLocal8Bit().data() << "\n";
+		return 1;
+	      }
+	  }
+
+	std::clog << "\nFrame " << frame << ": evaluated " << samples/(static_cast<double>(width)*height) << " samples per pixel\n";
+
+	if (other_renderer)
+	  {
+	    const double mse=squared_error/(3.0*width*height);
+	    std::cerr << "Frame " << frame << ": PSNR between float and double evaluation ";
+	    if (mse==0.0)
+	      std::cerr << "infinite (identical)\n";
+	    else
+	      std::cerr << 10.0*log10(255.0*255.0/mse) << "dB\n";
+	  }
+
+	if (output_filename=="-")
+	  {
+	    std::clog << "Wrote frame " << frame << " to standard output\n";
+	    continue;
+	  }
+
+	if (!banded)
+	  {
+	    QImage image
+	      (
+	       reinterpret_cast<uchar*>(&(image_data[0])),
+	       width,
+	       height,
+	       QImage::Format_RGB32
+	       );
+
+	    if (!image.save(save_filename,save_format))
+	      {
+		std::cerr 
+		  << "evolvotron_render: Error: Couldn't save file "
+		  << save_filename.toLocal8Bit().data()
+		  << "\n";
+		return 1;
+	      }
+	  }
 	
-	  std::clog
-	    << "Wrote file " 
-	    << save_filename.toLocal8Bit().data()
-	    << "\n";
-	}
+	std::clog
+	  << "Wrote file " 
+	  << save_filename.toLocal8Bit().data()
+	  << "\n";
       }
   }
   
@@ -0,0 +1,117 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Implementation of class AdaptiveMultisampling.
+*/
+
+#include "adaptive_multisampling.h"
+
+//! Largest difference between any colour component of two 0xRRGGBB colours.
+static uint colour_difference(uint a,uint b)
+{
+  uint ret=0;
+  for (uint shift=0;shift<24;shift+=8)
+    {
+      const int d=static_cast<int>((a>>shift)&0xff)-static_cast<int>((b>>shift)&0xff);
+      ret=std::max(ret,static_cast<uint>(abs(d)));
+    }
+  return ret;
+}
+
+//! Largest difference between a pixel's colour and any of its 8 neighbours' (those inside the image).
+static uint contrast(const std::vector<uint>& colours,uint width,uint height,uint x,uint y)
+{
+  const uint c=colours[y*width+x];
+  uint ret=0;
+  for (uint ny=(y>0 ? y-1 : y);ny<=y+1 && ny<height;ny++)
+    for (uint nx=(x>0 ? x-1 : x);nx<=x+1 && nx<width;nx++)
+      ret=std::max(ret,colour_difference(c,colours[ny*width+nx]));
+  return ret;
+}
+
+/*! Picks the highest contrast pixels first; among pixels of equal contrast, those first in row order.
+ */
+uint AdaptiveMultisampling::choose(const std::vector<uint>& colours,uint width,uint height,uint x0,uint y0,uint w,uint h,uint multisample,real budget,std::vector<bool>& chosen)
+{
+  std::vector<uint> histogram;
+  contrasts(colours,width,height,x0,y0,w,h,histogram);
+
+  uint ties;
+  const uint c=cutoff(histogram,affordable(real(w)*h,multisample,budget),ties);
+  return choose(colours,width,height,x0,y0,w,h,c,ties,chosen);
+}
+
+uint AdaptiveMultisampling::choose(const std::vector<uint>& colours,uint width,uint height,uint x0,uint y0,uint w,uint h,uint cutoff,uint ties,std::vector<bool>& chosen)
+{
+  assert(colours.size()==width*height);
+  assert(x0+w<=width && y0+h<=height);
+
+  chosen.assign(w*h,false);
+
+  uint ret=0;
+  for (uint y=y0;y<y0+h;y++)
+    for (uint x=x0;x<x0+w;x++)
+      {
+	const uint c=contrast(colours,width,height,x,y);
+	if (c>cutoff || (c==cutoff && ties>0))
+	  {
+	    if (c==cutoff) ties--;
+	    chosen[(y-y0)*w+(x-x0)]=true;
+	    ret++;
+	  }
+      }
+  return ret;
+}
+
+void AdaptiveMultisampling::contrasts(const std::vector<uint>& colours,uint width,uint height,uint x0,uint y0,uint w,uint h,std::vector<uint>& histogram)
+{
+  assert(colours.size()==width*height);
+  assert(x0+w<=width && y0+h<=height);
+
+  histogram.resize(256,0);
+  for (uint y=y0;y<y0+h;y++)
+    for (uint x=x0;x<x0+w;x++)
+      histogram[contrast(colours,width,height,x,y)]++;
+}
+
+uint AdaptiveMultisampling::affordable(real pixels,uint multisample,real budget)
+{
+  // Each chosen pixel costs multisample*multisample samples on top of the single sample every pixel has had.
+  return static_cast<uint>(std::max(0.0,(budget-1.0)*pixels/(multisample*multisample)));
+}
+
+/*! Only pixels with contrast above threshold() are ever chosen.
+ */
+uint AdaptiveMultisampling::cutoff(const std::vector<uint>& histogram,uint affordable,uint& ties)
+{
+  uint total=0;
+  for (uint c=255;c>threshold();c--)
+    {
+      if (histogram[c]>affordable-total)
+	{
+	  ties=affordable-total;
+	  return c;
+	}
+      total+=histogram[c];
+    }
+  ties=0;
+  return threshold();
+}
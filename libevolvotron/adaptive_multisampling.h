@@ -0,0 +1,74 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file 
+  \brief Interface for class AdaptiveMultisampling.
+*/
+
+#ifndef _adaptive_multisampling_h_
+#define _adaptive_multisampling_h_
+
+#include "common.h"
+#include "useful.h"
+
+//! Chooses which pixels of an image are worth multisampling, given a single sampled rendering of it.
+/*! Only pixels differing from one of their 8 neighbours by more than threshold() in some colour component are chosen:
+  multisampling flat or smoothly varying regions is wasted effort.
+  If that would take more samples than a budget allows, the highest contrast pixels are chosen first.
+ */
+class AdaptiveMultisampling
+{
+ public:
+
+  //! Difference between neighbouring pixels' colour components (0-255) above which a pixel is worth multisampling.
+  static uint threshold()
+    {
+      return 8;
+    }
+
+  //! Choose pixels to multisample.
+  /*! colours holds a width by height region of single sampled (0xRRGGBB) pixel colours.
+    Pixels are chosen from the w by h rectangle at (x0,y0) within it (the rest are only used as neighbours),
+    with chosen set to w*h flags in row order.
+    The budget is the most samples per pixel to be evaluated on average, counting the single sample:
+    each chosen pixel then takes another multisample*multisample.
+    Returns the number of pixels chosen.
+   */
+  static uint choose(const std::vector<uint>& colours,uint width,uint height,uint x0,uint y0,uint w,uint h,uint multisample,real budget,std::vector<bool>& chosen);
+
+  //! Choose the pixels of a region with contrast above cutoff, and the first ties (in row order) with contrast equal to it.
+  /*! Arguments as for choose, with the cutoff and ties found by cutoff() from the contrasts of the whole image the region is part of,
+    so an image can be split into regions (bands, say) which between them choose exactly the pixels choosing over the whole image would.
+   */
+  static uint choose(const std::vector<uint>& colours,uint width,uint height,uint x0,uint y0,uint w,uint h,uint cutoff,uint ties,std::vector<bool>& chosen);
+
+  //! Add the contrast of each pixel of a region (arguments as for choose) to a histogram of the contrasts 0-255.
+  static void contrasts(const std::vector<uint>& colours,uint width,uint height,uint x0,uint y0,uint w,uint h,std::vector<uint>& histogram);
+
+  //! Most pixels of an image which can be multisampled within a budget (as for choose).
+  static uint affordable(real pixels,uint multisample,real budget);
+
+  //! Contrast above which every pixel is chosen, given a histogram of contrasts and the number of pixels affordable.
+  /*! ties is set to the number of pixels with exactly that contrast which are also chosen (the first in row order).
+   */
+  static uint cutoff(const std::vector<uint>& histogram,uint affordable,uint& ties);
+};
+
+#endif
@@ -28,12 +28,15 @@
 #include <stack>
 
 #include <QApplication>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QButtonGroup>
 #include <QCheckBox>
 #include <QComboBox>
 #include <QCursor>
 #include <QDateTime>
 #include <QDialog>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QGroupBox>
 #include <QImage>
@@ -201,6 +201,8 @@ EvolvotronMain::EvolvotronMain
  bool autocool,
  bool jitter,
  uint multisample_level,
+ bool single_precision,
+ real multisample_budget,
  bool function_debug_mode,
  bool linear_zsweep,
  bool spheremap,
@@ -214,7 +216,7 @@ EvolvotronMain::EvolvotronMain
   ,_startup_filenames(startup_filenames)
   ,_startup_shuffle(startup_shuffle)
   ,_mutation_parameters(time(0),autocool,function_debug_mode,this)
-  ,_render_parameters(jitter,multisample_level,this)
+  ,_render_parameters(jitter,multisample_level,single_precision,multisample_budget,this)
   ,_statusbar_tasks_main(0)
   ,_statusbar_tasks_enlargement(0)
   ,_last_spawn_method(&EvolvotronMain::spawn_normal)
@@ -320,6 +320,8 @@ class EvolvotronMain : public QMainWindow
      bool autocool,
      bool jitter,
      uint multisample_level,
+     bool single_precision,
+     real multisample_budget,
      bool function_debug_mode,
      bool linear_zsweep,
      bool spheremap,
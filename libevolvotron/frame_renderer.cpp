@@ -0,0 +1,347 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+/*! \file
+  \brief Implementation of class FrameRenderer.
+*/
+
+#include "frame_renderer.h"
+
+#include "adaptive_multisampling.h"
+#include "random.h"
+
+//! Pack the 0-255-scaled colour of sample i of a block into a 0xRRGGBB pixel.
+static uint pixel_colour(const XYZBlock& colours,uint i)
+{
+  const uint col0=lrint(colours.x()[i]);
+  const uint col1=lrint(colours.y()[i]);
+  const uint col2=lrint(colours.z()[i]);
+  return ((col0<<16)|(col1<<8)|(col2));
+}
+
+FrameRenderer::FrameRenderer(const MutatableImage& imagefn,int width,int height,uint frames,bool jitter,int multisample,bool single_precision,real sample_budget,uint threads,int band_rows,bool progress)
+  :_imagefn(imagefn)
+  ,_width(width)
+  ,_height(height)
+  ,_frames(frames)
+  ,_jitter(jitter)
+  ,_multisample(multisample)
+  ,_single_precision(single_precision)
+  ,_sample_budget(sample_budget)
+  ,_band_rows(std::min(band_rows,height))
+  ,_tiles(((width+tile_side()-1)/tile_side())*((height+tile_side()-1)/tile_side()))
+  ,_bands_started(0)
+  ,_tiles_done(0)
+  ,_progress(frames*(surveyed() ? 3 : adaptive() ? 2 : 1)*_tiles,progress)
+  ,_abandon(false)
+{
+  assert(_band_rows==height || _band_rows%tile_side()==0);
+
+  for (uint i=0;i<threads;i++)
+    {
+      _threads.push_back(new FrameRendererThread(*this));
+      _threads.back().start();
+    }
+}
+
+FrameRenderer::~FrameRenderer()
+{
+  {
+    QMutexLocker lock(&_mutex);
+    _abandon=true;
+    _work.wakeAll();
+  }
+  for (boost::ptr_vector<FrameRendererThread>::iterator it=_threads.begin();it!=_threads.end();it++)
+    (*it).wait();
+}
+
+int FrameRenderer::band_rows_for_memory(unsigned long long int max_memory,int width)
+{
+  if (max_memory==0)
+    return 0;
+
+  // Each band holds a packed pixel (plus a bit for adaptive multisampling) for each of its rows and two border rows.
+  const unsigned long long int bytes_per_row=(sizeof(uint)*8+1)*static_cast<unsigned long long int>(width)/8;
+  const unsigned long long int rows=max_memory/((max_bands_in_flight()+1)*bytes_per_row);
+  if (rows<static_cast<unsigned long long int>(tile_side()+2))
+    return 0;
+
+  return std::min((rows-2)/tile_side(),static_cast<unsigned long long int>(std::numeric_limits<int>::max()/tile_side()))*tile_side();
+}
+
+unsigned long long int FrameRenderer::take_band(std::vector<uint>& image_data)
+{
+  QMutexLocker lock(&_mutex);
+  while (_bands_in_flight.empty() || !_bands_in_flight.front().completed)
+    _completed.wait(&_mutex);
+
+  image_data.swap(_bands_in_flight.front().image_data);
+  const unsigned long long int samples=_bands_in_flight.front().samples;
+  _bands_in_flight.pop_front();
+
+  // Room for another band
+  _work.wakeAll();
+
+  return samples;
+}
+
+void FrameRenderer::render()
+{
+  XYZBlock colours;
+  MutatableImage::Scratch scratch;
+
+  QMutexLocker lock(&_mutex);
+  while (!_abandon)
+    {
+      // Take a tile from the earliest band with any left, or else start a new band if there's room.
+      Band* band=0;
+      for (std::list<Band>::iterator it=_bands_in_flight.begin();it!=_bands_in_flight.end() && !band;it++)
+	if (!(*it).completed && !(*it).choosing && (*it).next_tile<tiles(*it))
+	  band=&(*it);
+
+      if (!band && _bands_started<_frames*band_slots() && _bands_in_flight.size()<max_bands_in_flight())
+	{
+	  const uint f=_bands_started/band_slots();
+	  const uint b=_bands_started%bands();
+	  const bool survey=(surveyed() && _bands_started%band_slots()<bands());
+
+	  // A surveyed frame's bands wait for all of its survey bands, which say how many pixels each band can multisample.
+	  if (!surveyed() || survey || _budgets[f].surveyed==bands())
+	    {
+	      const int y0=b*_band_rows;
+	      const int y1=std::min(y0+_band_rows,_height);
+
+	      // For adaptive multisampling, the single sampled pass includes the rows bordering the band.
+	      const int border=(adaptive() ? 1 : 0);
+	      _bands_in_flight.push_back(Band(f,b,survey,y0,y1,std::max(y0-border,0),std::min(y1+border,_height),_width));
+	      _bands_started++;
+	      band=&_bands_in_flight.back();
+
+	      if (surveyed() && !survey)
+		{
+		  band->cutoff=_budgets[f].cutoff;
+		  band->ties=_budgets[f].ties[b];
+		}
+	    }
+	}
+
+      if (!band)
+	{
+	  // Finished if every band has been started and the ones not yet taken are completed.
+	  bool finished=(_bands_started==_frames*band_slots());
+	  for (std::list<Band>::const_iterator it=_bands_in_flight.begin();it!=_bands_in_flight.end();it++)
+	    finished=(finished && (*it).completed);
+	  if (finished)
+	    break;
+
+	  _work.wait(&_mutex);
+	  continue;
+	}
+
+      const uint tile=band->next_tile;
+      band->next_tile++;
+
+      // A band's image and pass don't change while any of its tiles are being rendered.
+      lock.unlock();
+      render_tile(*band,tile,colours,scratch);
+      lock.relock();
+
+      _tiles_done++;
+      _progress.tiles_done(_tiles_done);
+
+      band->tiles_done++;
+      if (band->tiles_done<tiles(*band))
+	continue;
+
+      if (adaptive() && band->pass==0)
+	{
+	  // Choose the pixels for the second pass (or survey the band).  No other thread touches the band meanwhile.
+	  band->choosing=true;
+	  lock.unlock();
+	  choose(*band);
+	  lock.relock();
+	  band->choosing=false;
+
+	  if (band->survey)
+	    {
+	      Budget& budget=_budgets[band->frame];
+	      budget.histograms.resize(bands());
+	      budget.samples.resize(bands(),0);
+	      budget.histograms[band->band].swap(band->histogram);
+	      budget.samples[band->band]=band->samples;
+	      budget.surveyed++;
+	      if (budget.surveyed==bands())
+		split_budget(budget);
+
+	      // Nothing else refers to a survey band once it's done with.
+	      for (std::list<Band>::iterator it=_bands_in_flight.begin();it!=_bands_in_flight.end();it++)
+		if (&(*it)==band)
+		  {
+		    _bands_in_flight.erase(it);
+		    break;
+		  }
+	      _work.wakeAll();
+	      continue;
+	    }
+
+	  if (surveyed())
+	    {
+	      // The samples of the band's survey count too.
+	      Budget& budget=_budgets[band->frame];
+	      band->samples+=budget.samples[band->band];
+	      budget.chosen++;
+	      if (budget.chosen==bands())
+		_budgets.erase(band->frame);
+	    }
+
+	  band->pass=1;
+	  band->next_tile=0;
+	  band->tiles_done=0;
+	  _work.wakeAll();
+	}
+      else
+	{
+	  if (adaptive())
+	    {
+	      // Drop the border rows
+	      band->image_data.erase(band->image_data.begin(),band->image_data.begin()+(band->y0-band->data_y0)*_width);
+	      band->image_data.resize((band->y1-band->y0)*_width);
+	      band->data_y0=band->y0;
+	      band->data_y1=band->y1;
+	    }
+	  else
+	    {
+	      band->samples=static_cast<unsigned long long int>(_width)*(band->y1-band->y0)*_multisample*_multisample;
+	    }
+	  band->completed=true;
+	  _completed.wakeAll();
+
+	  // Threads waiting for work may now be finished
+	  _work.wakeAll();
+	}
+    }
+}
+
+void FrameRenderer::render_tile(Band& band,uint tile,XYZBlock& colours,MutatableImage::Scratch& scratch) const
+{
+  const int x0=(tile%tiles_across())*tile_side();
+  const int y0=band.y0+(tile/tiles_across())*tile_side();
+  const int x1=std::min(x0+tile_side(),_width);
+  const int y1=std::min(y0+tile_side(),band.y1);
+
+  if (adaptive() && band.pass==0)
+    {
+      for (int row=y0;row<y1;row++)
+	{
+	  Random01 r01(23+2*_frames*_tiles+(band.frame*_height+row)*tiles_across()+x0/tile_side());
+	  render_run(band,row,x0,x1,&r01,colours,scratch);
+	}
+    }
+  else
+    {
+      // Seed values pretty unimportant (only used for sample jitter), but each frame's passes' tiles get their own.
+      // The tile's number in the whole frame is used, so the seeds don't depend on the band size.
+      Random01 r01(23+(2*band.frame+band.pass)*_tiles+(y0/tile_side())*tiles_across()+x0/tile_side());
+      for (int row=y0;row<y1;row++)
+	render_run(band,row,x0,x1,&r01,colours,scratch);
+    }
+}
+
+void FrameRenderer::render_run(Band& band,int row,int x0,int x1,Random01* r01,XYZBlock& colours,MutatableImage::Scratch& scratch) const
+{
+  const bool adaptive_pass=(adaptive() && band.pass==1);
+  const int multisample=((adaptive() && band.pass==0) ? 1 : _multisample);
+
+  // Runs of chosen pixels (or the whole run) at a time, so the function is evaluated in batches.
+  for (int col=x0;col<x1;)
+    {
+      if (adaptive_pass && !band.chosen[(row-band.y0)*_width+col])
+	{
+	  col++;
+	  continue;
+	}
+
+      int end=col+1;
+      while (end<x1 && (!adaptive_pass || band.chosen[(row-band.y0)*_width+end])) end++;
+
+      colours.resize(end-col);
+      _imagefn.get_rgb(col,row,band.frame,_width,_height,_frames,(_jitter ? r01 : 0),multisample,_single_precision,colours,scratch);
+      for (int i=col;i<end;i++)
+	band.image_data[(row-band.data_y0)*_width+i]=pixel_colour(colours,i-col);
+
+      col=end;
+    }
+}
+
+void FrameRenderer::choose(Band& band) const
+{
+  // The border rows are rendered exactly as the bands they belong to render them.
+  XYZBlock colours;
+  MutatableImage::Scratch scratch;
+  for (int row=band.data_y0;row<band.data_y1;row++)
+    {
+      if (row>=band.y0 && row<band.y1)
+	continue;
+
+      for (int x0=0;x0<_width;x0+=tile_side())
+	{
+	  Random01 r01(23+2*_frames*_tiles+(band.frame*_height+row)*tiles_across()+x0/tile_side());
+	  render_run(band,row,x0,std::min(x0+tile_side(),_width),&r01,colours,scratch);
+	}
+    }
+
+  band.samples=static_cast<unsigned long long int>(_width)*(band.data_y1-band.data_y0);
+  if (band.survey)
+    {
+      AdaptiveMultisampling::contrasts(band.image_data,_width,band.data_y1-band.data_y0,0,band.y0-band.data_y0,_width,band.y1-band.y0,band.histogram);
+      return;
+    }
+
+  const uint chosen
+    =(
+      surveyed()
+      ?
+      AdaptiveMultisampling::choose(band.image_data,_width,band.data_y1-band.data_y0,0,band.y0-band.data_y0,_width,band.y1-band.y0,band.cutoff,band.ties,band.chosen)
+      :
+      AdaptiveMultisampling::choose(band.image_data,_width,band.data_y1-band.data_y0,0,band.y0-band.data_y0,_width,band.y1-band.y0,_multisample,_sample_budget,band.chosen)
+      );
+  band.samples+=static_cast<unsigned long long int>(_multisample*_multisample)*chosen;
+}
+
+/*! Pixels of the cutoff contrast are chosen first in row order, and the bands are in row order,
+  so each band's share of the ties is what's left of them after the bands above it have had theirs.
+ */
+void FrameRenderer::split_budget(Budget& budget) const
+{
+  std::vector<uint> histogram(256,0);
+  for (uint b=0;b<bands();b++)
+    for (uint c=0;c<histogram.size();c++)
+      histogram[c]+=budget.histograms[b][c];
+
+  uint ties;
+  budget.cutoff=AdaptiveMultisampling::cutoff(histogram,AdaptiveMultisampling::affordable(real(_width)*_height,_multisample,_sample_budget),ties);
+
+  budget.ties.resize(bands());
+  for (uint b=0;b<bands();b++)
+    {
+      budget.ties[b]=std::min(ties,budget.histograms[b][budget.cutoff]);
+      ties-=budget.ties[b];
+    }
+  budget.histograms.clear();
+}
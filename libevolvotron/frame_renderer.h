@@ -0,0 +1,321 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+/*! \file
+  \brief Interface for class FrameRenderer.
+*/
+
+#ifndef _frame_renderer_h_
+#define _frame_renderer_h_
+
+#include "common.h"
+#include "useful.h"
+
+#include "mutatable_image.h"
+
+#include <list>
+
+class FrameRendererThread;
+
+//! Renders the frames of an animation in order with a pool of threads, for another thread to take as they complete.
+/*! Frames are rendered in bands of rows (the whole frame, unless that would take too much memory), split into fixed size tiles.
+  The threads take tiles from the earliest band which has some left,
+  starting on the next band as soon as there are none, so a band's last few tiles don't leave threads idle.
+  Only a few bands are in flight at once (including those completed but not yet taken):
+  the threads wait for the taker if it falls behind, so memory use is bounded however many frames there are and however big they are.
+
+  Given a sample budget (and multisampling), each band is rendered single sampled first,
+  and then only the pixels AdaptiveMultisampling chooses from that are multisampled.
+  The single sampled pass also covers the rows bordering the band, so the contrasts don't depend on the band size.
+  The budget is for the whole frame: when a frame is in several bands, its single sampled pass is first rendered as survey bands
+  (which are never taken), just to find the contrasts of all its pixels,
+  and from those the pixels the whole frame can afford are split between its bands,
+  so the bands choose exactly the pixels a single band would.
+
+  Each tile's samples are jittered by its own random number generator, seeded from the frame, pass and tile
+  (or for the single sampled pass of adaptive multisampling, each row of the tile's, so the border rows come out the same again),
+  so the images don't depend on the number of threads, the band size, or on which thread renders which tile.
+ */
+class FrameRenderer : boost::noncopyable
+{
+ public:
+  //! Constructor.  Starts the threads.
+  /*! band_rows should be a multiple of tile_side(), unless it's at least the height.
+   */
+  FrameRenderer(const MutatableImage& imagefn,int width,int height,uint frames,bool jitter,int multisample,bool single_precision,real sample_budget,uint threads,int band_rows,bool progress);
+
+  //! Destructor.  Abandons any frames not yet rendered.
+  ~FrameRenderer();
+
+  //! Wait for the next band to be completed and take its image (0xRRGGBB pixels in row order).
+  /*! Bands are taken in order: all the bands of frame 0 from the top down, then those of frame 1 and so on.
+    Returns the number of samples evaluated for the band.
+   */
+  unsigned long long int take_band(std::vector<uint>& image_data);
+
+  //! Render tiles until there are none left.  Run by each of the threads.
+  void render();
+
+  //! Side of the (square) tiles, in pixels.
+  static int tile_side()
+    {
+      return 64;
+    }
+
+  //! Most bands in flight at once.
+  static uint max_bands_in_flight()
+    {
+      return 4;
+    }
+
+  //! Largest number of rows in a band (a multiple of tile_side()) keeping the memory used by the bands in flight, and the one last taken, within max_memory bytes.
+  /*! Returns 0 if even a band of tile_side() rows would use more, or max_memory is 0 (which means the whole frame should be a single band).
+   */
+  static int band_rows_for_memory(unsigned long long int max_memory,int width);
+
+  //! Number of bands in each frame.
+  uint bands() const
+    {
+      return (_height+_band_rows-1)/_band_rows;
+    }
+
+  //! Whether frames are surveyed to split the sample budget between their bands.
+  bool surveyed() const
+    {
+      return (adaptive() && bands()>1);
+    }
+
+  //! Number of bands started for each frame (bands(), plus as many survey bands if surveyed).
+  uint band_slots() const
+    {
+      return (surveyed() ? 2 : 1)*bands();
+    }
+
+  //! Number of rows in each band (the last band in each frame may have fewer).
+  int band_rows() const
+    {
+      return _band_rows;
+    }
+
+ private:
+
+  //! Logs progress through a number of tiles to std::clog, in 5% steps.
+  class Progress
+  {
+   public:
+    //! Constructor, given the total number of tiles to be rendered.
+    Progress(uint total,bool enabled)
+      :_total(total)
+      ,_enabled(enabled)
+      ,_report(1)
+      {}
+
+    //! Note that n tiles have now been rendered.
+    void tiles_done(uint n)
+      {
+	const uint reports=20;
+	while (_enabled && _report<=reports && n>=(_report*_total)/reports)
+	  {
+	    std::clog << "[" << (100*_report)/reports << "%]";
+	    _report++;
+	  }
+      }
+
+   private:
+    const uint _total;
+    const bool _enabled;
+    uint _report;
+  };
+
+  //! A band in flight.
+  struct Band
+  {
+    Band(uint f,uint b,bool s,int by0,int by1,int dy0,int dy1,int width)
+      :frame(f)
+      ,band(b)
+      ,survey(s)
+      ,y0(by0)
+      ,y1(by1)
+      ,data_y0(dy0)
+      ,data_y1(dy1)
+      ,image_data((dy1-dy0)*width)
+      ,pass(0)
+      ,next_tile(0)
+      ,tiles_done(0)
+      ,choosing(false)
+      ,completed(false)
+      ,samples(0)
+      ,cutoff(0)
+      ,ties(0)
+    {}
+
+    uint frame;
+    uint band;
+
+    //! Whether this is a survey band, rendered only to find the contrasts of its pixels.
+    bool survey;
+
+    //! The rows of the band.
+    int y0;
+    int y1;
+
+    //! The rows held in image_data (which includes the border rows for adaptive multisampling until the band is completed).
+    int data_y0;
+    int data_y1;
+
+    std::vector<uint> image_data;
+
+    //! Pixels of the band to be multisampled by the second pass, when multisampling adaptively.
+    std::vector<bool> chosen;
+
+    uint pass;
+    uint next_tile;
+    uint tiles_done;
+
+    //! Set while the pixels to multisample are being chosen, between the passes.
+    bool choosing;
+
+    bool completed;
+    unsigned long long int samples;
+
+    //! For a surveyed frame's bands, the cutoff and ties for AdaptiveMultisampling::choose.
+    uint cutoff;
+    uint ties;
+
+    //! For a survey band, the histogram of its pixels' contrasts.
+    std::vector<uint> histogram;
+  };
+
+  //! What's known of how a surveyed frame's sample budget is split between its bands.
+  struct Budget
+  {
+    Budget()
+      :surveyed(0)
+      ,cutoff(0)
+      ,chosen(0)
+    {}
+
+    //! The histogram of each band's contrasts, and the samples its survey band evaluated.
+    std::vector<std::vector<uint> > histograms;
+    std::vector<unsigned long long int> samples;
+
+    //! Number of survey bands completed.
+    uint surveyed;
+
+    //! Once every band is surveyed, the cutoff for the whole frame and each band's share of the ties.
+    uint cutoff;
+    std::vector<uint> ties;
+
+    //! Number of bands which have chosen their pixels.
+    uint chosen;
+  };
+
+  //! Split a surveyed frame's budget between its bands, once all their contrasts are known.
+  void split_budget(Budget& budget) const;
+
+  //! Whether the frames have a second, adaptive multisampling, pass.
+  bool adaptive() const
+    {
+      return (_multisample>1 && _sample_budget>0.0);
+    }
+
+  //! Number of tiles across the image.
+  uint tiles_across() const
+    {
+      return (_width+tile_side()-1)/tile_side();
+    }
+
+  //! Number of tiles covering a band.
+  uint tiles(const Band& band) const
+    {
+      return tiles_across()*((band.y1-band.y0+tile_side()-1)/tile_side());
+    }
+
+  //! Render a tile (numbered within the band) of a band's current pass.  Called without the mutex locked.
+  void render_tile(Band& band,uint tile,XYZBlock& colours,MutatableImage::Scratch& scratch) const;
+
+  //! Render a run of pixels along a row of a band's image data (only the chosen ones, in the second pass of adaptive multisampling).
+  void render_run(Band& band,int row,int x0,int x1,Random01* r01,XYZBlock& colours,MutatableImage::Scratch& scratch) const;
+
+  //! Render the border rows of a band's single sampled pass and choose the pixels to multisample (or for a survey band, find the contrasts).  Called without the mutex locked.
+  void choose(Band& band) const;
+
+  const MutatableImage& _imagefn;
+  const int _width;
+  const int _height;
+  const uint _frames;
+  const bool _jitter;
+  const int _multisample;
+  const bool _single_precision;
+  const real _sample_budget;
+  const int _band_rows;
+
+  //! Number of tiles covering each frame.
+  const uint _tiles;
+
+  //! Protects everything below.
+  QMutex _mutex;
+
+  //! Signalled when there may be more tiles to render (or the renderer is being destroyed).
+  QWaitCondition _work;
+
+  //! Signalled when a band is completed.
+  QWaitCondition _completed;
+
+  //! Bands started but not yet taken, in order.
+  std::list<Band> _bands_in_flight;
+
+  //! The budgets of the surveyed frames whose bands haven't all chosen their pixels yet.
+  std::map<uint,Budget> _budgets;
+
+  //! Number of bands started (over all the frames).
+  uint _bands_started;
+
+  //! Number of tiles rendered, over all the frames and passes.
+  uint _tiles_done;
+
+  Progress _progress;
+
+  //! Set by the destructor to stop the threads.
+  bool _abandon;
+
+  boost::ptr_vector<FrameRendererThread> _threads;
+};
+
+//! One of a FrameRenderer's threads.
+class FrameRendererThread : public QThread
+{
+ public:
+  //! Constructor.
+  FrameRendererThread(FrameRenderer& renderer)
+    :_renderer(renderer)
+    {}
+
+ protected:
+  //! Render tiles until there are none left.
+  virtual void run()
+    {
+      _renderer.render();
+    }
+
+ private:
+  FrameRenderer& _renderer;
+};
+
+#endif
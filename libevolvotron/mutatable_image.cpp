@@ -26,12 +26,17 @@
 #include "mutatable_image.h"
 
 #include "function_node_info.h"
+#include "function_profile.h"
+#include "function_program.h"
 #include "function_top.h"
 #include "mutatable_image_display_big.h"
 #include "random.h"
 #include "transform.h"
 
 unsigned long long MutatableImage::_count=0;
+unsigned long long MutatableImage::_programs_compiled=0;
+unsigned long long MutatableImage::_programs_sharing=0;
+unsigned long long MutatableImage::_subexpressions_shared=0;
 
 MutatableImage::MutatableImage(std::unique_ptr<FunctionTop>& r,bool sinz,bool sm,bool lock)
   :_top(r.release())
@@ -41,6 +46,7 @@ MutatableImage::MutatableImage(std::unique_ptr<FunctionTop>& r,bool sinz,bool sm
   ,_serial(_count++)
 {
   assert(_top.get()!=0);
+  prepare_evaluation();
 }
 
 MutatableImage::MutatableImage(const MutationParameters& parameters,bool exciting,bool sinz,bool sm)
@@ -54,12 +60,41 @@ MutatableImage::MutatableImage(const MutationParameters& parameters,bool excitin
   boost::ptr_vector<FunctionNode> av;
   av.push_back(FunctionNode::stub(parameters,exciting).release());
   _top=std::unique_ptr<FunctionTop>(new FunctionTop(pv,av,0));
+  prepare_evaluation();
   //! \todo _sinusoidal_z should be obtained from AnimationParameters when it exists
 }
 
 MutatableImage::~MutatableImage()
 {}
 
+void MutatableImage::prepare_evaluation()
+{
+  _evaluation_top=_top->typed_deepclone();
+  _evaluation_top->optimise();
+
+  uint nodes_before,nodes_after;
+  uint parameters;
+  uint depth;
+  uint width;
+  real proportion_constant;
+  _top->get_stats(nodes_before,parameters,depth,width,proportion_constant);
+  _evaluation_top->get_stats(nodes_after,parameters,depth,width,proportion_constant);
+  _program=FunctionProgram::compile(*_evaluation_top);
+  _estimated_cost=_evaluation_top->estimated_cost();
+  _needs_double=_evaluation_top->needs_double();
+
+  _programs_compiled++;
+  if (_program->shared()) _programs_sharing++;
+  _subexpressions_shared+=_program->shared();
+
+  std::clog
+    << "Image " << _serial << " optimised from " << nodes_before << " to " << nodes_after << " nodes, "
+    << _program->shared() << " common subexpressions shared"
+    << " (sharing found in " << _programs_sharing << " of " << _programs_compiled << " programs so far, "
+    << _subexpressions_shared << " shared in all), estimated cost " << _estimated_cost << "ns per sample"
+    << (_needs_double ? ", always evaluated in double" : "") << "\n";
+}
+
 //! Accessor.
 const FunctionTop& MutatableImage::top() const
 {
@@ -143,7 +178,7 @@ const XYZ MutatableImage::get_rgb(const XYZ& p) const
 {
   // Actually calculate a pixel value from the image.
   // negexp distribution on colour-space parameters probably means the nominal range is something like -4.0 to 4.0
-  const XYZ pv(top()(p));
+  const XYZ pv((*_evaluation_top)(p));
 
   // Scale a nominal -2.0 to 2.0 range to 0-255
   return 127.5*(0.5*pv+XYZ(1.0,1.0,1.0));
@@ -186,9 +221,113 @@ const XYZ MutatableImage::get_rgb(uint x,uint y,uint f,uint width,uint height,ui
   return accumulated_colour;
 }
 
-void MutatableImage::get_stats(uint& total_nodes,uint& total_parameters,uint& depth,uint& width,real& proportion_constant) const
+/*! Samples are evaluated by the compiled program in batches of bounded size,
+  to keep the program's registers (and any intermediate buffers used by function nodes) cache-sized.
+ */
+void MutatableImage::get_rgb(uint x,uint y,uint f,uint width,uint height,uint frames,Random01* r01,uint multisample,bool single_precision,XYZBlock& out,Scratch& scratch,uint subsample,uint stride) const
+{
+  const uint max_batch_samples=256;
+  const uint n=out.size();
+  const uint samples_per_pixel=multisample*multisample;
+  const uint batch_pixels=std::max(1u,max_batch_samples/samples_per_pixel);
+
+  XYZBlock& samples=scratch.samples;
+  XYZBlock& values=scratch.values;
+
+  for (uint batch_start=0;batch_start<n;batch_start+=batch_pixels)
+    {
+      const uint pixels=std::min(batch_pixels,n-batch_start);
+
+      samples.resize(pixels*samples_per_pixel);
+      uint s=0;
+      for (uint i=0;i<pixels;i++)
+	for (uint sy=0;sy<multisample;sy++)
+	  for (uint sx=0;sx<multisample;sx++)
+	    {
+	      const real jx=(r01 ? (*r01)() : 0.5);
+	      const real jy=(r01 ? (*r01)() : 0.5);
+	      samples.set
+		(
+		 s++,
+		 sampling_coordinate
+		 (
+		  (x+(batch_start+i)*stride)*subsample+(sx+jx)/multisample,
+		  y*subsample+(sy+jy)/multisample,
+		  f,
+		  width,
+		  height,
+		  frames
+		  )
+		 );
+	    }
+
+      if (single_precision && !_needs_double)
+	{
+	  scratch.samples_float.assign(samples);
+	  _program->execute(scratch.samples_float,scratch.values_float,scratch.registers);
+	  values.assign(scratch.values_float);
+	}
+      else
+	{
+	  _program->execute(samples,values,scratch.registers);
+	}
+
+      // Scale a nominal -2.0 to 2.0 range to 0-255 (same operations as the single sample get_rgb)
+      values*=0.5;
+      values+=XYZ(1.0,1.0,1.0);
+      values*=127.5;
+
+      const real*const vx=values.x();
+      const real*const vy=values.y();
+      const real*const vz=values.z();
+      s=0;
+      for (uint i=0;i<pixels;i++)
+	{
+	  XYZ accumulated_colour(0.0,0.0,0.0);
+	  for (uint k=0;k<samples_per_pixel;k++,s++)
+	    accumulated_colour+=XYZ(vx[s],vy[s],vz[s]);
+
+	  accumulated_colour/=samples_per_pixel;
+
+	  accumulated_colour.x(clamped(accumulated_colour.x(),0.0,255.0));
+	  accumulated_colour.y(clamped(accumulated_colour.y(),0.0,255.0));
+	  accumulated_colour.z(clamped(accumulated_colour.z(),0.0,255.0));
+
+	  out.set(batch_start+i,accumulated_colour);
+	}
+    }
+}
+
+std::unique_ptr<FunctionProfile> MutatableImage::profile(uint width,uint height,uint frames,uint multisample) const
+{
+  const uint max_batch_samples=256;
+  std::unique_ptr<FunctionProfile> profile(new FunctionProfile(*_evaluation_top));
+
+  std::vector<XYZ> samples;
+  std::vector<XYZ> values(max_batch_samples);
+  for (uint f=0;f<frames;f++)
+    for (uint y=0;y<height;y++)
+      for (uint x=0;x<width;x++)
+	for (uint sy=0;sy<multisample;sy++)
+	  for (uint sx=0;sx<multisample;sx++)
+	    {
+	      samples.push_back(sampling_coordinate(x+(sx+0.5)/multisample,y+(sy+0.5)/multisample,f,width,height,frames));
+	      if (samples.size()==max_batch_samples)
+		{
+		  profile->evaluate_batch(&samples[0],&values[0],samples.size());
+		  samples.clear();
+		}
+	    }
+  if (!samples.empty())
+    profile->evaluate_batch(&samples[0],&values[0],samples.size());
+
+  return profile;
+}
+
+void MutatableImage::get_stats(uint& total_nodes,uint& total_parameters,uint& depth,uint& width,real& proportion_constant,real& cost) const
 {
   top().get_stats(total_nodes,total_parameters,depth,width,proportion_constant);
+  cost=estimated_cost();
 }
 
 std::ostream& MutatableImage::save_function(std::ostream& out) const
@@ -27,8 +27,10 @@
 #include "common.h"
 
 #include "xyz.h"
+#include "function_program.h"
 
 class FunctionNull;
+class FunctionProfile;
 class FunctionRegistry;
 class FunctionTop;
 class MutationParameters;
@@ -49,6 +51,19 @@ class MutatableImage
    */
   std::unique_ptr<FunctionTop> _top;
 
+  //! Optimised copy of the image tree, which is what actually gets evaluated.
+  /*! _top remains the definitive version (for mutation, saving etc); see FunctionNode::optimise.
+   */
+  std::unique_ptr<FunctionTop> _evaluation_top;
+
+  //! The optimised image function compiled for fast batch evaluation.
+  /*! As images are never modified once constructed, the program never needs invalidating.
+   */
+  std::unique_ptr<const FunctionProgram> _program;
+
+  //! Whether the optimised tree is always evaluated in double, even when single precision is asked for.  See FunctionNode::needs_double.
+  bool _needs_double;
+
   //! Whether to sweep z sinusoidally (vs linearly)
   bool _sinusoidal_z;
 
@@ -58,12 +73,27 @@ class MutatableImage
   //! Whether this image is locked \todo Should be a property of display, not image.
   bool _locked;
 
+  //! Estimated time to evaluate a single sample, in nanoseconds.  See FunctionNode::estimated_cost.
+  real _estimated_cost;
+
   //! Serial number for identity tracking (used by display to discover whether a recompute is needed)
   unsigned long long _serial;
 
   //! Object count to generate serial numbers
   static unsigned long long _count;
 
+  //! Number of programs compiled, for the common subexpression statistics logged by prepare_evaluation.
+  static unsigned long long _programs_compiled;
+
+  //! Number of compiled programs in which at least one common subexpression was shared.
+  static unsigned long long _programs_sharing;
+
+  //! Total number of common subexpressions shared over all compiled programs.
+  static unsigned long long _subexpressions_shared;
+
+  //! Set up the optimised copy of the tree and its program.
+  void prepare_evaluation();
+
  public:
   
   //! Take ownership of the image tree with the specified root node.
@@ -131,6 +161,42 @@ class MutatableImage
   //! Return the a 0-255-scaled RGB value at the specified pixel of an image/animation taking jitter (if random number generator provided) and multisampling into account
   const XYZ get_rgb(uint x,uint y,uint f,uint width,uint height,uint frames,Random01* r01,uint multisample) const;
 
+  //! Scratch space for the batch get_rgb: its sample blocks and the program's registers.
+  /*! Owned by the calling thread and passed to every call, so rendering a run allocates nothing once it has grown to suit.
+   */
+  struct Scratch
+  {
+    XYZBlock samples;
+    XYZBlock values;
+    //@{
+    //! Single precision copies of the samples and values.
+    XYZfBlock samples_float;
+    XYZfBlock values_float;
+    //@}
+    FunctionProgram::Registers registers;
+  };
+
+  //! As above, but for a run of out.size() pixels along a row starting at x, writing the colours to out.
+  /*! Gives the same results as calling the single pixel version for each pixel in turn
+    (including the order jitter is drawn from the random number generator),
+    but the function tree is evaluated a batch of samples at a time.
+
+    The run can also be of every stride-th pixel, and of a lower resolution image (subsample times fewer pixels each way,
+    with x and y in its pixel coordinates but width and height still those of the full resolution image).
+    Each pixel of a lower resolution image is sampled as if it were the full resolution pixel at its top left,
+    so its samples are exactly a subset of those of every higher resolution (see MutatableImageComputerTask::reusable_samples).
+
+    If single_precision is set, the compiled program is run in float (see FunctionProgram::execute),
+    so results will differ slightly, unless the tree needs double anyway (see FunctionNode::needs_double).
+   */
+  void get_rgb(uint x,uint y,uint f,uint width,uint height,uint frames,Random01* r01,uint multisample,bool single_precision,XYZBlock& out,Scratch& scratch,uint subsample=1,uint stride=1) const;
+
+  //! Profile the evaluation of every (unjittered) sample of an image/animation of the given size.
+  /*! The samples are evaluated through an instrumented copy of the optimised tree (see FunctionProfile),
+    so this is much slower than rendering but leaves the image itself untouched.
+   */
+  std::unique_ptr<FunctionProfile> profile(uint width,uint height,uint frames,uint multisample) const;
+
   //! Return whether image value is independent of position.
   bool is_constant() const;
 
@@ -138,7 +204,15 @@ class MutatableImage
   std::ostream& save_function(std::ostream& out) const;
 
   //! Obtain some statistics about the image function
-  void get_stats(uint& total_nodes,uint& total_parameters,uint& depth,uint& width,real& proportion_constant) const;
+  /*! All but the estimated cost are of the definitive tree; the estimated cost (nanoseconds per sample) is of the optimised tree actually evaluated.
+   */
+  void get_stats(uint& total_nodes,uint& total_parameters,uint& depth,uint& width,real& proportion_constant,real& estimated_cost) const;
+
+  //! Estimated time to evaluate a single sample, in nanoseconds.
+  real estimated_cost() const
+    {
+      return _estimated_cost;
+    }
 
   //! Check the function tree is ok.
   bool ok() const;
@@ -29,9 +29,10 @@
 
 #include "platform_specific.h"
 
-MutatableImageComputer::MutatableImageComputer(MutatableImageComputerFarm* frm,int niceness)
+MutatableImageComputer::MutatableImageComputer(MutatableImageComputerFarm* frm,int niceness,uint index)
   :_farm(frm)
   ,_niceness(niceness)
+  ,_index(index)
   ,_r01(23)  // Seed pretty unimportant; only used for sample jitter
 {
   start();
@@ -62,10 +63,10 @@ void MutatableImageComputer::run()
   // Run until something sets the kill flag 
   while(!communications().kill())
     {
-      // If we don't have a task try and get one.  This will block or return null.
+      // If we don't have a task try and get one.  This will block or return null; the farm sets _task (see computing()).
       if (task()==0)
 	{
-	  _task=farm()->pop_todo(*this);
+	  farm()->pop_todo(*this);
 	}
       
       if (task())
@@ -73,82 +74,158 @@ void MutatableImageComputer::run()
 	  // Careful, we could be given an already aborted task
 	  if (!task()->aborted())
 	    {
-	      while (!communications().kill_or_abort_or_defer() && !task()->completed())
+	      std::vector<uint> pixels;
+	      QElapsedTimer timer;
+
+	      // Work through the remainder of the current row in runs of a few hundred pixels, so the function tree is evaluated in batches
+	      // but the task's cancellation token (and the other flags) are still polled often enough to abandon an expensive row promptly.
+	      const uint max_run_length=256;
+	      while (!communications().kill_or_defer() && !task()->aborted() && !task()->completed())
 		{
-		  XYZ accumulated_colour=task()->image_function()->get_rgb
-		    (
-		     task()->fragment_origin().width()+task()->current_col(),
-		     task()->fragment_origin().height()+task()->current_row(),
-		     task()->current_frame(),
-		     task()->whole_image_size().width(),
-		     task()->whole_image_size().height(),
-		     task()->frames(),
-		     (task()->jittered_samples() ? &_r01 : 0),
-		     task()->multisample_grid()
-		     );
-
-		  const uint col0=lrint(accumulated_colour.x());
-		  const uint col1=lrint(accumulated_colour.y());
-		  const uint col2=lrint(accumulated_colour.z());
-
-		  task()->images()[task()->current_frame()].setPixel(task()->current_col(),task()->current_row(),((col0<<16)|(col1<<8)|(col2)));
-
-		  task()->pixel_advance();
+		  const uint run_length=std::min(max_run_length,task()->fragment_size().width()-task()->current_col());
+		  const uint x=task()->fragment_origin().width()+task()->current_col();
+		  const uint y=task()->fragment_origin().height()+task()->current_row();
+
+		  timer.start();
+
+		  compute_run(x,y,run_length,pixels);
+
+		  for (uint i=0;i<run_length;i++)
+		    {
+		      task()->images()[task()->current_frame()].setPixel(task()->current_col(),task()->current_row(),pixels[i]);
+
+		      task()->pixel_advance();
+		    }
+		  task()->add_compute_time(timer.nsecsElapsed());
+
+		  // If something much more urgent (e.g a preview of a newly spawned image) has turned up, put this task back
+		  // (its progress is kept in the task, so it will resume where it left off) and go and compute that instead.
+		  if (!task()->completed() && farm()->more_urgent_than(task()->priority()))
+		    {
+		      communications().defer(true);
+		    }
 		}
 	    }
 	  
-	  // Maybe should capture copies of the flags for use here
 	  if (!communications().kill())
 	    {
-	      if (communications().defer() && !communications().abort())
+	      if (communications().defer() && !task()->aborted())
 		{
 		  farm()->push_todo(task());
-		  communications().defer(false);
-		  _task.reset();
 		}
 	      else
 		{
-		  if (communications().abort())
-		    {
-		      task()->abort();
-		    }
-	      
-		  communications().defer(false);
-		  communications().abort(false);
-
+		  task()->release_previous_pass();
 		  farm()->push_done(task());	  
-		  _task.reset();
 		}
+	      communications().defer(false);
+
+	      // Only let go of the task once it's back in a queue, where the farm's aborts will find it.
+	      computing(boost::shared_ptr<MutatableImageComputerTask>());
 	    }
 	}
     }
   std::clog << "Thread shutting down\n";
 }
 
-bool MutatableImageComputer::defer_if_less_important_than(uint pri)
+void MutatableImageComputer::compute_run(uint x,uint y,uint n,std::vector<uint>& pixels)
 {
-  const boost::shared_ptr<const MutatableImageComputerTask> task_tmp=_task;
-  if (task_tmp && task_tmp->priority()>pri)
+  pixels.resize(n);
+
+  const uint frame=task()->current_frame();
+  if (task()->reusable_samples(frame,x,y,n,_reused))
     {
-      communications().defer(true);
-      return true;
+      // The even x pixels of even rows can usually be copied from the previous (half resolution) pass,
+      // in which case only every other pixel needs computing.
+      for (uint i=(x&1);i<n;i+=2)
+	pixels[i]=_reused[(x+i)/2-(x+1)/2];
+
+      const uint first=1-(x&1);
+      if (first<n)
+	evaluate(x+first,y,(n-first+1)/2,2,task()->multisample_grid(),&pixels[first]);
+    }
+  else if (task()->choose_multisampled(frame))
+    {
+      // Only multisample the pixels chosen as needing it, in runs;
+      // the rest keep the colour they had in the previous (single sampled) pass.
+      const uint col=task()->current_col();
+      const uint row=task()->current_row();
+      for (uint i=0;i<n;)
+	{
+	  if (task()->multisampled(col+i,row))
+	    {
+	      uint j=i+1;
+	      while (j<n && task()->multisampled(col+j,row)) j++;
+	      evaluate(x+i,y,j-i,1,task()->multisample_grid(),&pixels[i]);
+	      i=j;
+	    }
+	  else
+	    {
+	      pixels[i]=task()->single_sample(col+i,row);
+	      i++;
+	    }
+	}
     }
   else
     {
-      return false;
+      evaluate(x,y,n,1,task()->multisample_grid(),&pixels[0]);
+    }
+}
+
+void MutatableImageComputer::evaluate(uint x,uint y,uint n,uint stride,uint multisample,uint* pixels)
+{
+  _samples.resize(n);
+
+  task()->image_function()->get_rgb
+    (
+     x,
+     y,
+     task()->current_frame(),
+     task()->full_image_size().width(),
+     task()->full_image_size().height(),
+     task()->frames(),
+     (task()->jittered_samples() ? &_r01 : 0),
+     multisample,
+     task()->single_precision(),
+     _samples,
+     _scratch,
+     task()->subsample(),
+     stride
+     );
+
+  for (uint i=0;i<n;i++)
+    {
+      const uint col0=lrint(_samples.x()[i]);
+      const uint col1=lrint(_samples.y()[i]);
+      const uint col2=lrint(_samples.z()[i]);
+      pixels[i*stride]=((col0<<16)|(col1<<8)|(col2));
     }
 }
 
+void MutatableImageComputer::computing(const boost::shared_ptr<MutatableImageComputerTask>& t)
+{
+  QMutexLocker lock(&_task_mutex);
+  _task=t;
+}
+
+/*! Aborts act on the task itself rather than on the thread,
+  so they can't hit a task the thread picks up later, and survive the task being deferred back to the todo queue.
+ */
 void MutatableImageComputer::abort()
 {
-  communications().abort(true);
+  QMutexLocker lock(&_task_mutex);
+  if (_task)
+    {
+      _task->abort();
+    }
 }
 
 void MutatableImageComputer::abort_for(const MutatableImageDisplay* disp)
 {
-  if (task()!=0 && task()->display()==disp)
+  QMutexLocker lock(&_task_mutex);
+  if (_task && _task->display()==disp)
     {
-      communications().abort(true);
+      _task->abort();
     }
 }
 
@@ -161,3 +238,9 @@ bool MutatableImageComputer::killed() const
 {
   return communications().kill();
 }
+
+bool MutatableImageComputer::active() const
+{
+  QMutexLocker lock(&_task_mutex);
+  return (_task!=0);
+}
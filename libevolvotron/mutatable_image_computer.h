@@ -46,92 +46,73 @@ class MutatableImageComputer : public QThread
   //! Priority offset applied to compute threads.
   const int _niceness;
 
+  //! Which of the farm's threads (and so todo queues) this is.
+  const uint _index;
+
   //! The current task.  Can't be a const MutatableImageComputerTask because the task holds the calculated result.
+  /*! Only this thread changes it, and only with _task_mutex locked, so this thread can read it without locking.
+   */
   boost::shared_ptr<MutatableImageComputerTask> _task;
 
+  //! Mutex protecting _task while other threads (via abort(), abort_for() and active()) look at it.
+  /*! Only taken when a task changes hands, never while computing: the compute loop polls the task's own lock-free cancellation token.
+   */
+  mutable QMutex _task_mutex;
+
   //! Randomness for sampling jitter
   Random01 _r01;
 
-  //! Class encapsulating mutex-protected flags used for communicating between farm and worker.
-  /*! The Mutex is of dubious value (could certainly be eliminated for reads).
+  //@{
+  //! Scratch space for compute_run, kept to avoid reallocating it for every run.
+  XYZBlock _samples;
+  MutatableImage::Scratch _scratch;
+  std::vector<uint> _reused;
+  //@}
+
+  //! Class encapsulating lock-free flags used for communicating between farm and worker.
+  /*! Aborts aren't signalled here but through the task's own cancellation token (MutatableImageComputerTask::abort()),
+    so an abort can never hit a different task than the one it was meant for.
    */
   class Communications
     {
     protected:
-      //! Mutex protecting access to members (mutable to enable const-ness of accessors).
-      mutable QMutex _mutex;
-      
       //! Flag to indicate we should put our current task back on the todo queue and take another one.
-      /*! volatile because used for inter-thread communication.
-       */
-      volatile bool _defer;
-      
-      //! Flag to indicate we should abort the current compute.
-      /*! volatile because used for inter-thread communication.
-       */
-      volatile bool _abort;
+      QAtomicInt _defer;
       
       //! Flag to indicate the thread should shut down and exit.
-      /*! volatile because used for inter-thread communication.
-       */
-      volatile bool _kill;
+      QAtomicInt _kill;
 
     public:
       //! Constructor.
-      /*! Mutex is recursive to allow nesting.
-       */
       Communications()
-	:_mutex()
-	,_defer(false)
-	,_abort(false)
-	,_kill(false)
+	:_defer(0)
+	,_kill(0)
 	{}
 
-      //! Mutex-protected accessor.
+      //! Accessor.
       void defer(bool v)
 	{
-	  QMutexLocker lock(&_mutex);
-	  _defer=v;
+	  _defer.storeRelease(v);
 	}
-      //! Mutex-protected accessor.
+      //! Accessor.
       bool defer() const
 	{
-	  QMutexLocker lock(&_mutex);
-	  const bool ret=_defer;
-	  return ret;
-	}
-      //! Mutex-protected accessor.
-      void abort(bool v)
-	{
-	  QMutexLocker lock(&_mutex);
-	  _abort=v;
-	}
-      //! Mutex-protected accessor.
-      bool abort() const
-	{
-	  QMutexLocker lock(&_mutex);
-	  const bool ret=_abort;
-	  return ret;
+	  return _defer.loadAcquire();
 	}
-      //! Mutex-protected accessor.
+      //! Accessor.
       void kill(bool v)
 	{
-	  QMutexLocker lock(&_mutex);
-	  _kill=v;
+	  _kill.storeRelease(v);
 	}
-      //! Mutex-protected accessor.
+      //! Accessor.
       bool kill() const
 	{
-	  QMutexLocker lock(&_mutex);
-	  const bool ret=_kill;
-	  return ret;
+	  return _kill.loadAcquire();
 	}
-      //! Check union of all flags with only one mutex lock.
-      bool kill_or_abort_or_defer() const
+      //! Check union of both flags.
+      bool kill_or_defer() const
 	{
-	  QMutexLocker lock(&_mutex);
-	  const bool ret=(_kill || _abort || _defer);
-	  return ret;
+	  return (_kill.loadAcquire() || _defer.loadAcquire());
 	}
     };
 
@@ -141,6 +122,18 @@ class MutatableImageComputer : public QThread
   //! The actual compute code, launched by invoking start() in the constructor.
   virtual void run();
 
+  //! Compute the colours of a run of n pixels of the current task's current frame, along row y from x (in whole image coordinates).
+  /*! Only the pixels which can't be taken from the task's previous pass
+    (see MutatableImageComputerTask::reusable_samples and MutatableImageComputerTask::choose_multisampled)
+    are actually evaluated.
+   */
+  void compute_run(uint x,uint y,uint n,std::vector<uint>& pixels);
+
+  //! Evaluate the colours of n pixels of the current task's current frame, every stride-th pixel along row y from x, at the given multisampling.
+  /*! The colours are written to every stride-th element of pixels.
+   */
+  void evaluate(uint x,uint y,uint n,uint stride,uint multisample,uint* pixels);
+
   //! Accessor.
   Communications& communications()
     {
@@ -167,13 +160,16 @@ class MutatableImageComputer : public QThread
  public:
 
   //! Constructor
-  MutatableImageComputer(MutatableImageComputerFarm* frm,int niceness);
+  MutatableImageComputer(MutatableImageComputerFarm* frm,int niceness,uint index);
 
   //! Destructor
   ~MutatableImageComputer();
 
-  //! Defer the current task if it's priority is less important than specified.  Returns true if deferrment occurred.
-  bool defer_if_less_important_than(uint pri);
+  //! This method called by the farm to hand the thread a task, with the queue the task came from still locked.
+  /*! So a task in transit can't be missed by MutatableImageComputerFarm::abort_all or abort_for,
+    which lock each queue in turn before asking the computers to abort.
+   */
+  void computing(const boost::shared_ptr<MutatableImageComputerTask>& t);
 
   //! This method called by an external threads to shut down the current task
   void abort();
@@ -189,11 +185,14 @@ class MutatableImageComputer : public QThread
    */
   bool killed() const;
 
-  //! Indicate whether computation us taking place (only intended for counting outstanding threads).
-  bool active() const
+  //! Accessor.
+  uint index() const
     {
-      return (_task!=0);
+      return _index;
     }
+
+  //! Indicate whether computation us taking place (only intended for counting outstanding threads).
+  bool active() const;
 };
 
 #endif
@@ -25,16 +25,23 @@
 
 #include "mutatable_image_computer.h"
 
-/*! Creates the specified number of threads and store pointers to them.
+/*! Creates the specified number of threads (and their queues) and store pointers to them.
  */
 MutatableImageComputerFarm::MutatableImageComputerFarm(uint n_threads, int niceness)
+  : _done_stack(0)
 {
   _done_position = _done.end();
 
+  // The queues must all exist before any thread starts looking in them.
+  for (uint i = 0; i < n_threads; i++)
+  {
+    _queues.push_back(new ComputerQueue);
+  }
+
   for (uint i = 0; i < n_threads; i++)
   {
     // The computer's constructor includes a start()
-    _computers.push_back(new MutatableImageComputer(this, niceness));
+    _computers.push_back(new MutatableImageComputer(this, niceness, i));
   }
 }
 
@@ -48,15 +55,16 @@ MutatableImageComputerFarm::~MutatableImageComputerFarm()
   // Kill all the computers (care needed to wake any waiting ones).
   for (boost::ptr_vector<MutatableImageComputer>::iterator it = _computers.begin(); it != _computers.end(); it++)
     (*it).kill();
-  _wait_condition.wakeAll();
+  {
+    QMutexLocker lock(&_wait_mutex);
+    _wait_condition.wakeAll();
+  }
   _computers.clear();
 
   // Clear all the tasks in queues
-  {
-    QMutexLocker lock(&_mutex);
-    _todo.clear();
-    _done.clear();
-  }
+  _queues.clear();
+  collect_done();
+  _done.clear();
 
   std::clog << "...completed compute farm shut down\n";
 }
@@ -69,83 +77,174 @@ static bool predicate_aborted(const boost::shared_ptr<const MutatableImageComput
 }
 #endif
 
-void MutatableImageComputerFarm::fasttrack_aborted()
+void MutatableImageComputerFarm::update(ComputerQueue &queue)
 {
-  QMutexLocker lock(&_mutex);
+  if (!queue.todo.empty())
+    queue.head_priority.storeRelease(queue.todo.begin()->first);
+  queue.size.storeRelease(queue.todo.size());
+}
 
-  TodoQueue::iterator it = _todo.begin();
-  while (it != _todo.end())
+void MutatableImageComputerFarm::push(ComputerQueue &queue, const boost::shared_ptr<MutatableImageComputerTask> &task)
+{
+  QMutexLocker lock(&queue.mutex);
+  queue.todo.insert(std::make_pair(task->priority(), task));
+  update(queue);
+}
+
+/*! The task is handed to the requester before the queue is unlocked,
+  so abort_all and abort_for (which lock each queue before asking the computers to abort) can't miss a task in transit.
+ */
+const boost::shared_ptr<MutatableImageComputerTask> MutatableImageComputerFarm::pop(ComputerQueue &queue, MutatableImageComputer &requester)
+{
+  QMutexLocker lock(&queue.mutex);
+
+  boost::shared_ptr<MutatableImageComputerTask> ret;
+  TodoQueue::iterator it = queue.todo.begin();
+  if (it != queue.todo.end())
   {
-    if ((*it)->aborted())
-    {
-      _done[(*it)->display()].insert(*it);
-      it = _todo.erase(it);
-    }
-    else
-      it++;
+    ret = it->second;
+    queue.todo.erase(it);
+    update(queue);
+    _todo_count.fetchAndAddOrdered(-1);
+    requester.computing(ret);
   }
+  return ret;
 }
 
-void MutatableImageComputerFarm::push_todo(const boost::shared_ptr<MutatableImageComputerTask> &task)
+void MutatableImageComputerFarm::collect_done()
+{
+  DoneNode *node = _done_stack.fetchAndStoreAcquire(0);
+  int collected = 0;
+  while (node)
+  {
+    _done[node->task->display()].insert(std::make_pair(node->task->priority(), node->task));
+    collected++;
+
+    DoneNode *next = node->next;
+    delete node;
+    node = next;
+  }
+  if (collected)
+    _done_stack_size.fetchAndAddOrdered(-collected);
+}
+
+void MutatableImageComputerFarm::fasttrack_aborted()
 {
+  for (boost::ptr_vector<ComputerQueue>::iterator q = _queues.begin(); q != _queues.end(); q++)
   {
-    QMutexLocker lock(&_mutex);
-
-    // We could be in a situation where there are tasks with lower priority which should be defered in favour of this one.
-    // Currently we simply defer everything with a lower priority and let the queue sort them out.
-    //! \todo: It would be better to just defer the lowest priority task if there's any less than the queued task.
-    /*
-    bool any_deferred=false;
-    for (boost::ptr_vector<MutatableImageComputer>::iterator it=_computers.begin();it!=_computers.end();it++)
+    QMutexLocker lock(&(*q).mutex);
+
+    TodoQueue::iterator it = (*q).todo.begin();
+    while (it != (*q).todo.end())
+    {
+      if (it->second->aborted())
       {
-	if ((*it).defer_if_less_important_than(task->priority()))
-	  {
-	    any_deferred=true;
-	  }
+        _done[it->second->display()].insert(*it);
+        it = (*q).todo.erase(it);
+        _todo_count.fetchAndAddOrdered(-1);
       }
-    */
-
-    _todo.insert(task);
+      else
+        it++;
+    }
+    update(*q);
   }
+}
+
+void MutatableImageComputerFarm::push_todo(const boost::shared_ptr<MutatableImageComputerTask> &task)
+{
+  // Deal tasks out to the queues in turn, so each thread has a share of every resolution level.
+  const uint q = static_cast<uint>(_next_queue.fetchAndAddRelaxed(1)) % _queues.size();
+  push(_queues[q], task);
+  _todo_count.fetchAndAddOrdered(1);
 
   // If there any threads waiting, we should wake one up.
-  _wait_condition.wakeOne();
+  // (The read-modify-write orders this after the count update, matching pop_todo's updates in the opposite order.)
+  if (_waiting.fetchAndAddOrdered(0) > 0)
+  {
+    QMutexLocker lock(&_wait_mutex);
+    _wait_condition.wakeOne();
+  }
 }
 
 const boost::shared_ptr<MutatableImageComputerTask> MutatableImageComputerFarm::pop_todo(MutatableImageComputer &requester)
 {
-  _mutex.lock();
+  const uint n = _queues.size();
   boost::shared_ptr<MutatableImageComputerTask> ret;
-  while (!ret)
+  while (!ret && !requester.killed())
   {
-    TodoQueue::iterator it = _todo.begin();
-    if (it != _todo.end())
+    // Find the queue with the most urgent head.
+    // Our own queue wins unless another's head is more than twice as urgent:
+    // successive resolution levels differ in priority by a factor of four, so that's enough to keep them in order,
+    // without every thread converging on the same queue whenever priorities differ only slightly.
+    ComputerQueue *best = 0;
+    uint best_priority = 0;
+    for (uint i = 1; i < n; i++)
+    {
+      ComputerQueue &queue = _queues[(requester.index() + i) % n];
+      if (queue.size.loadAcquire() > 0)
+      {
+        const uint priority = queue.head_priority.loadAcquire();
+        if (!best || priority < best_priority)
+        {
+          best = &queue;
+          best_priority = priority;
+        }
+      }
+    }
+    ComputerQueue &own = _queues[requester.index()];
+    if (own.size.loadAcquire() > 0 && (!best || own.head_priority.loadAcquire() / 2 <= best_priority))
+    {
+      best = &own;
+    }
+
+    if (best)
     {
-      ret = (*it);
-      _todo.erase(it);
+      // Could come back empty if another thread got there first, in which case just look again.
+      ret = pop(*best, requester);
     }
     else
     {
-      std::clog << "Thread waiting\n";
-      _wait_condition.wait(&_mutex);
-      std::clog << "Thread woken\n";
-      if (requester.killed())
-        break;
+      QMutexLocker lock(&_wait_mutex);
+      _waiting.fetchAndAddOrdered(1);
+      while (_todo_count.fetchAndAddOrdered(0) == 0 && !requester.killed())
+      {
+        std::clog << "Thread waiting\n";
+        _wait_condition.wait(&_wait_mutex);
+        std::clog << "Thread woken\n";
+      }
+      _waiting.fetchAndAddOrdered(-1);
     }
   }
-  _mutex.unlock();
   return ret;
 }
 
+bool MutatableImageComputerFarm::more_urgent_than(uint priority) const
+{
+  for (boost::ptr_vector<ComputerQueue>::const_iterator q = _queues.begin(); q != _queues.end(); q++)
+  {
+    if ((*q).size.loadAcquire() > 0 && (*q).head_priority.loadAcquire() < priority / 2)
+      return true;
+  }
+  return false;
+}
+
+/*! Lock-free, so compute threads never wait for the GUI thread (or each other) to hand a task over.
+ */
 void MutatableImageComputerFarm::push_done(const boost::shared_ptr<MutatableImageComputerTask> &task)
 {
-  QMutexLocker lock(&_mutex);
-  _done[task->display()].insert(task);
+  DoneNode *node = new DoneNode;
+  node->task = task;
+  _done_stack_size.fetchAndAddOrdered(1);
+  do
+  {
+    node->next = _done_stack.loadAcquire();
+  }
+  while (!_done_stack.testAndSetOrdered(node->next, node));
 }
 
 const boost::shared_ptr<MutatableImageComputerTask> MutatableImageComputerFarm::pop_done()
 {
-  QMutexLocker lock(&_mutex);
+  collect_done();
 
   boost::shared_ptr<MutatableImageComputerTask> ret;
   if (_done_position == _done.end())
@@ -159,7 +258,7 @@ const boost::shared_ptr<MutatableImageComputerTask> MutatableImageComputerFarm::
     DoneQueue::iterator it = q.begin();
     if (it != q.end())
     {
-      ret = (*it);
+      ret = it->second;
       q.erase(it);
     }
 
@@ -181,44 +280,56 @@ const boost::shared_ptr<MutatableImageComputerTask> MutatableImageComputerFarm::
 
 void MutatableImageComputerFarm::abort_all()
 {
-  QMutexLocker lock(&_mutex);
-
-  for (TodoQueue::iterator it = _todo.begin(); it != _todo.end(); it++)
+  for (boost::ptr_vector<ComputerQueue>::iterator q = _queues.begin(); q != _queues.end(); q++)
   {
-    (*it)->abort();
+    QMutexLocker lock(&(*q).mutex);
+
+    for (TodoQueue::iterator it = (*q).todo.begin(); it != (*q).todo.end(); it++)
+    {
+      it->second->abort();
+    }
+    _todo_count.fetchAndAddOrdered(-static_cast<int>((*q).todo.size()));
+    (*q).todo.clear();
+    update(*q);
   }
-  _todo.clear();
 
   for (boost::ptr_vector<MutatableImageComputer>::iterator it = _computers.begin(); it != _computers.end(); it++)
   {
     (*it).abort();
   }
 
+  collect_done();
   for (DoneQueueByDisplay::iterator it0 = _done.begin(); it0 != _done.end(); it0++)
   {
     DoneQueue &q = (*it0).second;
     for (DoneQueue::iterator it1 = q.begin(); it1 != q.end(); it1++)
     {
-      (*it1)->abort();
+      it1->second->abort();
     }
   }
   _done.clear();
+  _done_position = _done.end();
 }
 
 void MutatableImageComputerFarm::abort_for(const MutatableImageDisplay *disp)
 {
-  QMutexLocker lock(&_mutex);
-
-  for (TodoQueue::iterator it = _todo.begin(); it != _todo.end(); it++)
+  for (boost::ptr_vector<ComputerQueue>::iterator q = _queues.begin(); q != _queues.end(); q++)
   {
-    if ((*it)->display() == disp)
-    {
-      (*it)->abort();
+    QMutexLocker lock(&(*q).mutex);
 
-      it = _todo.erase(it);
-      if (it == _todo.end())
-        break;
+    TodoQueue::iterator it = (*q).todo.begin();
+    while (it != (*q).todo.end())
+    {
+      if (it->second->display() == disp)
+      {
+        it->second->abort();
+        it = (*q).todo.erase(it);
+        _todo_count.fetchAndAddOrdered(-1);
+      }
+      else
+        it++;
     }
+    update(*q);
   }
 
   for (boost::ptr_vector<MutatableImageComputer>::iterator it = _computers.begin(); it != _computers.end(); it++)
@@ -226,23 +337,19 @@ void MutatableImageComputerFarm::abort_for(const MutatableImageDisplay *disp)
     (*it).abort_for(disp);
   }
 
+  collect_done();
   DoneQueueByDisplay::iterator it0 = _done.find(disp);
   if (it0 != _done.end())
   {
     DoneQueue &q = (*it0).second;
-
-    //! \todo It would be pretty odd if display didn't match the queue bin: change to assert
     for (DoneQueue::iterator it1 = q.begin(); it1 != q.end(); it1++)
     {
-      if ((*it1)->display() == disp)
-      {
-        (*it1)->abort();
-
-        it1 = q.erase(it1);
-        if (it1 == q.end())
-          break;
-      }
+      it1->second->abort();
     }
+
+    if (_done_position == it0)
+      _done_position++;
+    _done.erase(it0);
   }
 }
 
@@ -258,9 +365,8 @@ uint MutatableImageComputerFarm::tasks() const
     }
   }
 
-  QMutexLocker lock(&_mutex);
-
-  ret += _todo.size();
+  ret += _todo_count.loadAcquire();
+  ret += _done_stack_size.loadAcquire();
 
   for (DoneQueueByDisplay::const_iterator it = _done.begin(); it != _done.end(); it++)
     ret += (*it).second.size();
@@ -34,58 +34,86 @@ class MutatableImageComputer;
 class MutatableImageDisplay;
 
 //! Class encapsulating some compute threads and queues of tasks to be done and tasks completed.
-/*! Priority queues are implemented using multiset becase we want to be able to iterate over all members.
+/*! Priority queues are implemented using multimaps keyed on the task priority because we want to be able to iterate over all members,
+  and keying them on the priority means neither ordering the queues nor reading their heads has to look at the tasks themselves.
+
+  Each compute thread has its own todo queue, so threads taking work don't all serialise on one mutex.
+  New tasks are dealt out to the queues in turn.
+  A thread takes the task at the head of its own queue unless another queue's head is much more urgent,
+  so work is stolen from other threads' queues when they have more urgent tasks (or the thread has none),
+  and tasks still run lowest resolution first across the whole farm (up to races between threads).
+
+  Completed tasks are handed over to the GUI thread through a lock-free stack,
+  which pop_done empties into the display-sorted done queues only the GUI thread touches.
+  So, with the exception of push_todo, pop_todo and push_done (used by the compute threads),
+  methods must only be called from the GUI thread.
  */
 class MutatableImageComputerFarm
 {
  protected:
   
-  //! Comparison class for STL template.
-  class CompareTaskPriorityLoResFirst
-    {
-    public:
-      //! Compare task priorities.
-      bool operator()(const boost::shared_ptr<const MutatableImageComputerTask>& t0,const boost::shared_ptr<const MutatableImageComputerTask>& t1) const
-	{ 
-	  return (t0->priority() < t1->priority());
-	}
-    };
-
-  //! Comparison class for STL template.
-  class CompareTaskPriorityHiResFirst
-    {
-    public:
-      //! Compare task priorities.
-      bool operator()(const boost::shared_ptr<const MutatableImageComputerTask>& t0,const boost::shared_ptr<const MutatableImageComputerTask>& t1) const
-	{ 
-	  return (t0->priority() > t1->priority());
-	}
-    };
+  //! The compute threads
+  boost::ptr_vector<MutatableImageComputer> _computers;
+
+  //! Convenience typedef.
+  typedef std::multimap<uint,boost::shared_ptr<MutatableImageComputerTask> > TodoQueue;
+
+  //! A compute thread's queue of tasks to be performed, lowest resolution first.
+  struct ComputerQueue
+  {
+    //! Mutex protecting the queue.  Only contended when another thread steals from it.
+    QMutex mutex;
+
+    //! The tasks.
+    TodoQueue todo;
+
+    //! Number of tasks in the queue, so threads looking for work can check without locking.
+    QAtomicInt size;
+
+    //! Priority of the task at the head of the queue (if there is one), so threads looking for work can check without locking.
+    QAtomicInteger<uint> head_priority;
+  };
+
+  //! The todo queues, one per compute thread.
+  boost::ptr_vector<ComputerQueue> _queues;
+
+  //! Total number of tasks in the todo queues.
+  QAtomicInt _todo_count;
 
-  //! Mutex for locking.  This is the ONLY thing the compute threads should ever block on.
-  mutable QMutex _mutex;
+  //! Counter dealing out pushed tasks to the queues.
+  QAtomicInt _next_queue;
+
+  //! Mutex for compute threads waiting for a task.  This is the ONLY thing the compute threads should ever block on.
+  QMutex _wait_mutex;
 
   //! Wait condition for threads waiting for a new task.
   QWaitCondition _wait_condition;
 
-  //! The compute threads
-  boost::ptr_vector<MutatableImageComputer> _computers;
+  //! Number of compute threads waiting (or about to wait) for a task.
+  QAtomicInt _waiting;
 
-  //! Convenience typedef.
-  typedef std::multiset<boost::shared_ptr<MutatableImageComputerTask>,CompareTaskPriorityLoResFirst> TodoQueue;
+  //! Node of the stack of completed tasks.
+  struct DoneNode
+  {
+    boost::shared_ptr<MutatableImageComputerTask> task;
+    DoneNode* next;
+  };
+
+  //! Lock-free stack of completed tasks pushed by the compute threads, not yet collected by the GUI thread.
+  QAtomicPointer<DoneNode> _done_stack;
 
-  //! Queue of tasks to be performed, lowest resolution first
-  TodoQueue _todo;
+  //! Number of tasks on the done stack.
+  QAtomicInt _done_stack_size;
 
   //! Conveniencetypedef.
-  typedef std::multiset<boost::shared_ptr<MutatableImageComputerTask>,CompareTaskPriorityHiResFirst> DoneQueue;
+  typedef std::multimap<uint,boost::shared_ptr<MutatableImageComputerTask>,std::greater<uint> > DoneQueue;
 
   //! Convenience typedef.  
   /*! const because never needs to do anything other than compare pointers
    */
   typedef std::map<const MutatableImageDisplay*,DoneQueue> DoneQueueByDisplay;
 
-  //! Queue of tasks completed awaiting display.
+  //! Queue of tasks completed awaiting display.  Only accessed by the GUI thread.
   /*! We reverse the compute priority so that highest resolution images get displayed first.
       Lower resolution ones arriving later should be discarded by the displays.
       This mainly makes a difference for animation where enlarging multiple low resolution 
@@ -98,6 +126,18 @@ class MutatableImageComputerFarm
   //! Points to the next display queue to be returned (could be .end())
   DoneQueueByDisplay::iterator _done_position;
 
+  //! Add a task to a todo queue.
+  void push(ComputerQueue& queue,const boost::shared_ptr<MutatableImageComputerTask>& task);
+
+  //! Remove the task at the head of a todo queue and hand it to the requester (returns null if none).
+  const boost::shared_ptr<MutatableImageComputerTask> pop(ComputerQueue& queue,MutatableImageComputer& requester);
+
+  //! Update a todo queue's lock-free size and head priority after changing it (with its mutex locked).
+  void update(ComputerQueue& queue);
+
+  //! Move everything on the done stack into the done queues.
+  void collect_done();
+
  public:
 
   //! Constructor.
@@ -118,9 +158,14 @@ class MutatableImageComputerFarm
   //! Enqueue a task for computing.
   void push_todo(const boost::shared_ptr<MutatableImageComputerTask>&);
 
-  //! Remove a task from the head of the todo queue (returns null if none).
+  //! Remove the most urgent task from the todo queues and hand it to the requester, waiting for one if there are none (returns null if the requester is killed while waiting).
   const boost::shared_ptr<MutatableImageComputerTask> pop_todo(MutatableImageComputer& requester);
 
+  //! Return whether any task in the todo queues is much more urgent than the given priority (by the same rule as pop_todo).
+  /*! Compute threads call this after each run of pixels, and defer their task if so.  Doesn't lock anything.
+   */
+  bool more_urgent_than(uint priority) const;
+
   //! Enqueue a task for display.
   void push_done(const boost::shared_ptr<MutatableImageComputerTask>&);
 
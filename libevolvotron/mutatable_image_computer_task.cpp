@@ -25,6 +25,8 @@
 
 #include "mutatable_image_computer_task.h"
 
+#include "adaptive_multisampling.h"
+
 MutatableImageComputerTask::MutatableImageComputerTask
 (
  MutatableImageDisplay*const disp,
@@ -33,32 +35,43 @@ MutatableImageComputerTask::MutatableImageComputerTask
  const QSize& fo,
  const QSize& fs,
  const QSize& wis,
+ const QSize& fis,
  uint f,
  uint lev,
  uint frag,
  uint nfrag,
  bool j,
  uint ms,
- unsigned long long int n
+ bool sp,
+ real mb,
+ unsigned long long int n,
+ const boost::shared_ptr<const Fragments>& prev
  )
-  :_aborted(false)
+  :_aborted(0)
   ,_display(disp)
   ,_image_function(fn)
   ,_priority(pri)
   ,_fragment_origin(fo)
   ,_fragment_size(fs)
   ,_whole_image_size(wis)
+  ,_full_image_size(fis)
   ,_frames(f)
   ,_level(lev)
   ,_fragment(frag)
   ,_number_of_fragments(nfrag)
   ,_jittered_samples(j)
   ,_multisample_grid(ms)
+  ,_single_precision(sp)
+  ,_multisample_budget(mb)
   ,_current_pixel(0)
   ,_current_col(0)
   ,_current_row(0)
   ,_current_frame(0)
-  ,_completed(false)
+  ,_completed(0)
+  ,_previous_pass(prev)
+  ,_adaptive(ms>1 && mb>0.0 && prev)
+  ,_chosen_frame(-1)
+  ,_compute_time(0.0)
   ,_serial(n)
 {
   /*
@@ -104,8 +117,101 @@ void MutatableImageComputerTask::pixel_advance()
 	  _current_frame++;
 	  if (_current_frame==frames())
 	    {
-	      _completed=true;
+	      _completed.storeRelease(1);
 	    }
 	}
     }
 }
+
+bool MutatableImageComputerTask::reusable_samples(uint f,uint x,uint y,uint n,std::vector<uint>& colours) const
+{
+  if (!_previous_pass || (y&1))
+    return false;
+
+  // Pixels of the previous pass coinciding with the even x pixels of the run
+  const uint py=y/2;
+  const uint px0=(x+1)/2;
+  const uint px1=(x+n+1)/2;
+  colours.resize(px1-px0);
+
+  uint found=0;
+  for (Fragments::const_iterator it=_previous_pass->begin();it!=_previous_pass->end();it++)
+    {
+      const MutatableImageComputerTask& fragment=*(*it);
+      const uint fx0=fragment.fragment_origin().width();
+      const uint fy0=fragment.fragment_origin().height();
+      if (
+	  fy0<=py && py<fy0+fragment.fragment_size().height()
+	  && fx0<px1 && px0<fx0+fragment.fragment_size().width()
+	  )
+	{
+	  // Anything not finished (or aborted) is no use
+	  if (!fragment.completed())
+	    return false;
+
+	  const QImage& image=fragment.images()[f];
+	  const uint begin=std::max(px0,fx0);
+	  const uint end=std::min(px1,fx0+fragment.fragment_size().width());
+	  for (uint px=begin;px<end;px++)
+	    colours[px-px0]=image.pixel(px-fx0,py-fy0);
+	  found+=end-begin;
+	}
+    }
+  return (found==colours.size());
+}
+
+bool MutatableImageComputerTask::choose_multisampled(uint f)
+{
+  if (!_adaptive)
+    return false;
+
+  if (_chosen_frame==static_cast<int>(f))
+    return !_multisampled.empty();
+
+  _chosen_frame=f;
+  _multisampled.clear();
+
+  // The fragment and a border of a pixel around it (where there's image), in whole image coordinates
+  const uint fx0=fragment_origin().width();
+  const uint fy0=fragment_origin().height();
+  const uint x0=(fx0>0 ? fx0-1 : 0);
+  const uint y0=(fy0>0 ? fy0-1 : 0);
+  const uint x1=std::min(fx0+fragment_size().width()+1,static_cast<uint>(whole_image_size().width()));
+  const uint y1=std::min(fy0+fragment_size().height()+1,static_cast<uint>(whole_image_size().height()));
+  const uint w=x1-x0;
+  const uint h=y1-y0;
+
+  std::vector<uint> colours(w*h);
+  uint found=0;
+  for (Fragments::const_iterator it=_previous_pass->begin();it!=_previous_pass->end();it++)
+    {
+      const MutatableImageComputerTask& fragment=*(*it);
+      const uint px0=std::max(x0,static_cast<uint>(fragment.fragment_origin().width()));
+      const uint py0=std::max(y0,static_cast<uint>(fragment.fragment_origin().height()));
+      const uint px1=std::min(x1,static_cast<uint>(fragment.fragment_origin().width()+fragment.fragment_size().width()));
+      const uint py1=std::min(y1,static_cast<uint>(fragment.fragment_origin().height()+fragment.fragment_size().height()));
+      if (px0<px1 && py0<py1)
+	{
+	  // Anything not finished (or aborted) is no use
+	  if (!fragment.completed())
+	    return false;
+
+	  const QImage& image=fragment.images()[f];
+	  for (uint y=py0;y<py1;y++)
+	    for (uint x=px0;x<px1;x++)
+	      colours[(y-y0)*w+(x-x0)]=(image.pixel(x-fragment.fragment_origin().width(),y-fragment.fragment_origin().height())&0x00ffffff);
+	  found+=(px1-px0)*(py1-py0);
+	}
+    }
+  if (found!=w*h)
+    return false;
+
+  AdaptiveMultisampling::choose(colours,w,h,fx0-x0,fy0-y0,fragment_size().width(),fragment_size().height(),multisample_grid(),multisample_budget(),_multisampled);
+
+  _single_samples.resize(fragment_size().width()*fragment_size().height());
+  for (int row=0;row<fragment_size().height();row++)
+    for (int col=0;col<fragment_size().width();col++)
+      _single_samples[row*fragment_size().width()+col]=colours[(fy0-y0+row)*w+(fx0-x0+col)];
+
+  return true;
+}
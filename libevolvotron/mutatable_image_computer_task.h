@@ -32,12 +32,18 @@
 //! Class encapsulating all the parameters of, and output from, a single image generation run.
 class MutatableImageComputerTask
 {
+ public:
+
+  //! The fragments making up a pass.
+  typedef std::vector<boost::shared_ptr<const MutatableImageComputerTask> > Fragments;
+
  protected:
 
-  //! Flag indicating (to compute thread) that this task should be aborted.  Also indicates to MutatableImageDisplay that it's a dud and shouldn't be displayed..
-  /*! \todo Think more about whether this needs to be mutex protected for sanity.
+  //! Cancellation token: flag indicating (to compute thread) that this task should be aborted.  Also indicates to MutatableImageDisplay that it's a dud and shouldn't be displayed..
+  /*! Set by the GUI thread while a compute thread may be working on the task, which polls it every few hundred pixels;
+    atomic so that needs no lock, and once set it's never cleared.
    */
-  bool _aborted;
+  QAtomicInt _aborted;
 
   //! The display originating the task, and to which the output will be returned.
   MutatableImageDisplay*const _display;
@@ -49,8 +55,9 @@ class MutatableImageComputerTask
 
   //! Task priority.
   /*! Low numbers go to the head of the queue.
-    The total number of samples in the complete (non-fragmented) image is used,
-    so small low resolution images which can be quickly completed are run first.
+    The estimated time in microseconds to compute the complete (non-fragmented) image is used
+    (see MutatableImage::estimated_cost),
+    so small low resolution images, and images of cheap functions, which can be quickly completed are run first.
    */
   const uint _priority;
 
@@ -63,6 +70,9 @@ class MutatableImageComputerTask
   //! The full size of the image of which this is a fragment.
   const QSize _whole_image_size;
 
+  //! The size of the full resolution (level 0) image, in whose pixel coordinates samples are taken.
+  const QSize _full_image_size;
+
   //! Number of animation frames to be rendered
   const uint _frames;
 
@@ -84,6 +94,12 @@ class MutatableImageComputerTask
   //! Multisampling grid resolution e.g 4 implies a 4x4 grid
   const uint _multisample_grid;
 
+  //! Whether the image should be evaluated in float rather than double.
+  const bool _single_precision;
+
+  //! Most samples per pixel to evaluate on average when multisampling adaptively (0 multisamples every pixel).
+  const real _multisample_budget;
+
   //@{
   //! Track pixels computed, so tasks can be restarted after defer.  Row and column are relative to the fragment origin.
   uint _current_pixel;
@@ -103,7 +119,33 @@ class MutatableImageComputerTask
   void allocate_images() const;
   
   //! Set true by pixel_advance when it advances off the last frame.
-  bool _completed;
+  /*! Atomic because other threads look at it to see whether they can reuse the task's samples.
+   */
+  QAtomicInt _completed;
+
+  //! The fragments of the previous pass, whose samples this task reuses.
+  /*! Either a single sampled pass of half this resolution (see reusable_samples),
+    or, for an adaptively multisampled task, the single sampled pass at this resolution (see choose_multisampled).
+    Released once the task is done with, so passes don't keep all their predecessors alive.
+   */
+  boost::shared_ptr<const Fragments> _previous_pass;
+
+  //! Whether only the pixels which need it are multisampled, the rest keeping their colours from the previous pass.
+  const bool _adaptive;
+
+  //! The frame _multisampled and _single_samples were last chosen for (or -1 if never).
+  int _chosen_frame;
+
+  //! Whether each pixel of the fragment (in row order) is to be multisampled.  Empty if every pixel is.
+  std::vector<bool> _multisampled;
+
+  //! The previous pass's colours for each pixel of the fragment (in row order).
+  std::vector<uint> _single_samples;
+
+  //! Time spent computing the task so far, in nanoseconds (accumulated across defers).
+  /*! Used to size the next resolution level's tiles to the cost of each region of the image.
+   */
+  real _compute_time;
 
   //! Serial number, to fix some occasional out-of-order display problems
   unsigned long long int _serial;
@@ -118,13 +160,17 @@ class MutatableImageComputerTask
      const QSize& fo,
      const QSize& fs,
      const QSize& wis,
+     const QSize& fis,
      uint f,
      uint lev,
      uint frag,
      uint nfrag,
      bool j,
      uint ms,
-     unsigned long long int n
+     bool sp,
+     real mb,
+     unsigned long long int n,
+     const boost::shared_ptr<const Fragments>& prev
      );
   
   //! Destructor.
@@ -133,13 +179,13 @@ class MutatableImageComputerTask
   //! Accessor.
   bool aborted() const
     {
-      return _aborted;
+      return _aborted.loadAcquire();
     }
 
   //! Mark task as aborted.
   void abort()
     {
-      _aborted=true;
+      _aborted.storeRelease(1);
     }
 
   //! Accessor.
@@ -172,6 +218,18 @@ class MutatableImageComputerTask
       return _whole_image_size;
     }
 
+  //! Accessor.
+  const QSize& full_image_size() const
+    {
+      return _full_image_size;
+    }
+
+  //! Number of full resolution pixels across each pixel of this task's image.
+  uint subsample() const
+    {
+      return (1<<_level);
+    }
+
   //! Accessor.
   uint frames() const
     {
@@ -208,6 +266,24 @@ class MutatableImageComputerTask
       return _multisample_grid;
     }
 
+  //! Accessor.
+  bool single_precision() const
+    {
+      return _single_precision;
+    }
+
+  //! Accessor.
+  real multisample_budget() const
+    {
+      return _multisample_budget;
+    }
+
+  //! Accessor.
+  bool adaptive() const
+    {
+      return _adaptive;
+    }
+
   //! Serial number
   unsigned long long int serial() const
     {
@@ -220,6 +296,18 @@ class MutatableImageComputerTask
       return _priority;
     }
 
+  //! Accessor.
+  real compute_time() const
+    {
+      return _compute_time;
+    }
+
+  //! Add to the time spent computing the task (only by the compute thread working on it).
+  void add_compute_time(real ns)
+    {
+      _compute_time+=ns;
+    }
+
   //! Accessor, with lazy creation.
   std::vector<QImage>& images()
     {
@@ -261,7 +349,41 @@ class MutatableImageComputerTask
   //!Accessor.
   bool completed() const
     {
-      return _completed;
+      return _completed.loadAcquire();
+    }
+
+  //! Find colours for the pixels of a run of n pixels along row y of frame f (in whole image coordinates) from the previous pass.
+  /*! Pixels with even coordinates are sampled at exactly the same point as a pixel of the previous, half resolution, pass
+    (see MutatableImage::get_rgb), so they don't need computing again.
+    Returns true, setting colours to the colours of the even x pixels of the run in order,
+    if the run is on an even row and the previous pass has completed all of them.
+   */
+  bool reusable_samples(uint f,uint x,uint y,uint n,std::vector<uint>& colours) const;
+
+  //! Choose which pixels of frame f to multisample (unless already chosen), for an adaptive task.
+  /*! The choice is made by AdaptiveMultisampling from the previous, single sampled, pass's colours
+    for the fragment and the pixels bordering it.
+    Returns false if every pixel should be multisampled:
+    because the task isn't adaptive, or because the previous pass hasn't completed all the pixels needed.
+   */
+  bool choose_multisampled(uint f);
+
+  //! Whether the pixel at a column and row of the fragment was chosen to be multisampled (by choose_multisampled).
+  bool multisampled(uint col,uint row) const
+    {
+      return _multisampled[row*_fragment_size.width()+col];
+    }
+
+  //! The previous pass's colour for the pixel at a column and row of the fragment (valid once choose_multisampled has returned true).
+  uint single_sample(uint col,uint row) const
+    {
+      return _single_samples[row*_fragment_size.width()+col];
+    }
+
+  //! Let go of the previous pass, once the task is done with.
+  void release_previous_pass()
+    {
+      _previous_pass.reset();
     }
 
   //! Increment pixel count, set completed flag if advanced off end of last frame.
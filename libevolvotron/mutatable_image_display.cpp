@@ -26,8 +26,10 @@
 #include "mutatable_image_display_big.h"
 #include "evolvotron_main.h"
 #include "mutatable_image_computer_task.h"
+#include "pass_tiling.h"
 #include "transform_factory.h"
 #include "function_pre_transform.h"
+#include "function_profile.h"
 #include "function_top.h"
 
 /*! The constructor is passed:
@@ -52,6 +54,8 @@ MutatableImageDisplay::MutatableImageDisplay(EvolvotronMain* mn,bool full_functi
   ,_current_display_level(0)
   ,_current_display_multisample_grid(0)
   ,_icon_serial(0LL)
+  ,_passes_queued(0)
+  ,_one_of_many(false)
   ,_properties(0)
   ,_menu(0)
   ,_menu_big(0)
@@ -122,6 +126,7 @@ MutatableImageDisplay::MutatableImageDisplay(EvolvotronMain* mn,bool full_functi
   _menu->addSeparator();
   _menu->addAction("Simplify function",this,SLOT(menupick_simplify()));
   _menu->addAction("Properties...",this,SLOT(menupick_properties()));
+  _menu->addAction("Profile...",this,SLOT(menupick_profile()));
 
   main().hello(this);
 
@@ -173,7 +178,8 @@ uint MutatableImageDisplay::simplify_constants(bool single_action)
   uint old_depth;
   uint old_width;
   real old_const;
-  _image_function->get_stats(old_nodes,old_parameters,old_depth,old_width,old_const);
+  real old_cost;
+  _image_function->get_stats(old_nodes,old_parameters,old_depth,old_width,old_const,old_cost);
 
   main().history().replacing(this);
 
@@ -184,7 +190,8 @@ uint MutatableImageDisplay::simplify_constants(bool single_action)
   uint new_depth;
   uint new_width;
   real new_const;
-  _image_function->get_stats(new_nodes,new_parameters,new_depth,new_width,new_const);
+  real new_cost;
+  _image_function->get_stats(new_nodes,new_parameters,new_depth,new_width,new_const,new_cost);
 
   const uint nodes_eliminated=old_nodes-new_nodes;
 
@@ -264,79 +271,172 @@ void MutatableImageDisplay::image_function(const boost::shared_ptr<const Mutatab
   if (_menu_item_action_lock)
     _menu_item_action_lock->setChecked(_image_function.get() ? _image_function->locked() : false);
   
+  _passes.clear();
+  _passes_queued=0;
+  _one_of_many=one_of_many;
+  _last_pass_fragments.reset();
   if (_image_function.get())
     {
       // Allow for displays up to 4096 pixels high or wide
       for (int level=12;level>=0;level--)
 	{
-	  const int s=(1<<level);
-	  const QSize render_size(image_size()/s);
+	  const QSize render_size(level_size(level));
 	  
 	  // Don't bother rendering anything less than 4x4 unless that's all there is
 	  if ((render_size.width()>=4 && render_size.height()>=4) || level==0)
 	    {
-	      const int fragments
-		=(
-		  one_of_many
-		  ?
-		  1
-		  :
-		  std::min
-		  (
-		   2*farm().num_threads(),
-		   static_cast<uint>(render_size.height())
-		   )
-		  );
-	      
-	      std::vector<uint> multisample_grid;
-	      multisample_grid.push_back(1);
-	      if (level==0)
-		{
-		  // Only the final full resolution level gets an additional multisampling task.
-		  // For 4x4 sampling, do an initial 2x2 too.
-		  if (main().render_parameters().multisample_grid()==4) multisample_grid.push_back(2);
-		  if (main().render_parameters().multisample_grid()>1) multisample_grid.push_back(main().render_parameters().multisample_grid());
-		}
-
-	      for (std::vector<uint>::const_iterator multisample_it=multisample_grid.begin();multisample_it!=multisample_grid.end();multisample_it++)
-		{
-		  //! \todo Should computed animation frames be constant or reduced c.f spatial resolution ?  (Do full z resolution for now)
-		  const boost::shared_ptr<const MutatableImage> task_image(_image_function);
-		  assert(task_image->ok());
-		  
-		  // Use number of samples in unfragmented image as priority
-		  const uint task_priority=render_size.width()*render_size.height()*(*multisample_it)*(*multisample_it);
-		  
-		  int fragment_start_row=0;
-		  for (int f=0;f<fragments;f++)
-		    {
-		      const int fragment_end_row=(render_size.height()*(f+1))/fragments;
-		      const boost::shared_ptr<MutatableImageComputerTask> task
-			(
-			 new MutatableImageComputerTask
-			 (
-			  this,
-			  task_image,
-			  task_priority,
-			  QSize(0,fragment_start_row),
-			  QSize(render_size.width(),fragment_end_row-fragment_start_row),
-			  render_size,
-			  _frames,
-			  level,
-			  f,
-			  fragments,
-			  main().render_parameters().jittered_samples(),
-			  (*multisample_it),
-			  _serial
-			  )
-			 );
-		      farm().push_todo(task);
-		      fragment_start_row=fragment_end_row;
-		    }
-		}
+	      _passes.push_back(OffscreenImageInbox::key_type(level,1));
 	    }
 	}
+
+      // Only the final full resolution level gets an additional multisampling pass.
+      // For 4x4 sampling, do an initial 2x2 too (unless multisampling adaptively, which is cheap enough not to need it).
+      if (main().render_parameters().multisample_grid()==4 && !main().render_parameters().adaptive_multisampling()) _passes.push_back(OffscreenImageInbox::key_type(0,2));
+      if (main().render_parameters().multisample_grid()>1) _passes.push_back(OffscreenImageInbox::key_type(0,main().render_parameters().multisample_grid()));
+
+      // Queue everything up to the first pass worth splitting up, and the one after that (so the threads aren't left idle between passes).
+      // The rest follow as each pass is delivered.
+      // Splitting isn't worthwhile when many other images are also being computed.
+      // An adaptive multisampling pass always waits for the pass before it.
+      while (_passes_queued<_passes.size() && !adaptive_pass(_passes[_passes_queued]) && (one_of_many || estimated_pass_cost(_passes[_passes_queued])<min_fragment_cost()))
+	{
+	  queue_pass(_passes[_passes_queued],false,0);
+	  _passes_queued++;
+	}
+      for (uint n=0;n<2 && _passes_queued<_passes.size() && !adaptive_pass(_passes[_passes_queued]);n++)
+	{
+	  queue_pass(_passes[_passes_queued],true,0);
+	  _passes_queued++;
+	}
+    }
+}
+
+/*! Rounded up, so each pixel's top left full resolution pixel (where it's sampled) is inside the image,
+  and every pixel of a level is sampled at the same point as an even pixel of the next higher resolution level.
+ */
+const QSize MutatableImageDisplay::level_size(uint level) const
+{
+  const int s=(1<<level);
+  return QSize((image_size().width()+s-1)/s,(image_size().height()+s-1)/s);
+}
+
+real MutatableImageDisplay::estimated_pass_cost(const OffscreenImageInbox::key_type& pass) const
+{
+  const QSize render_size(level_size(pass.first));
+  const real samples=(adaptive_pass(pass) ? std::min(real(pass.second*pass.second),main().render_parameters().multisample_budget()) : real(pass.second*pass.second));
+  return 1e-3*render_size.width()*render_size.height()*_frames*samples*_image_function->estimated_cost();
+}
+
+bool MutatableImageDisplay::adaptive_pass(const OffscreenImageInbox::key_type& pass) const
+{
+  return (pass.second>1 && main().render_parameters().adaptive_multisampling());
+}
+
+void MutatableImageDisplay::queue_pass(const OffscreenImageInbox::key_type& pass,bool split,const OffscreenImageInbox::mapped_type* measured)
+{
+  //! \todo Should computed animation frames be constant or reduced c.f spatial resolution ?  (Do full z resolution for now)
+  const boost::shared_ptr<const MutatableImage> task_image(_image_function);
+  assert(task_image->ok());
+
+  const uint level=pass.first;
+  const uint multisample_grid=pass.second;
+  const QSize render_size(level_size(level));
+  const real pass_cost=estimated_pass_cost(pass);
+
+  // Where the cost of each part of the image comes from: the earlier pass's fragments scaled up to this pass's resolution,
+  // with their measured times scaled to add up to this pass's estimated cost.
+  std::vector<PassTiling::Region> regions;
+  if (measured)
+    {
+      real measured_total=0.0;
+      for (OffscreenImageInbox::mapped_type::const_iterator it=measured->begin();it!=measured->end();it++)
+	measured_total+=(*it).second->compute_time();
+
+      for (OffscreenImageInbox::mapped_type::const_iterator it=measured->begin();measured_total>0.0 && it!=measured->end();it++)
+	{
+	  const MutatableImageComputerTask& fragment=*(*it).second;
+	  const real sx=render_size.width()/static_cast<real>(fragment.whole_image_size().width());
+	  const real sy=render_size.height()/static_cast<real>(fragment.whole_image_size().height());
+	  const PassTiling::Region region=
+	    {
+	      sx*fragment.fragment_origin().width(),
+	      sy*fragment.fragment_origin().height(),
+	      sx*(fragment.fragment_origin().width()+fragment.fragment_size().width()),
+	      sy*(fragment.fragment_origin().height()+fragment.fragment_size().height()),
+	      pass_cost*fragment.compute_time()/measured_total
+	    };
+	  regions.push_back(region);
+	}
+    }
+  if (regions.empty())
+    {
+      const PassTiling::Region region={0.0,0.0,real(render_size.width()),real(render_size.height()),pass_cost};
+      regions.push_back(region);
+    }
+
+  // Split expensive passes finely enough to keep all the threads busy (with the expensive parts in smaller tiles),
+  // but don't bother splitting cheap ones.
+  std::vector<PassTiling::Region> tiles;
+  if (split && pass_cost>min_fragment_cost())
+    {
+      const real max_tile_cost=std::max(min_fragment_cost(),pass_cost/(4*farm().num_threads()));
+      const int min_tile_side=16;
+      PassTiling::split(render_size.width(),render_size.height(),max_tile_cost,min_tile_side,regions,tiles);
+    }
+  else
+    {
+      const PassTiling::Region tile={0.0,0.0,real(render_size.width()),real(render_size.height()),pass_cost};
+      tiles.push_back(tile);
+    }
+
+  // A single sampled pass can reuse the samples of a single sampled pass of half the resolution queued just before it,
+  // and an adaptive multisampling pass needs the single sampled pass at the same resolution.
+  boost::shared_ptr<const MutatableImageComputerTask::Fragments> previous_pass;
+  if (multisample_grid==1 && _last_pass==OffscreenImageInbox::key_type(level+1,1))
+    previous_pass=_last_pass_fragments;
+  else if (adaptive_pass(pass) && _last_pass==OffscreenImageInbox::key_type(level,1))
+    previous_pass=_last_pass_fragments;
+  
+  const boost::shared_ptr<MutatableImageComputerTask::Fragments> fragments(new MutatableImageComputerTask::Fragments);
+
+  // Use estimated time to compute the whole pass as priority, so the passes go in order,
+  // but within a pass spread the tiles' priorities over the next half of that so the most expensive tiles are started first.
+  for (uint t=0;t<tiles.size();t++)
+    {
+      const real priority=pass_cost*(1.0+0.5*t/tiles.size());
+      const boost::shared_ptr<MutatableImageComputerTask> task
+	(
+	 new MutatableImageComputerTask
+	 (
+	  this,
+	  task_image,
+	  static_cast<uint>(std::min(priority,static_cast<real>(std::numeric_limits<uint>::max()))),
+	  QSize(static_cast<int>(tiles[t].x0),static_cast<int>(tiles[t].y0)),
+	  QSize(static_cast<int>(tiles[t].x1-tiles[t].x0),static_cast<int>(tiles[t].y1-tiles[t].y0)),
+	  render_size,
+	  image_size(),
+	  _frames,
+	  level,
+	  t,
+	  tiles.size(),
+	  main().render_parameters().jittered_samples(),
+	  multisample_grid,
+	  main().render_parameters().single_precision(),
+	  main().render_parameters().multisample_budget(),
+	  _serial,
+	  previous_pass
+	  )
+	 );
+      fragments->push_back(task);
+      farm().push_todo(task);
     }
+
+  // Hang on to the fragments for the next pass (unless there isn't one).
+  _last_pass=pass;
+  if (pass!=_passes.back())
+    _last_pass_fragments=fragments;
+  else
+    _last_pass_fragments.reset();
 }
 
 void MutatableImageDisplay::deliver(const boost::shared_ptr<const MutatableImageComputerTask>& task)
@@ -421,6 +521,19 @@ void MutatableImageDisplay::deliver(const boost::shared_ptr<const MutatableImage
       _icon_serial=task->serial();
     }
 
+  // Now it's known how long each part of this pass took, the pass after next can be split up to match.
+  // (Also done if this is the pass after, as any earlier pass still to complete will now be ignored.)
+  // An adaptive multisampling pass is the exception: it's computed from the samples of the pass just before it, so must wait for that.
+  if (_passes_queued<_passes.size())
+    {
+      const uint lookahead=(adaptive_pass(_passes[_passes_queued]) ? 1 : 2);
+      if (std::find(_passes.begin()+_passes_queued-lookahead,_passes.begin()+_passes_queued,inbox_key)!=_passes.begin()+_passes_queued)
+	{
+	  queue_pass(_passes[_passes_queued],!_one_of_many,&inbox_level);
+	  _passes_queued++;
+	}
+    }
+
   // Update what's on the screen.
   update();
 }
@@ -997,8 +1110,9 @@ void MutatableImageDisplay::menupick_properties()
   uint depth;
   uint width;
   real proportion_constant;
+  real estimated_cost;
 
-  image_function()->get_stats(total_nodes,total_parameters,depth,width,proportion_constant);
+  image_function()->get_stats(total_nodes,total_parameters,depth,width,proportion_constant,estimated_cost);
 
   std::stringstream msg;
   msg << " " << total_nodes      << "\t function nodes\n";
@@ -1006,6 +1120,8 @@ void MutatableImageDisplay::menupick_properties()
   msg << " " << depth            << "\t maximum depth\n";
   msg << " " << width            << "\t width\n";
   msg << " " << std::setprecision(3) << 100.0*proportion_constant << "%\t constant\n";
+  msg << " " << std::setprecision(3) << estimated_cost << "ns\t estimated per sample\n";
+  msg << " " << std::setprecision(3) << 1e-6*estimated_cost*image_size().width()*image_size().height()*_frames << "ms\t estimated per single-sampled image\n";
 
   std::stringstream xml;
   image_function()->save_function(xml);
@@ -1014,6 +1130,24 @@ void MutatableImageDisplay::menupick_properties()
   _properties->exec();
 }
 
+/*! Profiles a single-sampled image of the display's size (all frames), in the GUI thread.
+ */
+void MutatableImageDisplay::menupick_profile()
+{
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  const std::unique_ptr<FunctionProfile> profile(image_function()->profile(image_size().width(),image_size().height(),_frames,1));
+  QApplication::restoreOverrideCursor();
+
+  std::stringstream msg;
+  profile->report(msg);
+
+  std::stringstream stacks;
+  profile->collapsed_stacks(stacks);
+
+  _properties->set_content(msg.str(),stacks.str());
+  _properties->exec();
+}
+
 /*! Create an image display as a top level window.
   Disable full menu functionality because there's less we can do with a single image (e.g no spawn_target)
 
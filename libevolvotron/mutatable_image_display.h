@@ -107,6 +107,24 @@ class MutatableImageDisplay : public QWidget
    */
   OffscreenImageInbox _offscreen_images_inbox;
 
+  //! The passes (level and multisampling, as in OffscreenImageInbox keys) needed to compute the current image, in order.
+  std::vector<OffscreenImageInbox::key_type> _passes;
+
+  //! Number of _passes queued for computing so far.
+  /*! Cheap passes are all queued at once, but each expensive one is only queued once the pass before it has been delivered,
+    so it can be split into tiles sized by how long each part of that pass took (see queue_pass()).
+   */
+  uint _passes_queued;
+
+  //! Whether the current image is being computed along with many others (so passes aren't worth splitting up).
+  bool _one_of_many;
+
+  //! The pass most recently queued.
+  OffscreenImageInbox::key_type _last_pass;
+
+  //! The fragments of the pass most recently queued, for the next pass to reuse samples from.
+  boost::shared_ptr<const std::vector<boost::shared_ptr<const MutatableImageComputerTask> > > _last_pass_fragments;
+
   //! The image function being displayed (its root node).
   /*! The held image is const because references to it could be held by history archive, compute tasks etc,
     so it should be completely replaced rather than manipulated.
@@ -194,6 +212,32 @@ class MutatableImageDisplay : public QWidget
   //! Which farm this display should use.
   MutatableImageComputerFarm& farm() const;
 
+  //! Estimated time (in microseconds) below which a pass isn't worth splitting up between threads.
+  static real min_fragment_cost()
+    {
+      return 1000.0;
+    }
+
+  //! Size of the image computed at a resolution level (0=1-for-1 pixels, 1=half resolution etc).
+  const QSize level_size(uint level) const;
+
+  //! Estimated time to compute one of the image's passes, in microseconds.
+  real estimated_pass_cost(const OffscreenImageInbox::key_type& pass) const;
+
+  //! Whether a pass is adaptively multisampled.
+  /*! Such a pass is computed from the single sampled full resolution pass before it (see AdaptiveMultisampling),
+    so it's only queued once that has been delivered.
+   */
+  bool adaptive_pass(const OffscreenImageInbox::key_type& pass) const;
+
+  //! Queue the tasks to compute a pass.
+  /*! Unless split is false, expensive passes are split into square tiles, finer where the image is more costly to compute.
+    The cost of each part of the image is taken from the measured compute times of the fragments of a completed earlier pass
+    (which may be null, in which case it's assumed uniform).
+    Tiles are queued most expensive first.
+   */
+  void queue_pass(const OffscreenImageInbox::key_type& pass,bool split,const OffscreenImageInbox::mapped_type* measured);
+
   //! Take a snapshot to undo back to.
   void snapshot(const char* name);
 
@@ -310,6 +354,9 @@ class MutatableImageDisplay : public QWidget
   //! Called from "Properties" on context menu
   void menupick_properties();
 
+  //! Called from "Profile" on context menu
+  void menupick_profile();
+
  protected:
   //! Common code for big slots.
   void spawn_big(int w, int h);
@@ -0,0 +1,69 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Implementation of class PassTiling.
+*/
+
+#include "pass_tiling.h"
+
+real PassTiling::cost(real x0,real y0,real x1,real y1,const std::vector<Region>& regions)
+{
+  real ret=0.0;
+  for (std::vector<Region>::const_iterator it=regions.begin();it!=regions.end();it++)
+    {
+      const real w=std::min(x1,(*it).x1)-std::max(x0,(*it).x0);
+      const real h=std::min(y1,(*it).y1)-std::max(y0,(*it).y0);
+      if (w>0.0 && h>0.0)
+	ret+=(*it).cost*(w*h)/(((*it).x1-(*it).x0)*((*it).y1-(*it).y0));
+    }
+  return ret;
+}
+
+void PassTiling::split(int width,int height,real max_cost,int min_side,const std::vector<Region>& regions,std::vector<Region>& tiles)
+{
+  int side=1;
+  while (side<width || side<height) side*=2;
+
+  split_square(0,0,side,width,height,max_cost,min_side,regions,tiles);
+  std::stable_sort(tiles.begin(),tiles.end(),more_expensive);
+}
+
+void PassTiling::split_square(int x,int y,int side,int width,int height,real max_cost,int min_side,const std::vector<Region>& regions,std::vector<Region>& tiles)
+{
+  if (x>=width || y>=height)
+    return;
+
+  const Region tile={real(x),real(y),real(std::min(x+side,width)),real(std::min(y+side,height)),0.0};
+  const real tile_cost=cost(tile.x0,tile.y0,tile.x1,tile.y1,regions);
+  if (tile_cost<=max_cost || side<=min_side)
+    {
+      tiles.push_back(tile);
+      tiles.back().cost=tile_cost;
+    }
+  else
+    {
+      const int half=side/2;
+      split_square(x,y,half,width,height,max_cost,min_side,regions,tiles);
+      split_square(x+half,y,half,width,height,max_cost,min_side,regions,tiles);
+      split_square(x,y+half,half,width,height,max_cost,min_side,regions,tiles);
+      split_square(x+half,y+half,half,width,height,max_cost,min_side,regions,tiles);
+    }
+}
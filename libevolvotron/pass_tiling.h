@@ -0,0 +1,69 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file 
+  \brief Interface for class PassTiling.
+*/
+
+#ifndef _pass_tiling_h_
+#define _pass_tiling_h_
+
+#include "common.h"
+#include "useful.h"
+
+//! Splits a pass of an image into tiles of bounded cost, given how the cost is spread over the image.
+/*! Used by MutatableImageDisplay to fragment expensive passes, with the cost map measured from an earlier pass's fragments.
+ */
+class PassTiling
+{
+ public:
+
+  //! A rectangle of a pass's image (in pixels), and the cost of computing it.
+  struct Region
+  {
+    real x0;
+    real y0;
+    real x1;
+    real y1;
+    real cost;
+  };
+
+  //! Estimated cost of a rectangle, given regions of known cost covering the image, each of whose cost is spread evenly over its area.
+  static real cost(real x0,real y0,real x1,real y1,const std::vector<Region>& regions);
+
+  //! Cover a width by height image with square tiles costing no more than max_cost, most expensive first.
+  /*! Squares are quartered until their parts are cheap enough, or min_side pixels across,
+    so expensive parts of the image get small tiles and cheap parts big ones.
+   */
+  static void split(int width,int height,real max_cost,int min_side,const std::vector<Region>& regions,std::vector<Region>& tiles);
+
+ protected:
+
+  //! Cover the part of a square inside a width by height image with tiles, appending them to tiles.
+  static void split_square(int x,int y,int side,int width,int height,real max_cost,int min_side,const std::vector<Region>& regions,std::vector<Region>& tiles);
+
+  //! Predicate for sorting tiles most expensive first.
+  static bool more_expensive(const Region& a,const Region& b)
+    {
+      return a.cost>b.cost;
+    }
+};
+
+#endif
@@ -24,10 +24,12 @@
 #include "useful.h"
 #include "render_parameters.h"
 
-RenderParameters::RenderParameters(bool j,uint m,QObject* parent)
+RenderParameters::RenderParameters(bool j,uint m,bool sp,real mb,QObject* parent)
   :QObject(parent)
   ,_jittered_samples(j)
   ,_multisample_grid(clamped(m,1u,4u))
+  ,_single_precision(sp)
+  ,_multisample_budget(std::max(real(0.0),mb))
 {}
 
 RenderParameters::~RenderParameters()
@@ -25,6 +25,7 @@
 #define _render_parameters_h_
 
 #include "common.h"
+#include "useful.h"
 
 template <typename T> bool change(T& dst,const T& src)
 {
@@ -39,7 +40,7 @@ class RenderParameters : public QObject
   Q_OBJECT;
 
  public:
-  RenderParameters(bool jitter,uint multisample,QObject* parent);
+  RenderParameters(bool jitter,uint multisample,bool single_precision,real multisample_budget,QObject* parent);
   ~RenderParameters();
 
   //! Accessor.
@@ -68,6 +69,36 @@ class RenderParameters : public QObject
       if (change(_multisample_grid,v)) report_change();
     }
 
+  //! Accessor.
+  bool single_precision() const
+    {
+      return _single_precision;
+    }
+
+  //! Accessor.
+  void single_precision(bool v)
+    {
+      if (change(_single_precision,v)) report_change();
+    }
+
+  //! Accessor.
+  real multisample_budget() const
+    {
+      return _multisample_budget;
+    }
+
+  //! Accessor.
+  void multisample_budget(real v)
+    {
+      if (change(_multisample_budget,v)) report_change();
+    }
+
+  //! Whether multisampling is adaptive (only applied to pixels which need it; see AdaptiveMultisampling).
+  bool adaptive_multisampling() const
+    {
+      return (_multisample_grid>1 && _multisample_budget>0.0);
+    }
+
 signals:
   void changed();
 
@@ -83,6 +114,14 @@ signals:
   /*! Default is 1.  4 would be 16 samples in a 4x4 grid.
    */
   uint _multisample_grid;
+
+  //! Whether images should be evaluated in float rather than double.
+  bool _single_precision;
+
+  //! Most samples per pixel to evaluate on average when multisampling adaptively.
+  /*! Default is 0, which multisamples every pixel instead.
+   */
+  real _multisample_budget;
 };
 
 
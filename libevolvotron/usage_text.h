@@ -108,6 +108,29 @@
 "</ul>\n"
 "</p>\n"
 "<p>\n"
+"  <ul><li>--precision <i>float|double</i><br>\n"
+"  Evaluate image functions in single or double precision (default\n"
+"  double).  Single precision roughly doubles the speed of the\n"
+"  built-in arithmetic on SIMD hardware, though most functions spend\n"
+"  their time elsewhere and gain little.  Functions containing\n"
+"  fractal or gradient nodes are always evaluated in double, as single\n"
+"  precision would visibly change them.\n"
+"</li>\n"
+"</ul>\n"
+"</p>\n"
+"<p>\n"
+"  <ul><li>--sample-budget <i>samples per pixel</i><br>\n"
+"  Multisample adaptively: only pixels differing noticeably from one of\n"
+"  their neighbours in the full resolution single sampled image get the\n"
+"  final multisampling pass, and the 2x2 pass is skipped.  The budget caps\n"
+"  the average number of samples evaluated per pixel (counting the single\n"
+"  sample); if more pixels need multisampling than it allows, the highest\n"
+"  contrast ones are chosen.  Has no effect without -m.  The default of 0\n"
+"  multisamples every pixel.\n"
+"</li>\n"
+"</ul>\n"
+"</p>\n"
+"<p>\n"
 "  <ul><li>-p, --spheremap<br>\n"
 "  Images are produced by sampling the underlying 3D function on the\n"
 "  latitude-longitude grid of a sphere.  The resulting images should be\n"
@@ -354,6 +377,14 @@
 "</li>\n"
 "</ul>\n"
 "</p>\n"
+"<p>\n"
+"  <ul><li>&quot;Profile&quot; evaluates the image again with every function node\n"
+"  instrumented, and shows how much time was spent in each type of\n"
+"  function (and, on the &quot;Detail&quot; tab, in each path through the function\n"
+"  tree, in the collapsed stack format read by flamegraph.pl).\n"
+"</li>\n"
+"</ul>\n"
+"</p>\n"
 "<h3>Middle Mouse Button</h3>\n"
 "<p>\n"
 "  [NB This feature will probably only be of practical use to those with high-end machines].\n"
@@ -53,34 +53,34 @@ struct ClampZ
 };
 
 //! Function evaluation via symmetry.
-template <class SYMMETRY,class ZPOLICY> 
-  inline const XYZ FriezegroupEvaluate
+template <class SYMMETRY,class ZPOLICY,typename T> 
+  inline const BasicXYZ<T> FriezegroupEvaluate
     (
-     const Function& f,const XYZ& p,const SYMMETRY& sym,const ZPOLICY& zpol
+     const Function& f,const BasicXYZ<T>& p,const SYMMETRY& sym,const ZPOLICY& zpol
      )
 {
-  return f(XYZ(sym(p.xy()),zpol(p.z())));
+  return f(BasicXYZ<T>(sym(p.xy()),zpol(p.z())));
 }
 
 //! Function evaluation with blending.
 /*! NB Is symmetry unaware; blend must have already reduced points to base domain.
  */
-template<class BLEND,class ZPOLICY> 
-  inline const XYZ FriezegroupBlend
+template<class BLEND,class ZPOLICY,typename T> 
+  inline const BasicXYZ<T> FriezegroupBlend
     (
-     const Function& f0,const Function& f1,const XYZ& p,const BLEND& blend,const ZPOLICY& zpol
+     const Function& f0,const Function& f1,const BasicXYZ<T>& p,const BLEND& blend,const ZPOLICY& zpol
      )
 {
   const boost::tuple<real,XY,XY> b(blend(p.xy()));
   return
-          b.get<0>() *f0(XYZ(b.get<1>(),zpol(p.z())))
-    +(1.0-b.get<0>())*f1(XYZ(b.get<2>(),zpol(p.z())));
+          b.get<0>() *f0(BasicXYZ<T>(b.get<1>(),zpol(p.z())))
+    +(1.0-b.get<0>())*f1(BasicXYZ<T>(b.get<2>(),zpol(p.z())));
 }
 
-template<class BLEND,class ZPOLICY> 
-  inline const XYZ FriezegroupBlend
+template<class BLEND,class ZPOLICY,typename T> 
+  inline const BasicXYZ<T> FriezegroupBlend
     (
-     const Function& f,const XYZ& p,const BLEND& blend,const ZPOLICY& zpol
+     const Function& f,const BasicXYZ<T>& p,const BLEND& blend,const ZPOLICY& zpol
      )
 {
   return FriezegroupBlend(f,f,p,blend,zpol);
@@ -27,16 +27,31 @@
 
 #include "useful.h"
 
+#include <type_traits>
+
 #include "function_node.h"
 #include "function_node_info.h"
 #include "function_registry.h"
 #include "margin.h"
 
 //! Template class to generate boilerplate for virtual methods.
+/*! The function classes implement evaluation as member templates,
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
+  and optionally template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const,
+  whose parameters shadow the usual XYZ and real so the same code evaluates in either precision.
+  The virtual evaluate and evaluate_batch methods for double and float are generated from them here.
+ */
 template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION> class FunctionBoilerplate : public FunctionNode
 {
  public:
   typedef FunctionNode Superclass;
+
+  //! Whether single precision evaluation should evaluate this node (and so its whole subtree) in double instead.
+  /*! By default the fractal functions are promoted, as their escape iterations amplify rounding until float visibly diverges.
+    Function classes which need double for other reasons
+    (such as the finite difference operators, whose steps are too small to resolve in float) redeclare this.
+   */
+  static constexpr bool promote_to_double=((CLASSIFICATION&FnFractal)!=0);
   
   //! Constructor
   /*! \warning Careful to pass an appropriate initial iteration count for iterative functions.
@@ -46,10 +61,6 @@ template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint C
   //! Destructor.
   virtual ~FunctionBoilerplate();
 
-  //! Accessor providing function name
-  virtual const char* thisname() const
-    =0;
-
   //! Make function meta-information.
   static FunctionRegistration* make_registration(const char* fn_name);
     
@@ -59,6 +70,9 @@ template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint C
   //! Bits give some classification of the function type
   virtual uint self_classification() const;
 
+  //! Whether single precision evaluation of this node is promoted to double.
+  virtual bool self_promotes_to_double() const;
+
   //! Factory method to create a stub node for this type
   static std::unique_ptr<FunctionNode> stubnew(const MutationParameters& mutation_parameters,bool exciting);
 
@@ -78,6 +92,37 @@ template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint C
 
   //! Save this node.
   virtual std::ostream& save_function(std::ostream& out,uint indent) const;
+
+  //! Evaluate function.
+  virtual const XYZ evaluate(const XYZ& p) const;
+
+  //! Evaluate function in single precision (or in double, if promote_to_double).
+  virtual const XYZf evaluate(const XYZf& p) const;
+
+  //! Evaluate function over a run of points.
+  virtual void evaluate_batch(const XYZ* in,XYZ* out,size_t n) const;
+
+  //! Evaluate function over a run of points in single precision (or in double, if promote_to_double).
+  virtual void evaluate_batch(const XYZf* in,XYZf* out,size_t n) const;
+
+  //! Default for function classes without a batch implementation of their own: evaluate_generic at each point.
+  /*! Unlike looping over the virtual evaluate, the call can be inlined.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      for (size_t i=0;i<n;i++)
+	out[i]=static_cast<const FUNCTION*>(this)->template evaluate_generic<XYZ,real>(in[i]);
+    }
+
+ private:
+
+  //@{
+  //! Single precision evaluation, either in float or (for std::true_type) promoted to double.
+  const XYZf evaluate_single(const XYZf& p,std::false_type) const;
+  const XYZf evaluate_single(const XYZf& p,std::true_type) const;
+  void evaluate_batch_single(const XYZf* in,XYZf* out,size_t n,std::false_type) const;
+  void evaluate_batch_single(const XYZf* in,XYZf* out,size_t n,std::true_type) const;
+  //@}
 };
 
 template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION> 
@@ -115,6 +160,12 @@ uint FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>
   return CLASSIFICATION;
 }
 
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+bool FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::self_promotes_to_double() const
+{
+  return FUNCTION::promote_to_double;
+}
+
 template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
 std::unique_ptr<FunctionNode> FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::stubnew(const MutationParameters& mutation_parameters,bool exciting)
 {
@@ -181,8 +232,65 @@ std::ostream& FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSI
   return Superclass::save_function(out,indent,thisname());
 }
 
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+const XYZ FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::evaluate(const XYZ& p) const
+{
+  return static_cast<const FUNCTION*>(this)->template evaluate_generic<XYZ,real>(p);
+}
+
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+const XYZf FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::evaluate(const XYZf& p) const
+{
+  return evaluate_single(p,std::integral_constant<bool,FUNCTION::promote_to_double>());
+}
+
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+void FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::evaluate_batch(const XYZ* in,XYZ* out,size_t n) const
+{
+  static_cast<const FUNCTION*>(this)->template evaluate_batch_generic<XYZ,real>(in,out,n);
+}
+
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+void FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::evaluate_batch(const XYZf* in,XYZf* out,size_t n) const
+{
+  evaluate_batch_single(in,out,n,std::integral_constant<bool,FUNCTION::promote_to_double>());
+}
+
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+const XYZf FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::evaluate_single(const XYZf& p,std::false_type) const
+{
+  return static_cast<const FUNCTION*>(this)->template evaluate_generic<XYZf,float>(p);
+}
+
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+const XYZf FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::evaluate_single(const XYZf& p,std::true_type) const
+{
+  return XYZf(evaluate(XYZ(p)));
+}
+
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+void FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::evaluate_batch_single(const XYZf* in,XYZf* out,size_t n,std::false_type) const
+{
+  static_cast<const FUNCTION*>(this)->template evaluate_batch_generic<XYZf,float>(in,out,n);
+}
+
+/*! The points are widened to double and the whole batch evaluated in double.
+ */
+template <typename FUNCTION,uint PARAMETERS,uint ARGUMENTS,bool ITERATIVE,uint CLASSIFICATION>
+void FunctionBoilerplate<FUNCTION,PARAMETERS,ARGUMENTS,ITERATIVE,CLASSIFICATION>::evaluate_batch_single(const XYZf* in,XYZf* out,size_t n,std::true_type) const
+{
+  if (n==0) return;
+  std::vector<XYZ> q(n);
+  std::vector<XYZ> v(n);
+  for (size_t i=0;i<n;i++)
+    q[i]=XYZ(in[i]);
+  evaluate_batch(&q[0],&v[0],n);
+  for (size_t i=0;i<n;i++)
+    out[i]=XYZf(v[i]);
+}
+
 #define FN_CTOR_DCL(FN) FN(const std::vector<real>& p,boost::ptr_vector<FunctionNode>& a,uint iter);
-#define FN_CTOR_IMP(FN) FN::FN(const std::vector<real>& p,boost::ptr_vector<FunctionNode>& a,uint iter) :Superclass(p,a,iter) {}
+#define FN_CTOR_IMP(FN) FN::FN(const std::vector<real>& p,boost::ptr_vector<FunctionNode>& a,uint iter) :Superclass(p,a,iter) {update_derived();update_estimated_cost();}
 
 #define FN_DTOR_DCL(FN) virtual ~FN();
 #define FN_DTOR_IMP(FN) FN::~FN() {}
@@ -27,15 +27,33 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
 
 FUNCTION_BEGIN(FunctionComposePair,0,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return arg(1)(arg(0)(p));
     }
 
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> v0(n);
+      arg(0)(in,&v0[0],n);
+      arg(1)(&v0[0],out,n);
+    }
+
+  //! Compile the arguments in sequence.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      const uint v0=program.emit_node(arg(0),input);
+      const uint r=program.emit_node(arg(1),v0);
+      program.release(v0);
+      return r;
+    }
+
   //! Is constant if any (rather than default "all") function is constant.
   /*! One of the few cases it's worth overriding this method
    */
@@ -44,6 +62,13 @@ FUNCTION_BEGIN(FunctionComposePair,0,2,false,0)
       return (arg(0).is_constant() || arg(1).is_constant());
     }
 
+ protected:
+
+  //! Composition with an affine function (such as the identity) becomes a pre- or post-transform of the other argument.
+  /*! These in turn drop out entirely if the transform is the identity.
+   */
+  virtual std::unique_ptr<FunctionNode> optimised();
+
 FUNCTION_END(FunctionComposePair)
 
 #endif
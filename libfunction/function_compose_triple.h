@@ -27,15 +27,37 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
 
 FUNCTION_BEGIN(FunctionComposeTriple,0,3,false,0)
   
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return arg(2)(arg(1)(arg(0)(p)));
     }
 
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> v0(n);
+      std::vector<XYZ> v1(n);
+      arg(0)(in,&v0[0],n);
+      arg(1)(&v0[0],&v1[0],n);
+      arg(2)(&v1[0],out,n);
+    }
+
+  //! Compile the arguments in sequence.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      const uint v0=program.emit_node(arg(0),input);
+      const uint v1=program.emit_node(arg(1),v0);
+      program.release(v0);
+      const uint r=program.emit_node(arg(2),v1);
+      program.release(v1);
+      return r;
+    }
+
   //! Is constant if any (rather than default "all") function is constant.
   /*! One of the few cases it's worth overriding this method
    */
@@ -27,6 +27,7 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
 
 //------------------------------------------------------------------------------------------
 
@@ -34,11 +35,23 @@
 FUNCTION_BEGIN(FunctionConstant,3,0,false,FnCore)
   
   //! Returns the constant value
-  virtual const XYZ evaluate(const XYZ&) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ&) const
     {
       return XYZ(param(0),param(1),param(2));
     }
 
+  //! Fills the run with the constant value
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ*,XYZ* out,size_t n) const
+    {
+      std::fill(out,out+n,XYZ(param(0),param(1),param(2)));
+    }
+
+  //! Compile to a single constant instruction.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_op(FunctionProgram::OpConstant,input,params(),0,3);
+    }
+
   //! Returns true, obviously.
   /*! One of the few cases this method is overriden; most (all?) other no-argument functions should return false
    */
@@ -0,0 +1,201 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Calibrated function type costs, and implementation of FunctionNode::estimated_cost.
+*/
+
+#include "function_node.h"
+
+namespace
+{
+  //! Cost of a function type.
+  struct FunctionCost
+  {
+    //! Name of the function type.
+    const char* name;
+
+    //! Nanoseconds per evaluation (per iteration for iterative types) for the node's own work.
+    real evaluation;
+
+    //! Number of times each argument is evaluated per evaluation (per iteration for iterative types).
+    real argument_evaluations[6];
+  };
+
+  //! Costs measured by a benchmark run.
+  /*! Generated by "evolvotron_bench --calibrate-costs" (see FunctionProfile::write_costs),
+    which profiles trees built around each function type in turn.
+    Only the relative costs matter much, so there's no need to regenerate this for every machine,
+    but it should be redone when function types are added or their implementations change much.
+   */
+  const FunctionCost function_costs[]=
+    {
+      {"FunctionAccumulateOctaves",15.8,{1.00}},
+      {"FunctionAdd",19.9,{1.00,1.00}},
+      {"FunctionAverageRing",55.1,{1.00}},
+      {"FunctionAverageSamples",13.2,{1.00}},
+      {"FunctionCartesianToSpherical",57.2,{}},
+      {"FunctionChooseFrom2InBorderedHexagonGrid",369.9,{0.27,0.73}},
+      {"FunctionChooseFrom2InCubeMesh",25.9,{0.49,0.51}},
+      {"FunctionChooseFrom2InSquareGrid",20.5,{0.50,0.50}},
+      {"FunctionChooseFrom2InTriangleGrid",37.4,{0.51,0.49}},
+      {"FunctionChooseFrom3InCubeMesh",32.4,{0.44,0.23,0.32}},
+      {"FunctionChooseFrom3InDiamondGrid",45.6,{0.39,0.31,0.31}},
+      {"FunctionChooseFrom3InHexagonGrid",81.3,{0.41,0.29,0.30}},
+      {"FunctionChooseFrom3InSquareGrid",28.7,{0.40,0.29,0.30}},
+      {"FunctionChooseFrom3InTriangleGrid",44.6,{0.34,0.35,0.32}},
+      {"FunctionChooseRect",36.9,{1.00,1.00,0.05,0.95}},
+      {"FunctionChooseSphere",34.3,{1.00,1.00,0.52,0.48}},
+      {"FunctionChooseStrip",27.3,{0.75,0.25,1.00}},
+      {"FunctionChooseStripBlend",48.7,{0.85,0.62,1.00,1.00}},
+      {"FunctionComposePair",12.6,{1.00,1.00}},
+      {"FunctionComposeTriple",13.8,{1.00,1.00,1.00}},
+      {"FunctionCone",2.8,{}},
+      {"FunctionConstant",4.1,{}},
+      {"FunctionConvolveSamples",24.9,{1.00,1.00}},
+      {"FunctionCos",47.0,{}},
+      {"FunctionCross",31.8,{1.00,1.00}},
+      {"FunctionCurl",54.2,{6.00}},
+      {"FunctionDerivative",40.6,{2.00}},
+      {"FunctionDerivativeGeneralised",50.2,{2.00,1.00}},
+      {"FunctionDivergence",57.8,{6.00}},
+      {"FunctionDivide",25.3,{1.00,1.00}},
+      {"FunctionEvaluateInSpherical",127.5,{1.00}},
+      {"FunctionExp",35.0,{}},
+      {"FunctionExpCone",17.9,{}},
+      {"FunctionFDIM",11.1,{}},
+      {"FunctionFMA",9.6,{}},
+      {"FunctionFilter2D",50.1,{5.00}},
+      {"FunctionFilter3D",77.9,{7.00}},
+      {"FunctionFilterRing",54.9,{1.11}},
+      {"FunctionFriezeGroupHopBlendClampZ",53.0,{1.00,1.00}},
+      {"FunctionFriezeGroupHopBlendFreeZ",54.9,{1.00,1.00}},
+      {"FunctionFriezeGroupHopClampZ",23.5,{1.00}},
+      {"FunctionFriezeGroupHopFreeZ",24.2,{1.00}},
+      {"FunctionFriezeGroupJumpBlendClampZ",66.1,{1.00,1.00}},
+      {"FunctionFriezeGroupJumpBlendFreeZ",65.8,{1.00,1.00}},
+      {"FunctionFriezeGroupJumpClampZ",21.3,{1.00}},
+      {"FunctionFriezeGroupJumpFreeZ",25.5,{1.00}},
+      {"FunctionFriezeGroupSidleClampZ",23.2,{1.00}},
+      {"FunctionFriezeGroupSidleFreeZ",22.4,{1.00}},
+      {"FunctionFriezeGroupSpinhopBlendClampZ",43.5,{2.00}},
+      {"FunctionFriezeGroupSpinhopBlendFreeZ",47.4,{2.00}},
+      {"FunctionFriezeGroupSpinhopClampZ",33.5,{1.00}},
+      {"FunctionFriezeGroupSpinhopFreeZ",34.0,{1.00}},
+      {"FunctionFriezeGroupSpinjumpClampZ",21.9,{1.00}},
+      {"FunctionFriezeGroupSpinjumpFreeZ",20.2,{1.00}},
+      {"FunctionFriezeGroupSpinsidleClampZ",28.6,{1.00}},
+      {"FunctionFriezeGroupSpinsidleFreeZ",34.3,{1.00}},
+      {"FunctionFriezeGroupStepClampZ",22.6,{1.00}},
+      {"FunctionFriezeGroupStepFreeZ",22.0,{1.00}},
+      {"FunctionGeometricInversion",17.7,{1.00}},
+      {"FunctionGradient",72.0,{6.00}},
+      {"FunctionGradientGeneralised",74.0,{6.00,1.00}},
+      {"FunctionIdentity",2.4,{}},
+      {"FunctionIsotropicScale",4.3,{}},
+      {"FunctionIterate",12.5,{1.00}},
+      {"FunctionJuliaChoose",2.7,{0.03,0.12}},
+      {"FunctionJuliaContour",1.1,{}},
+      {"FunctionJuliabrotChoose",2.8,{0.00,0.11}},
+      {"FunctionJuliabrotContour",1.7,{}},
+      {"FunctionKaleidoscope",93.3,{1.00}},
+      {"FunctionKaleidoscopeTwist",100.8,{1.00}},
+      {"FunctionKaleidoscopeZRotate",97.4,{1.00}},
+      {"FunctionMagnitude",20.8,{1.00}},
+      {"FunctionMagnitudes",48.1,{1.00,1.00,1.00}},
+      {"FunctionMandelbrotChoose",3.5,{0.07,0.05}},
+      {"FunctionMandelbrotContour",1.8,{}},
+      {"FunctionMax",22.4,{1.00,1.00}},
+      {"FunctionMin",22.8,{1.00,1.00}},
+      {"FunctionModulus",81.8,{1.00,1.00}},
+      {"FunctionMultiply",20.2,{1.00,1.00}},
+      {"FunctionMultiscaleNoiseOneChannel",306.7,{}},
+      {"FunctionMultiscaleNoiseThreeChannel",817.1,{}},
+      {"FunctionNoiseOneChannel",47.4,{}},
+      {"FunctionNoiseThreeChannel",107.6,{}},
+      {"FunctionOrthoSphereReflect",15.0,{0.67,0.33}},
+      {"FunctionOrthoSphereReflectBumpMapped",46.5,{0.67,0.33,1.33}},
+      {"FunctionOrthoSphereShaded",26.4,{0.46,0.54}},
+      {"FunctionOrthoSphereShadedBumpMapped",74.8,{0.43,0.57,2.27}},
+      {"FunctionPixelize",17.2,{}},
+      {"FunctionPixelizeHex",74.5,{}},
+      {"FunctionPostTransform",14.0,{1.00}},
+      {"FunctionPostTransformGeneralised",61.1,{1.00,1.00,1.00,1.00,1.00}},
+      {"FunctionPreTransform",16.9,{1.00}},
+      {"FunctionPreTransformGeneralised",52.3,{1.00,1.00,1.00,1.00,1.00}},
+      {"FunctionReflect",50.1,{1.00,1.00,1.00}},
+      {"FunctionRotate",121.7,{1.00}},
+      {"FunctionScalarLaplacian",77.3,{7.00}},
+      {"FunctionSeparateZ",23.3,{1.00,1.00}},
+      {"FunctionShadow",23.5,{2.00}},
+      {"FunctionShadowGeneralised",22.5,{2.00,1.00}},
+      {"FunctionSin",42.7,{}},
+      {"FunctionSphericalToCartesian",54.5,{}},
+      {"FunctionSpiralLinear",78.9,{1.00}},
+      {"FunctionSpiralLogarithmic",83.8,{1.00}},
+      {"FunctionStreak",16.0,{1.00}},
+      {"FunctionTan",63.9,{}},
+      {"FunctionTartanMixFree",26.6,{1.00,1.00}},
+      {"FunctionTartanMixRepeat",56.0,{1.00,1.00}},
+      {"FunctionTartanSelect",70.5,{1.00,1.00,0.31,0.26,0.28,0.15}},
+      {"FunctionTartanSelectFree",43.6,{1.00,1.00,0.47,0.22,0.17,0.14}},
+      {"FunctionTartanSelectRepeat",66.6,{1.00,1.00,0.19,0.33,0.31,0.17}},
+      {"FunctionTop",62.9,{1.00}},
+      {"FunctionTransform",6.7,{}},
+      {"FunctionTransformGeneralised",55.2,{1.00,1.00,1.00,1.00}},
+      {"FunctionTransformQuadratic",20.9,{}},
+      {"FunctionVoxelize",15.5,{}},
+      {"FunctionWindmill",103.6,{1.00}},
+      {"FunctionWindmillTwist",102.6,{1.00}},
+      {"FunctionWindmillZRotate",106.4,{1.00}}
+    };
+
+  //! Cost used for function types missing from the table.
+  const FunctionCost default_function_cost={"",10.0,{1.0,1.0,1.0,1.0,1.0,1.0}};
+
+  //! Index the table by name.
+  std::map<std::string,const FunctionCost*> function_costs_by_name()
+  {
+    std::map<std::string,const FunctionCost*> ret;
+    for (uint i=0;i<sizeof(function_costs)/sizeof(function_costs[0]);i++)
+      ret[function_costs[i].name]=&function_costs[i];
+    return ret;
+  }
+
+  //! Look up the cost of the named function type.
+  const FunctionCost& function_cost(const char* name)
+  {
+    static const std::map<std::string,const FunctionCost*> costs(function_costs_by_name());
+    const std::map<std::string,const FunctionCost*>::const_iterator it=costs.find(name);
+    return (it==costs.end() ? default_function_cost : *it->second);
+  }
+}
+
+void FunctionNode::update_estimated_cost()
+{
+  const FunctionCost& cost=function_cost(thisname());
+  const uint max_args=sizeof(cost.argument_evaluations)/sizeof(cost.argument_evaluations[0]);
+
+  real ret=cost.evaluation;
+  for (uint i=0;i<args().size();i++)
+    ret+=(i<max_args ? cost.argument_evaluations[i] : 1.0)*arg(i).estimated_cost();
+
+  _estimated_cost=std::max(1u,iterations())*ret;
+}
@@ -28,6 +28,9 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
+
+#include "transform.h"
 
 //------------------------------------------------------------------------------------------
 
@@ -35,11 +38,31 @@
 FUNCTION_BEGIN(FunctionIdentity,0,0,false,FnCore)
 
   //! Simply return the position argument.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return p;
     }
 
+  //! Simply copy the position arguments.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::copy(in,in+n,out);
+    }
+
+  //! Compiles to nothing: the result is the input register.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      program.retain(input);
+      return input;
+    }
+
+  //! The identity transform.
+  virtual bool is_affine(Transform& t) const
+    {
+      t=TransformIdentity();
+      return true;
+    }
+
 FUNCTION_END(FunctionIdentity)
 
 //------------------------------------------------------------------------------------------
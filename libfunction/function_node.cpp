@@ -27,10 +27,13 @@
 #include "function_compose_pair.h"
 #include "function_constant.h"
 #include "function_node_info.h"
+#include "function_program.h"
 #include "function_registry.h"
 #include "margin.h"
 #include "mutation_parameters.h"
 
+#include <cstring>
+
 std::unique_ptr<boost::ptr_vector<FunctionNode> > FunctionNode::cloneargs() const
 {
   std::unique_ptr<boost::ptr_vector<FunctionNode> > ret(new boost::ptr_vector<FunctionNode>());
@@ -142,6 +145,16 @@ bool FunctionNode::is_constant() const
   return true;
 }
 
+bool FunctionNode::needs_double() const
+{
+  if (self_promotes_to_double()) return true;
+  for (boost::ptr_vector<FunctionNode>::const_iterator it=args().begin();it!=args().end();it++)
+    {
+      if ((*it).needs_double()) return true;
+    }
+  return false;
+}
+
 bool FunctionNode::ok() const
 {
   bool good=true;
@@ -199,6 +212,7 @@ FunctionNode::FunctionNode(const std::vector<real>& p,boost::ptr_vector<Function
   :_args(a.release())
    ,_params(p)
    ,_iterations(iter)
+   ,_estimated_cost(0.0)
 {}
 
 /*! Returns null ptr if there's a problem, in which case there will be an explanation in report.
@@ -255,6 +269,7 @@ void FunctionNode::mutate(const MutationParameters& parameters,bool mutate_own_p
 	    {
 	      (*it)+=parameters.effective_magnitude_parameter_variation()*(parameters.r01()<0.5 ? -parameters.rnegexp() : parameters.rnegexp());
 	    }
+	  update_derived();
 	}
     }
 
@@ -285,6 +300,8 @@ void FunctionNode::mutate(const MutationParameters& parameters,bool mutate_own_p
 	  
 	  // For safety but shouldn't happen
 	  if (_iterations==0) _iterations=1;
+
+	  update_derived();
 	}
     }
       
@@ -346,7 +363,7 @@ void FunctionNode::mutate(const MutationParameters& parameters,bool mutate_own_p
 
 	  // Impose the new parameters and arguments on the new node (iterations not touched)
 	  it.args(*a);
-	  it.params()=p;
+	  it.params(p);
 	}
     }
   
@@ -369,6 +386,28 @@ void FunctionNode::mutate(const MutationParameters& parameters,bool mutate_own_p
 	  args().insert(args().begin()+i,new FunctionComposePair(p,a,0));
 	}
     }
+
+  update_estimated_cost();
+}
+
+bool FunctionNode::is_same(const FunctionNode& other) const
+{
+  if (this==&other) return true;
+  if (
+      std::string(thisname())!=other.thisname()
+      || params()!=other.params()
+      || iterations()!=other.iterations()
+      || args().size()!=other.args().size()
+      )
+    return false;
+  for (uint i=0;i<args().size();i++)
+    if (!arg(i).is_same(other.arg(i))) return false;
+  return true;
+}
+
+uint FunctionNode::compile(FunctionProgram& program,uint input) const
+{
+  return program.emit_evaluate(*this,input);
 }
 
 void FunctionNode::simplify_constants() 
@@ -377,22 +416,176 @@ void FunctionNode::simplify_constants()
     {
       if (args()[i].is_constant())
 	{
-	  const XYZ v(args()[i](XYZ(0.0,0.0,0.0)));
-	  std::vector<real> vp;
-	  vp.push_back(v.x());
-	  vp.push_back(v.y());
-	  vp.push_back(v.z());
-	  boost::ptr_vector<FunctionNode> va;
-          std::unique_ptr<FunctionConstant> replacement(new FunctionConstant(vp,va,0));
-	  args().replace(i,replacement.release());
+	  args().replace(i,constant(args()[i](XYZ(0.0,0.0,0.0))).release());
 	}
       else
 	{
 	  args()[i].simplify_constants();
 	}
     }
+
+  update_estimated_cost();
+}
+
+real FunctionNode::octave_weights(uint n)
+{
+  real total=0.0;
+  real w=1.0;
+  for (uint i=0;i<n;i++,w*=0.5)
+    total+=w;
+  return total;
 }
 
+/*! Works bottom up, so by the time a node's optimised() is called its arguments are already in their final form.
+ */
+void FunctionNode::optimise()
+{
+  for (uint i=0;i<args().size();i++)
+    {
+      args()[i].optimise();
+
+      if (args()[i].is_constant() && !args()[i].args().empty())
+	{
+	  args().replace(i,constant(args()[i](XYZ(0.0,0.0,0.0))).release());
+	}
+
+      while (std::unique_ptr<FunctionNode> replacement=args()[i].optimised())
+	{
+	  args().replace(i,replacement.release());
+	}
+    }
+
+  update_estimated_cost();
+}
+
+std::unique_ptr<FunctionNode> FunctionNode::optimised()
+{
+  return std::unique_ptr<FunctionNode>();
+}
+
+std::unique_ptr<FunctionNode> FunctionNode::take_arg(FunctionNode& node,uint n)
+{
+  assert(n<node.args().size());
+  return std::unique_ptr<FunctionNode>(node.args().release(node.args().begin()+n).release());
+}
+
+std::unique_ptr<FunctionNode> FunctionNode::constant(const XYZ& v)
+{
+  std::vector<real> vp;
+  vp.push_back(v.x());
+  vp.push_back(v.y());
+  vp.push_back(v.z());
+  boost::ptr_vector<FunctionNode> va;
+  return std::unique_ptr<FunctionNode>(new FunctionConstant(vp,va,0));
+}
+
+//! The bits of a point, for finding bitwise identical points.
+struct PointBits
+{
+  uint64_t x;
+  uint64_t y;
+  uint64_t z;
+};
+
+//! The bits of a point (single precision points are widened, which is exact).
+template <typename T> static PointBits point_bits(const BasicXYZ<T>& p)
+{
+  const double c[3]={p.x(),p.y(),p.z()};
+  PointBits ret;
+  memcpy(&ret.x,&c[0],sizeof(uint64_t));
+  memcpy(&ret.y,&c[1],sizeof(uint64_t));
+  memcpy(&ret.z,&c[2],sizeof(uint64_t));
+  return ret;
+}
+
+//! Number of evaluate_stencil calls in progress on this thread.
+/*! Stencils only repeat points when nested inside another stencil:
+  the stencils of points further apart than the epsilons don't overlap.
+ */
+static thread_local uint stencil_depth=0;
+
+//! Keeps count of the evaluate_stencil calls in progress.
+class StencilDepth
+{
+public:
+  StencilDepth()
+    {
+      stencil_depth++;
+    }
+  ~StencilDepth()
+    {
+      stencil_depth--;
+    }
+};
+
+/*! Stencils are evaluated in chunks, so the sample points of deeply nested stencils don't outgrow the caches.
+  Repeated points are found with an open addressing hash table of the bits of the points.
+  That costs 10-20ns a point (with the gathering and scattering), so it's only done for nested stencils (the only ones which repeat points)
+  of arguments estimated to cost several times that (point at a time; batches are cheaper).
+ */
+template <typename T> void FunctionNode::evaluate_stencil(uint n,const BasicXYZ<T>* in,BasicXYZ<T>* out,size_t m) const
+{
+  // Points evaluated at a time.
+  const size_t chunk=1024;
+
+  // Estimated cost (nanoseconds per point) above which looking for repeated points pays.
+  const real sharing_cost=100.0;
+
+  const bool share=(stencil_depth>0 && arg(n).estimated_cost()>=sharing_cost);
+  const StencilDepth depth;
+
+  if (!share)
+    {
+      for (size_t i=0;i<m;i+=chunk)
+	arg(n)(in+i,out+i,std::min(chunk,m-i));
+      return;
+    }
+
+  std::vector<uint> table;
+  std::vector<BasicXYZ<T> > unique;
+  std::vector<uint> index;
+  std::vector<BasicXYZ<T> > values;
+  for (size_t i0=0;i0<m;i0+=chunk)
+    {
+      const size_t c=std::min(chunk,m-i0);
+
+      size_t slots=1;
+      while (slots<2*c) slots*=2;
+
+      // Slots hold the index of a unique point plus one, or zero if empty.
+      table.assign(slots,0);
+      unique.clear();
+      index.resize(c);
+      for (size_t i=0;i<c;i++)
+	{
+	  const PointBits b=point_bits(in[i0+i]);
+	  size_t h=((b.x*0x9e3779b97f4a7c15ULL)^(b.y*0xc2b2ae3d27d4eb4fULL)^(b.z*0x165667b19e3779f9ULL))>>32;
+	  for (;;h++)
+	    {
+	      uint& slot=table[h&(slots-1)];
+	      if (slot==0)
+		{
+		  unique.push_back(in[i0+i]);
+		  slot=unique.size();
+		  break;
+		}
+	      const PointBits u=point_bits(unique[slot-1]);
+	      if (u.x==b.x && u.y==b.y && u.z==b.z)
+		break;
+	    }
+	  index[i]=table[h&(slots-1)]-1;
+	}
+
+      values.resize(unique.size());
+      arg(n)(&unique[0],&values[0],unique.size());
+      for (size_t i=0;i<c;i++)
+	out[i0+i]=values[index[i]];
+    }
+}
+
+template void FunctionNode::evaluate_stencil<float>(uint n,const XYZf* in,XYZf* out,size_t m) const;
+template void FunctionNode::evaluate_stencil<double>(uint n,const XYZ* in,XYZ* out,size_t m) const;
+
 std::unique_ptr<boost::ptr_vector<FunctionNode> > FunctionNode::deepclone_args() const
 {
   std::unique_ptr<boost::ptr_vector<FunctionNode> > ret(new boost::ptr_vector<FunctionNode>());
@@ -411,6 +604,21 @@ FunctionTop* FunctionNode::is_a_FunctionTop()
   return 0;
 }
 
+const FunctionPreTransform* FunctionNode::is_a_FunctionPreTransform() const
+{
+  return 0;
+}
+
+const FunctionPostTransform* FunctionNode::is_a_FunctionPostTransform() const
+{
+  return 0;
+}
+
+bool FunctionNode::is_affine(Transform&) const
+{
+  return false;
+}
+
 /*! This function only saves the parameters, iteration count if any and child nodes.
   It is intended to be called from save_function of subclasses which will write a function node wrapper.
   The indent number is just the level of recursion, incrementing by 1 each time.
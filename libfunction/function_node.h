@@ -33,9 +33,12 @@ class FunctionNodeInfo;
 class FunctionTop;
 class FunctionPreTransform;
 class FunctionPostTransform;
+class FunctionProfile;
+class FunctionProgram;
 class FunctionRegistry;
 class MutatableImage;
 class MutationParameters;
+class Transform;
 
 class Function : boost::noncopyable
 {
@@ -44,29 +47,80 @@ class Function : boost::noncopyable
   virtual ~Function()
     {}
 
+  //@{
   //! Convenience wrapper for evaluate (actually, evaluate is protected so can't be called externally anyway)
   const XYZ operator()(const XYZ& p) const
     {
       return evaluate(p);
     }
+  const XYZf operator()(const XYZf& p) const
+    {
+      return evaluate(p);
+    }
+  //@}
 
+  //@{
   //! Weighted evaluate; fastpath for zero weight.
   const XYZ operator()(const real weight,const XYZ& p) const
     {
       return (weight==0.0 ? XYZ(0.0,0.0,0.0) : weight*evaluate(p));
     }
+  const XYZf operator()(const real weight,const XYZf& p) const
+    {
+      return (weight==0.0 ? XYZf(0.0,0.0,0.0) : weight*evaluate(p));
+    }
+  //@}
+
+  //@{
+  //! Convenience wrapper for evaluate_batch.
+  void operator()(const XYZ* in,XYZ* out,size_t n) const
+    {
+      evaluate_batch(in,out,n);
+    }
+  void operator()(const XYZf* in,XYZf* out,size_t n) const
+    {
+      evaluate_batch(in,out,n);
+    }
+  //@}
 
   //! This what distinguishes different types of function.
   virtual const XYZ evaluate(const XYZ&) const
     =0;
+
+  //! Evaluate in single precision.
+  /*! The default evaluates in double and rounds the result.
+   */
+  virtual const XYZf evaluate(const XYZf& p) const
+    {
+      return XYZf(evaluate(XYZ(p)));
+    }
+
+  //! Evaluate a run of n points, so the cost of virtual dispatch is paid once per run rather than once per point.
+  /*! Sets out[i] to evaluate(in[i]).  The in and out arrays must not overlap.
+    The default implementation just loops over evaluate; node types on the hot path override it.
+   */
+  virtual void evaluate_batch(const XYZ* in,XYZ* out,size_t n) const
+    {
+      for (size_t i=0;i<n;i++)
+	out[i]=evaluate(in[i]);
+    }
+
+  //! Evaluate a run of n points in single precision.
+  virtual void evaluate_batch(const XYZf* in,XYZf* out,size_t n) const
+    {
+      for (size_t i=0;i<n;i++)
+	out[i]=evaluate(in[i]);
+    }
 };
 
 //! Abstract base class for all kinds of mutatable image node.
 /*! MutatableImage declared a friend to help constification of the public accessors.
+  FunctionProfile is a friend so it can instrument the arguments of a tree.
  */
 class FunctionNode : public Function
 {
  public:
+  friend class FunctionProfile;
   friend class MutatableImage;
 
  private:
@@ -81,6 +135,9 @@ class FunctionNode : public Function
    */
   uint _iterations;
 
+  //! Cached estimated_cost() of the subtree.
+  real _estimated_cost;
+
  protected:
 
   //! This returns a deep-cloned copy of the node's children.
@@ -106,28 +163,72 @@ class FunctionNode : public Function
 
  public:
 
+  //! Returns true if the subtree is identical to another: same function types, parameters and iteration counts throughout.
+  bool is_same(const FunctionNode& other) const;
+
   //! Returns true if the function is independent of it's position argument.
-  /*! This isn't used for optimisation (which would require FunctionNode to have computation-specific state,
-      which would wreck plans for reference counted deepclone()), 
-      but to cull boring constant images on creation.
-      Default implementation (and probably the only sensible one)
-      is constant if all args are constant; no args returns false.
+  /*! Used to cull boring constant images on creation, and by optimise() to fold constant subtrees.
+      Default implementation is constant if all args are constant; no args returns false.
+      Functions which use the position themselves to choose between, blend or place their arguments
+      (the choosers, frieze blends, fractal set membership, rendered spheres and position transforms)
+      aren't constant even if all their arguments are, so override this to return false.
    */
   virtual bool is_constant() const;
 
   //! Internal self consistency check.
   virtual bool ok() const;
 
+  //! Estimated time to evaluate the subtree at a single point, in nanoseconds.
+  /*! Built from the calibrated cost of each function type's own work and the number of times it evaluates each of its arguments
+    (see function_cost.cpp), so nodes which evaluate their arguments many times
+    (the sample averaging filters, FunctionGradient, FunctionCurl...) multiply the cost of the subtree below them.
+    Both are per iteration for iterative function types.
+    Cached (see update_estimated_cost), as evaluate_stencil looks at its argument's cost at every call.
+   */
+  real estimated_cost() const
+    {
+      return _estimated_cost;
+    }
+
+  //! Sum of the weights 1, 1/2, 1/4... of n octaves, as summed by the multiscale noise functions and FunctionAccumulateOctaves.
+  static real octave_weights(uint n);
+
   //! Bits give some classification of the function type
   virtual uint self_classification() const
     =0;
 
+  //! Whether single precision evaluation of this node is promoted to double (see FunctionBoilerplate::promote_to_double).
+  virtual bool self_promotes_to_double() const
+    =0;
+
+  //! Returns true if any node in the subtree is promoted to double in single precision.
+  /*! Promotion only protects a node's own arithmetic: the points it's given have still been rounded to float,
+    and the same sensitivity (finite difference steps, escape iterations) amplifies that rounding too.
+    So callers choosing the precision for a whole tree should use double for these.
+   */
+  bool needs_double() const;
+
+  //! Accessor providing function name
+  virtual const char* thisname() const
+    =0;
+
   //@{
   //! Query the node as to whether it is a FunctionTop (return null if not).
   virtual const FunctionTop* is_a_FunctionTop() const;
   virtual FunctionTop* is_a_FunctionTop();
   //@}
 
+  //@{
+  //! Query the node as to whether it is a FunctionPreTransform or FunctionPostTransform (return null if not).  Used by the optimiser.
+  virtual const FunctionPreTransform* is_a_FunctionPreTransform() const;
+  virtual const FunctionPostTransform* is_a_FunctionPostTransform() const;
+  //@}
+
+  //! Returns true, setting t, if the function's value is just an affine transform of its position argument.
+  /*! Default implementation returns false; FunctionIdentity and FunctionTransform override it.  Used by the optimiser.
+   */
+  virtual bool is_affine(Transform& t) const;
+
   //! This returns a new random bit of tree.  Setting the "exciting" flag avoids basic node types, but only at the top level of the stub tree.
   static std::unique_ptr<FunctionNode> stub(const MutationParameters& parameters,bool exciting);
 
@@ -155,6 +256,7 @@ class FunctionNode : public Function
   void params(const std::vector<real>& p)
     {
       _params=p;
+      update_derived();
     }
 
   //! Accessor.
@@ -186,6 +288,7 @@ class FunctionNode : public Function
   void args(boost::ptr_vector<FunctionNode>& a)
     {
       _args=a.release();
+      update_estimated_cost();
     }
 
   //! Accessor. 
@@ -202,9 +305,24 @@ class FunctionNode : public Function
   virtual std::unique_ptr<FunctionNode> deepclone() const
     =0;
 
+  //! Append instructions evaluating this node at the points in register input to the program, returning the register holding the result.
+  /*! The default compiles the whole subtree to a single instruction calling back into evaluate_batch;
+    node types with an opcode of their own override this.
+   */
+  virtual uint compile(FunctionProgram& program,uint input) const;
+
   //! Prune any is_constant() nodes and replace them with an actual constant node
   virtual void simplify_constants();
 
+  //! Rewrite the subtree below this node into a cheaper equivalent for evaluation.
+  /*! As well as folding constant subtrees (like simplify_constants),
+    each argument is replaced by its optimised() version for as long as it has one,
+    which collapses chains of affine transforms and drops zero-weight branches.
+    Results only match the original tree up to rounding, and the tree no longer describes the same genome,
+    so this is for evaluation copies only: mutating or saving an optimised tree would change the image.
+   */
+  virtual void optimise();
+
   //! Return a deepcloned copy of the node's arguments
   virtual std::unique_ptr<boost::ptr_vector<FunctionNode> > deepclone_args() const;
   
@@ -224,17 +342,67 @@ class FunctionNode : public Function
     }
 
   //! Accessor (non-const).
+  /*! Callers modifying the parameters through this must call update_derived() afterwards.
+   */
   std::vector<real>& params()
     {
       return _params;
     }
 
+  //! Rebuild any state the node caches from its parameters (and iteration count).
+  /*! Called by the constructor (in FN_CTOR_IMP, so the most derived override runs), after mutate() and by params(p).
+    Node types which would otherwise rebuild something from their parameters at every evaluation
+    (for example FunctionTop's transforms) override this to build it once; the default does nothing.
+    The cached state must never change during evaluation, so nodes remain safe to evaluate from several threads.
+   */
+  virtual void update_derived()
+    {}
+
+  //! Recompute the cached estimated_cost() from the node's type and iteration count and its arguments' (already up to date) costs.
+  /*! Called by the constructor (in FN_CTOR_IMP, as the costs are looked up by thisname()),
+    and whenever the arguments may have changed: by args(a), and at the end of mutate(), simplify_constants() and optimise()
+    (overrides of which changing the arguments afterwards must call it again).
+   */
+  void update_estimated_cost();
+
   //! Accessor. 
   FunctionNode& arg(uint n)
     {
       assert(n<args().size());
       return args()[n];
     }
+
+  //! Return a cheaper node equivalent to this one (given its already optimised arguments), or null if there isn't one.
+  /*! The node is discarded when a replacement is returned, so the replacement may be built from the node's arguments using take_arg.
+    Default implementation returns null.
+   */
+  virtual std::unique_ptr<FunctionNode> optimised();
+
+  //! Remove and return argument n of a node.  For use by optimised(); the node is left with fewer arguments than it should have.
+  static std::unique_ptr<FunctionNode> take_arg(FunctionNode& node,uint n);
+
+  //! Return a constant node with the given value.
+  static std::unique_ptr<FunctionNode> constant(const XYZ& v);
+
+  //! Evaluate argument n at the m sample points of a stencil (such as a finite difference operator's), setting out[i] to arg(n)(in[i]).
+  /*! The whole stencil goes to the argument as a single batch.
+    Nested stencils sample many of the same points (p+dx+dy is also p+dy+dx),
+    so if the argument is expensive enough for it to be worth looking for them, repeated points are only evaluated once.
+    Only bitwise identical points are shared, so the results are exactly those of evaluating every point.
+   */
+  template <typename T> void evaluate_stencil(uint n,const BasicXYZ<T>* in,BasicXYZ<T>* out,size_t m) const;
+
+  //! Set q to the 6 points of a central difference stencil: p-d along x, y and z, then p+d along x, y and z.
+  template <typename T> static void central_stencil(const BasicXYZ<T>& p,T d,BasicXYZ<T>* q)
+    {
+      q[0]=p-BasicXYZ<T>(d,0.0,0.0);
+      q[1]=p-BasicXYZ<T>(0.0,d,0.0);
+      q[2]=p-BasicXYZ<T>(0.0,0.0,d);
+      q[3]=p+BasicXYZ<T>(d,0.0,0.0);
+      q[4]=p+BasicXYZ<T>(0.0,d,0.0);
+      q[5]=p+BasicXYZ<T>(0.0,0.0,d);
+    }
+
  protected:
   //! @{
   //! Useful constants used when some small sampling step is required (e.g gradient operators).
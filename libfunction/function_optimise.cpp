@@ -0,0 +1,115 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Implementation of the optimiser rewrites (FunctionNode::optimised overrides) which build nodes of other function types.
+  These live apart from the function types' own files as those instantiate their boilerplate on inclusion.
+*/
+
+#include "function_compose_pair.h"
+#include "function_identity.h"
+#include "function_post_transform.h"
+#include "function_pre_transform.h"
+#include "function_top.h"
+#include "function_transform.h"
+
+std::unique_ptr<FunctionNode> FunctionTransform::optimised()
+{
+  if (!_transform.is_identity()) return std::unique_ptr<FunctionNode>();
+  boost::ptr_vector<FunctionNode> a;
+  return std::unique_ptr<FunctionNode>(new FunctionIdentity(std::vector<real>(),a,0));
+}
+
+/*! f(T1(p)) where f is A(p) is (A.T1)(p); where f is g(T2(p)) it is g((T2.T1)(p)).
+ */
+std::unique_ptr<FunctionNode> FunctionPreTransform::optimised()
+{
+  if (_transform.is_identity()) return take_arg(*this,0);
+
+  Transform t;
+  if (arg(0).is_affine(t))
+    {
+      return FunctionTransform::from_transform(t.concatenate_on_right(_transform));
+    }
+
+  if (const FunctionPreTransform*const inner=arg(0).is_a_FunctionPreTransform())
+    {
+      t=inner->transform();
+      return from_transform(t.concatenate_on_right(_transform),take_arg(arg(0),0));
+    }
+
+  return std::unique_ptr<FunctionNode>();
+}
+
+/*! T1(f(p)) where f is A(p) is (T1.A)(p); where f is T2(g(p)) it is (T1.T2)(g(p)).
+ */
+std::unique_ptr<FunctionNode> FunctionPostTransform::optimised()
+{
+  if (_transform.is_identity()) return take_arg(*this,0);
+
+  Transform t(_transform);
+  Transform inner;
+  if (arg(0).is_affine(inner))
+    {
+      return FunctionTransform::from_transform(t.concatenate_on_right(inner));
+    }
+
+  if (const FunctionPostTransform*const post=arg(0).is_a_FunctionPostTransform())
+    {
+      return from_transform(t.concatenate_on_right(post->transform()),take_arg(arg(0),0));
+    }
+
+  return std::unique_ptr<FunctionNode>();
+}
+
+std::unique_ptr<FunctionNode> FunctionComposePair::optimised()
+{
+  Transform t;
+  if (arg(0).is_affine(t))
+    return FunctionPreTransform::from_transform(t,take_arg(*this,1));
+  else if (arg(1).is_affine(t))
+    return FunctionPostTransform::from_transform(t,take_arg(*this,0));
+  else
+    return std::unique_ptr<FunctionNode>();
+}
+
+/*! The space transform is applied first, so a transform of the argument's position goes on its left.
+  What's left of an affine argument is then the identity, which costs nothing in a compiled program.
+ */
+void FunctionTop::optimise()
+{
+  FunctionNode::optimise();
+
+  while (const FunctionPreTransform*const pre=arg(0).is_a_FunctionPreTransform())
+    {
+      concatenate_pretransform_on_left(pre->transform());
+      args().replace(0,take_arg(arg(0),0).release());
+    }
+
+  Transform t;
+  if (arg(0).is_affine(t) && !t.is_identity())
+    {
+      concatenate_pretransform_on_left(t);
+      boost::ptr_vector<FunctionNode> a;
+      args().replace(0,new FunctionIdentity(std::vector<real>(),a,0));
+    }
+
+  update_estimated_cost();
+}
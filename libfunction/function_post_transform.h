@@ -30,6 +30,7 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
 
 #include "transform.h"
 
@@ -37,12 +38,63 @@
 FUNCTION_BEGIN(FunctionPostTransform,12,1,false,0)
 
   //! Return the evaluation of arg(0) at the transformed position argument.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
   {
-    const Transform transform(params());
-    return transform.transformed(arg(0)(p));
+    return _transform.transformed(arg(0)(p));
   }
 
+  //! Return the transformed evaluations of arg(0) over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+  {
+    arg(0)(in,out,n);
+    _transform.transformed(out,out,n);
+  }
+
+  //! Compile to the argument followed by a transform instruction.
+  virtual uint compile(FunctionProgram& program,uint input) const
+  {
+    const uint v=program.emit_node(arg(0),input);
+    const uint r=program.emit_op(FunctionProgram::OpTransform,v,params(),0,12);
+    program.release(v);
+    return r;
+  }
+
+  //! Returns this.
+  virtual const FunctionPostTransform* is_a_FunctionPostTransform() const
+  {
+    return this;
+  }
+
+  //! Accessor.
+  const Transform& transform() const
+  {
+    return _transform;
+  }
+
+  //! Create a node transforming the values of fn by t.
+  static std::unique_ptr<FunctionNode> from_transform(const Transform& t,std::unique_ptr<FunctionNode> fn)
+  {
+    boost::ptr_vector<FunctionNode> a;
+    a.push_back(fn.release());
+    return std::unique_ptr<FunctionNode>(new FunctionPostTransform(t.get_columns(),a,0));
+  }
+
+ protected:
+
+  //! Drop an identity transform, apply to an affine argument directly, or merge with a post-transform argument.
+  virtual std::unique_ptr<FunctionNode> optimised();
+
+  //! Rebuild the cached transform from the parameters.
+  virtual void update_derived()
+  {
+    _transform=Transform(params());
+  }
+
+ private:
+
+  //! The transform, built from the parameters.
+  Transform _transform;
+
 FUNCTION_END(FunctionPostTransform)
 
 #endif
@@ -30,6 +30,7 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
 
 #include "transform.h"
 
@@ -37,12 +38,64 @@
 FUNCTION_BEGIN(FunctionPreTransform,12,1,false,0)
 
   //! Return the evaluation of arg(0) at the transformed position argument.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
   {
-    const Transform transform(params());
-    return arg(0)(transform.transformed(p));
+    return arg(0)(_transform.transformed(p));
   }
 
+  //! Return the evaluation of arg(0) at the transformed positions of a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+  {
+    std::vector<XYZ> tp(n);
+    _transform.transformed(in,&tp[0],n);
+    arg(0)(&tp[0],out,n);
+  }
+
+  //! Compile to a transform instruction feeding the argument.
+  virtual uint compile(FunctionProgram& program,uint input) const
+  {
+    const uint tp=program.emit_op(FunctionProgram::OpTransform,input,params(),0,12);
+    const uint r=program.emit_node(arg(0),tp);
+    program.release(tp);
+    return r;
+  }
+
+  //! Returns this.
+  virtual const FunctionPreTransform* is_a_FunctionPreTransform() const
+  {
+    return this;
+  }
+
+  //! Accessor.
+  const Transform& transform() const
+  {
+    return _transform;
+  }
+
+  //! Create a node evaluating fn at positions transformed by t.
+  static std::unique_ptr<FunctionNode> from_transform(const Transform& t,std::unique_ptr<FunctionNode> fn)
+  {
+    boost::ptr_vector<FunctionNode> a;
+    a.push_back(fn.release());
+    return std::unique_ptr<FunctionNode>(new FunctionPreTransform(t.get_columns(),a,0));
+  }
+
+ protected:
+
+  //! Drop an identity transform, apply an affine argument directly, or merge with a pre-transform argument.
+  virtual std::unique_ptr<FunctionNode> optimised();
+
+  //! Rebuild the cached transform from the parameters.
+  virtual void update_derived()
+  {
+    _transform=Transform(params());
+  }
+
+ private:
+
+  //! The transform, built from the parameters.
+  Transform _transform;
+
 FUNCTION_END(FunctionPreTransform)
 
 #endif
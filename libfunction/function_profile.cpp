@@ -0,0 +1,323 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Implementation of class FunctionProfile.
+*/
+
+#include "function_profile.h"
+
+#include "function_node.h"
+
+namespace
+{
+  //! Node wrapping another to record the calls made to it.
+  /*! Not a registered function type; only ever found in FunctionProfile's instrumented trees.
+   */
+  class FunctionProfileProbe : public FunctionNode
+  {
+  public:
+
+    //! Constructor.  The single argument is the node to be wrapped.
+    FunctionProfileProbe(boost::ptr_vector<FunctionNode>& a,FunctionProfile::Record& record)
+      :FunctionNode(std::vector<real>(),a,0)
+      ,_record(&record)
+      {
+	update_estimated_cost();
+      }
+
+    virtual const XYZ evaluate(const XYZ& p) const
+      {
+	const FunctionProfile::Clock::time_point t0=FunctionProfile::Clock::now();
+	const XYZ v(arg(0)(p));
+	_record->add(FunctionProfile::Clock::now()-t0,1);
+	return v;
+      }
+
+    virtual void evaluate_batch(const XYZ* in,XYZ* out,size_t n) const
+      {
+	const FunctionProfile::Clock::time_point t0=FunctionProfile::Clock::now();
+	arg(0)(in,out,n);
+	_record->add(FunctionProfile::Clock::now()-t0,n);
+      }
+
+    virtual uint self_classification() const
+      {
+	return arg(0).self_classification();
+      }
+
+    virtual bool self_promotes_to_double() const
+      {
+	return arg(0).self_promotes_to_double();
+      }
+
+    virtual const char* thisname() const
+      {
+	return "FunctionProfileProbe";
+      }
+
+    //! Clones the wrapped node, without instrumentation.
+    virtual std::unique_ptr<FunctionNode> deepclone() const
+      {
+	return arg(0).deepclone();
+      }
+
+    //! Saves the wrapped node.
+    virtual std::ostream& save_function(std::ostream& out,uint indent) const
+      {
+	return arg(0).save_function(out,indent);
+      }
+
+  private:
+
+    //! Where the counts go.
+    FunctionProfile::Record*const _record;
+  };
+}
+
+FunctionProfile::FunctionProfile(const FunctionNode& root)
+{
+  // Measure the probes' overhead by profiling a constant, which does next to nothing itself.
+  {
+    std::unique_ptr<FunctionNode> fn(FunctionNode::constant(XYZ(0.0,0.0,0.0)));
+    Record parent_record(*fn,0,0);
+    Record record(*fn,&parent_record,0);
+    boost::ptr_vector<FunctionNode> a;
+    a.push_back(fn.release());
+    const FunctionProfileProbe probe(a,record);
+
+    const uint calibration_calls=10000;
+    const XYZ p(0.0,0.0,0.0);
+    const Clock::time_point t0=Clock::now();
+    for (uint i=0;i<calibration_calls;i++)
+      probe(p);
+    const Clock::duration t=Clock::now()-t0;
+
+    _inner_overhead=record.inclusive/calibration_calls;
+    _outer_overhead=(t-record.inclusive)/calibration_calls;
+  }
+
+  std::unique_ptr<FunctionNode> fn(root.deepclone());
+  Record* record=new Record(*fn,0,0);
+  _records.push_back(record);
+  instrument(*fn,*record);
+
+  boost::ptr_vector<FunctionNode> a;
+  a.push_back(fn.release());
+  _root=std::unique_ptr<FunctionNode>(new FunctionProfileProbe(a,*record));
+}
+
+FunctionProfile::~FunctionProfile()
+{}
+
+FunctionProfile::Calibration::Calibration()
+  :evaluations(0)
+  ,exclusive(Clock::duration::zero())
+{}
+
+FunctionProfile::Record::Record(const FunctionNode& node,Record* p,uint a)
+  :name(node.thisname())
+  ,stack(p ? p->stack+";"+name : std::string(name))
+  ,parent(p)
+  ,argument(a)
+  ,iterations(node.iterations())
+  ,calls(0)
+  ,points(0)
+  ,inclusive(Clock::duration::zero())
+  ,children(Clock::duration::zero())
+  ,child_calls(0)
+{}
+
+void FunctionProfile::instrument(FunctionNode& node,Record& record)
+{
+  for (uint i=0;i<node.args().size();i++)
+    {
+      std::unique_ptr<FunctionNode> fn(FunctionNode::take_arg(node,i));
+      Record* arg_record=new Record(*fn,&record,i);
+      _records.push_back(arg_record);
+      instrument(*fn,*arg_record);
+
+      boost::ptr_vector<FunctionNode> a;
+      a.push_back(fn.release());
+      node.args().insert(node.args().begin()+i,new FunctionProfileProbe(a,*arg_record));
+    }
+
+  node.update_estimated_cost();
+}
+
+void FunctionProfile::evaluate_batch(const XYZ* in,XYZ* out,size_t n)
+{
+  (*_root)(in,out,n);
+}
+
+FunctionProfile::Clock::duration FunctionProfile::exclusive(const Record& record) const
+{
+  const Clock::duration t
+    =record.inclusive
+    -record.children
+    -static_cast<Clock::rep>(record.calls)*_inner_overhead
+    -static_cast<Clock::rep>(record.child_calls)*_outer_overhead;
+  return std::max(t,Clock::duration::zero());
+}
+
+namespace
+{
+  //! Totals for a function type.
+  struct FunctionProfileTotal
+  {
+    FunctionProfileTotal()
+      :nodes(0)
+      ,calls(0)
+      ,points(0)
+      ,inclusive(FunctionProfile::Clock::duration::zero())
+      ,exclusive(FunctionProfile::Clock::duration::zero())
+      {}
+
+    std::string name;
+    uint nodes;
+    unsigned long long calls;
+    unsigned long long points;
+    FunctionProfile::Clock::duration inclusive;
+    FunctionProfile::Clock::duration exclusive;
+  };
+
+  //! Order totals by decreasing exclusive time.
+  bool more_exclusive(const FunctionProfileTotal& a,const FunctionProfileTotal& b)
+  {
+    return (a.exclusive==b.exclusive ? a.name<b.name : a.exclusive>b.exclusive);
+  }
+
+  //! Milliseconds in a duration.
+  double milliseconds(FunctionProfile::Clock::duration t)
+  {
+    return std::chrono::duration<double,std::milli>(t).count();
+  }
+}
+
+std::ostream& FunctionProfile::report(std::ostream& out) const
+{
+  std::map<std::string,FunctionProfileTotal> totals;
+  Clock::duration total_exclusive=Clock::duration::zero();
+  for (boost::ptr_vector<Record>::const_iterator it=_records.begin();it!=_records.end();it++)
+    {
+      FunctionProfileTotal& total=totals[it->name];
+      total.name=it->name;
+      total.nodes++;
+      total.calls+=it->calls;
+      total.points+=it->points;
+      total.exclusive+=exclusive(*it);
+      total_exclusive+=exclusive(*it);
+
+      // Only count the outermost of nested nodes of the same type towards its inclusive time.
+      bool nested=false;
+      for (const Record* r=it->parent;r && !nested;r=r->parent)
+	nested=(std::string(r->name)==it->name);
+      if (!nested) total.inclusive+=it->inclusive;
+    }
+
+  std::vector<FunctionProfileTotal> sorted;
+  for (std::map<std::string,FunctionProfileTotal>::const_iterator it=totals.begin();it!=totals.end();it++)
+    sorted.push_back(it->second);
+  std::sort(sorted.begin(),sorted.end(),more_exclusive);
+
+  const std::ios::fmtflags flags=out.flags();
+  const std::streamsize precision=out.precision();
+  out
+    << std::left << std::setw(36) << "Function" << std::right
+    << std::setw(7) << "Nodes"
+    << std::setw(12) << "Calls"
+    << std::setw(14) << "Points"
+    << std::setw(14) << "Inclusive ms"
+    << std::setw(14) << "Exclusive ms"
+    << std::setw(8) << "%"
+    << std::setw(12) << "ns/point"
+    << "\n";
+  out << std::fixed;
+  for (std::vector<FunctionProfileTotal>::const_iterator it=sorted.begin();it!=sorted.end();it++)
+    {
+      out
+	<< std::left << std::setw(36) << it->name << std::right
+	<< std::setw(7) << it->nodes
+	<< std::setw(12) << it->calls
+	<< std::setw(14) << it->points
+	<< std::setw(14) << std::setprecision(3) << milliseconds(it->inclusive)
+	<< std::setw(14) << std::setprecision(3) << milliseconds(it->exclusive)
+	<< std::setw(8) << std::setprecision(1) << (total_exclusive==Clock::duration::zero() ? 0.0 : 100.0*milliseconds(it->exclusive)/milliseconds(total_exclusive))
+	<< std::setw(12) << std::setprecision(1) << (it->points ? 1e6*milliseconds(it->exclusive)/it->points : 0.0)
+	<< "\n";
+    }
+  out.flags(flags);
+  out.precision(precision);
+  return out;
+}
+
+std::ostream& FunctionProfile::collapsed_stacks(std::ostream& out) const
+{
+  std::map<std::string,Clock::duration> stacks;
+  for (boost::ptr_vector<Record>::const_iterator it=_records.begin();it!=_records.end();it++)
+    {
+      std::map<std::string,Clock::duration>::iterator s=stacks.find(it->stack);
+      if (s==stacks.end()) stacks[it->stack]=exclusive(*it);
+      else s->second+=exclusive(*it);
+    }
+
+  for (std::map<std::string,Clock::duration>::const_iterator it=stacks.begin();it!=stacks.end();it++)
+    out << it->first << " " << std::chrono::duration_cast<std::chrono::nanoseconds>(it->second).count() << "\n";
+  return out;
+}
+
+void FunctionProfile::calibrate(Calibrations& calibrations) const
+{
+  for (boost::ptr_vector<Record>::const_iterator it=_records.begin();it!=_records.end();it++)
+    {
+      Calibration& calibration=calibrations[it->name];
+      calibration.evaluations+=it->points*std::max(1u,it->iterations);
+      calibration.exclusive+=exclusive(*it);
+
+      if (it->parent)
+	{
+	  std::vector<unsigned long long>& argument_points=calibrations[it->parent->name].argument_points;
+	  if (argument_points.size()<=it->argument) argument_points.resize(it->argument+1,0);
+	  argument_points[it->argument]+=it->points;
+	}
+    }
+}
+
+std::ostream& FunctionProfile::write_costs(std::ostream& out,const Calibrations& calibrations)
+{
+  for (Calibrations::const_iterator it=calibrations.begin();it!=calibrations.end();it++)
+    {
+      const Calibration& calibration=it->second;
+      if (calibration.evaluations==0) continue;
+
+      std::ostringstream line;
+      line
+	<< "      {\"" << it->first << "\","
+	<< std::fixed << std::setprecision(1)
+	<< std::chrono::duration<double,std::nano>(calibration.exclusive).count()/calibration.evaluations
+	<< ",{";
+      line << std::setprecision(2);
+      for (uint i=0;i<calibration.argument_points.size();i++)
+	line << (i ? "," : "") << static_cast<double>(calibration.argument_points[i])/calibration.evaluations;
+      line << "}},";
+      out << line.str() << "\n";
+    }
+  return out;
+}
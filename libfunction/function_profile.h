@@ -0,0 +1,172 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file 
+  \brief Interface for class FunctionProfile.
+*/
+
+#ifndef _function_profile_h_
+#define _function_profile_h_
+
+#include <chrono>
+
+#include "useful.h"
+
+#include "xyz.h"
+
+class FunctionNode;
+
+//! Per-node evaluation profile of a function tree.
+/*! The profile instruments its own copy of the tree, wrapping every node in a probe
+  which counts calls and points evaluated and times each call with std::chrono::steady_clock.
+  Normal evaluation never goes near any of this, so profiling costs nothing unless it's being done.
+
+  Inclusive time is the time spent in a node and everything below it;
+  exclusive time has the time of the node's children and the probes' own overhead (measured when the profile is created) taken off.
+  The overhead can't be removed exactly, so costs of cheap nodes called a point at a time (rather than through evaluate_batch) are only rough.
+  Times are for evaluate/evaluate_batch of the tree rather than the compiled FunctionProgram,
+  which shares the costs of built-in operations differently but evaluates the expensive node types the same way.
+
+  Not thread safe: the counters are plain integers, so only evaluate from one thread at a time.
+ */
+class FunctionProfile : boost::noncopyable
+{
+ public:
+
+  typedef std::chrono::steady_clock Clock;
+
+  //! Counters for a single node of the tree.
+  struct Record
+  {
+    //! Constructor, for a node which is the given argument of its parent.
+    Record(const FunctionNode& node,Record* parent,uint argument);
+
+    //! Function type name.
+    const char* name;
+
+    //! Function type names from the root down to this node, separated by ';'.
+    std::string stack;
+
+    //! Record of the node's parent (null for the root).
+    Record* parent;
+
+    //! Which of its parent's arguments the node is.
+    uint argument;
+
+    //! The node's iteration count (zero for non-iterative function types).
+    uint iterations;
+
+    //! Number of evaluate or evaluate_batch calls.
+    unsigned long long calls;
+
+    //! Number of points evaluated.
+    unsigned long long points;
+
+    //! Time spent in the node, including its children.
+    Clock::duration inclusive;
+
+    //! Time spent in the node's children.
+    Clock::duration children;
+
+    //! Number of calls made to the node's children.
+    unsigned long long child_calls;
+
+    //! Add a call evaluating n points which took time t.
+    void add(Clock::duration t,size_t n)
+    {
+      calls++;
+      points+=n;
+      inclusive+=t;
+      if (parent)
+	{
+	  parent->children+=t;
+	  parent->child_calls++;
+	}
+    }
+  };
+
+  //! Totals for a function type, for calibrating FunctionNode::estimated_cost.
+  struct Calibration
+  {
+    //! Constructor.
+    Calibration();
+
+    //! Number of evaluations (for iterative function types, iterations) of nodes of the type.
+    unsigned long long evaluations;
+
+    //! Exclusive time of nodes of the type.
+    Clock::duration exclusive;
+
+    //! Number of points each argument was evaluated at.
+    std::vector<unsigned long long> argument_points;
+  };
+
+  //! Calibration totals by function type name.
+  typedef std::map<std::string,Calibration> Calibrations;
+
+  //! Instrument a copy of the tree rooted at root.
+  FunctionProfile(const FunctionNode& root);
+
+  //! Destructor.
+  ~FunctionProfile();
+
+  //! Evaluate the instrumented tree (giving the same results as the original) at n points, accumulating the profile.
+  void evaluate_batch(const XYZ* in,XYZ* out,size_t n);
+
+  //! Time spent in a node, excluding its children and timing overhead.
+  Clock::duration exclusive(const Record& record) const;
+
+  //! Write a table of the costs per function type, most expensive (by exclusive time) first.
+  /*! Inclusive times of a type don't count nodes nested inside a node of the same type twice.
+   */
+  std::ostream& report(std::ostream& out) const;
+
+  //! Write the exclusive time in nanoseconds of each distinct stack of function types, one per line.
+  /*! This is the "collapsed stack" format read by flamegraph.pl.
+   */
+  std::ostream& collapsed_stacks(std::ostream& out) const;
+
+  //! Add the profile's totals to calibrations.
+  void calibrate(Calibrations& calibrations) const;
+
+  //! Write the cost of each function type (per evaluation or iteration) and the number of times it evaluates each argument,
+  /*! in the form of the table in function_cost.cpp.
+   */
+  static std::ostream& write_costs(std::ostream& out,const Calibrations& calibrations);
+
+ protected:
+
+  //! Wrap every argument of node (whose record is given) in a probe, recursively.
+  void instrument(FunctionNode& node,Record& record);
+
+  //! Counters for every node, root first.
+  boost::ptr_vector<Record> _records;
+
+  //! The instrumented tree.
+  std::unique_ptr<FunctionNode> _root;
+
+  //! Overhead included in a node's inclusive time for each call to it.
+  Clock::duration _inner_overhead;
+
+  //! Overhead included in a node's exclusive time for each call it makes to a child.
+  Clock::duration _outer_overhead;
+};
+
+#endif
@@ -0,0 +1,305 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Implementation of class FunctionProgram.
+*/
+
+#include "function_program.h"
+
+#include "function_node.h"
+
+namespace
+{
+  //! Mix v into hash h.
+  void hash_combine(size_t& h,size_t v)
+  {
+    h^=v+0x9e3779b9+(h<<6)+(h>>2);
+  }
+
+  //! Fill in the structural hash of every node in the subtree, returning the root's.
+  /*! Consistent with FunctionNode::is_same: identical subtrees have identical hashes.
+   */
+  size_t structural_hash(const FunctionNode& node,std::map<const FunctionNode*,size_t>& hashes)
+  {
+    size_t h=std::hash<std::string>()(node.thisname());
+    hash_combine(h,node.iterations());
+    for (std::vector<real>::const_iterator it=node.params().begin();it!=node.params().end();it++)
+      hash_combine(h,std::hash<real>()(*it));
+    for (boost::ptr_vector<FunctionNode>::const_iterator it=node.args().begin();it!=node.args().end();it++)
+      hash_combine(h,structural_hash(*it,hashes));
+    hashes[&node]=h;
+    return h;
+  }
+}
+
+FunctionProgram::FunctionProgram(const SimdKernels& kernels)
+  :_kernels(&kernels)
+  ,_result(0)
+  ,_references(1,1)
+  ,_generations(1,0)
+  ,_shared(0)
+{}
+
+FunctionProgram::~FunctionProgram()
+{}
+
+std::unique_ptr<FunctionProgram> FunctionProgram::compile(const FunctionNode& root,const SimdKernels& kernels)
+{
+  std::unique_ptr<FunctionProgram> program(new FunctionProgram(kernels));
+  structural_hash(root,program->_hashes);
+  program->_result=program->emit_node(root,0);
+  program->_computed.clear();
+  program->_hashes.clear();
+  return program;
+}
+
+uint FunctionProgram::allocate()
+{
+  for (uint r=1;r<_references.size();r++)
+    {
+      if (_references[r]==0)
+	{
+	  _references[r]=1;
+	  _generations[r]++;
+	  return r;
+	}
+    }
+  _references.push_back(1);
+  _generations.push_back(0);
+  return _references.size()-1;
+}
+
+void FunctionProgram::retain(uint r)
+{
+  assert(r<_references.size());
+  _references[r]++;
+}
+
+void FunctionProgram::release(uint r)
+{
+  assert(r<_references.size() && _references[r]>0);
+  // The input register is never recycled.
+  if (r!=0) _references[r]--;
+}
+
+FunctionProgram::Instruction& FunctionProgram::append(Opcode op,uint src0,uint src1)
+{
+  Instruction instruction;
+  instruction.opcode=op;
+  instruction.dst=allocate();
+  instruction.src0=src0;
+  instruction.src1=src1;
+  instruction.node=0;
+  std::fill(instruction.k,instruction.k+12,0.0);
+  _code.push_back(instruction);
+  return _code.back();
+}
+
+/*! If an identical subtree has already been compiled at the same input, and neither register has been reused since,
+  the earlier result is returned (with a new reference) instead.
+ */
+uint FunctionProgram::emit_node(const FunctionNode& node,uint src0)
+{
+  assert(_hashes.find(&node)!=_hashes.end());
+  const size_t hash=_hashes[&node];
+
+  const std::pair<std::multimap<size_t,Computed>::const_iterator,std::multimap<size_t,Computed>::const_iterator> candidates=_computed.equal_range(hash);
+  for (std::multimap<size_t,Computed>::const_iterator it=candidates.first;it!=candidates.second;it++)
+    {
+      const Computed& c=it->second;
+      if (
+	  c.src0==src0
+	  && c.src0_generation==_generations[src0]
+	  && c.result_generation==_generations[c.result]
+	  && c.node->is_same(node)
+	  )
+	{
+	  _shared++;
+	  retain(c.result);
+	  return c.result;
+	}
+    }
+
+  const uint r=node.compile(*this,src0);
+
+  Computed c;
+  c.node=&node;
+  c.src0=src0;
+  c.src0_generation=_generations[src0];
+  c.result=r;
+  c.result_generation=_generations[r];
+  _computed.insert(std::make_pair(hash,c));
+
+  return r;
+}
+
+uint FunctionProgram::emit_op(Opcode op,uint src0,uint src1)
+{
+  return append(op,src0,src1).dst;
+}
+
+uint FunctionProgram::emit_op(Opcode op,uint src0,const std::vector<real>& k,uint first,uint count)
+{
+  assert(count<=12 && first+count<=k.size());
+  Instruction& instruction=append(op,src0,0);
+  std::copy(k.begin()+first,k.begin()+first+count,instruction.k);
+  return instruction.dst;
+}
+
+uint FunctionProgram::emit_evaluate(const FunctionNode& node,uint src0)
+{
+  Instruction& instruction=append(OpEvaluate,src0,0);
+  instruction.node=&node;
+  return instruction.dst;
+}
+
+/*! Compiles both of the node's arguments at src0 and combines them with op.
+ */
+uint FunctionProgram::emit_binary(Opcode op,const FunctionNode& node,uint src0)
+{
+  assert(node.args().size()==2);
+  const uint a=emit_node(node.arg(0),src0);
+  const uint b=emit_node(node.arg(1),src0);
+  const uint r=emit_op(op,a,b);
+  release(a);
+  release(b);
+  return r;
+}
+
+FunctionProgram::Registers::Registers()
+{}
+
+FunctionProgram::Registers::~Registers()
+{}
+
+/*! The program itself is never written to, so it can be shared between threads each with their own registers.
+  The kernels are run over the registers' padding too, which saves handling a remainder.
+  OpEvaluate instructions convert their source and result to and from the array-of-structures layout evaluate_batch uses.
+ */
+template <typename T> void FunctionProgram::execute(const BasicXYZBlock<T>& in,BasicXYZBlock<T>& out,Registers& registers) const
+{
+  const size_t n=in.size();
+  if (n==0 || _result==0)
+    {
+      out=in;
+      return;
+    }
+
+  Registers::Bank<T>& bank=registers.bank<T>();
+  std::vector<BasicXYZBlock<T> >& reg=bank.blocks;
+  if (reg.size()<_references.size())
+    reg.resize(_references.size());
+  for (uint r=1;r<_references.size();r++)
+    reg[r].resize(n);
+
+  const SimdKernels::Table<T>& kernels=_kernels->table<T>();
+
+  const size_t stride=in.stride();
+  const size_t m=3*stride;
+
+  for (std::vector<Instruction>::const_iterator it=_code.begin();it!=_code.end();it++)
+    {
+      const Instruction& instruction=(*it);
+      const BasicXYZBlock<T>& src0=(instruction.src0==0 ? in : reg[instruction.src0]);
+      const BasicXYZBlock<T>& src1=(instruction.src1==0 ? in : reg[instruction.src1]);
+      BasicXYZBlock<T>& dst=reg[instruction.dst];
+      T*const d=dst.data();
+      const T*const a=src0.data();
+      const T*const b=src1.data();
+
+      switch (instruction.opcode)
+	{
+	case OpEvaluate:
+	  bank.evaluate_in.resize(n);
+	  bank.evaluate_out.resize(n);
+	  src0.copy_to(&bank.evaluate_in[0]);
+	  instruction.node->evaluate_batch(&bank.evaluate_in[0],&bank.evaluate_out[0],n);
+	  for (size_t i=0;i<n;i++)
+	    dst.set(i,bank.evaluate_out[i]);
+	  break;
+	case OpConstant:
+	  dst.fill(BasicXYZ<T>(instruction.k[0],instruction.k[1],instruction.k[2]));
+	  break;
+	case OpTransform:
+	  {
+	    T k[12];
+	    std::copy(instruction.k,instruction.k+12,k);
+	    kernels.transform(k,a,d,stride);
+	  }
+	  break;
+	case OpCone:
+	  kernels.cone(a,d,stride);
+	  break;
+	case OpTanhHalf:
+	  for (size_t i=0;i<m;i++)
+	    d[i]=tanh(T(0.5)*a[i]);
+	  break;
+	case OpAdd:
+	  kernels.add(a,b,d,m);
+	  break;
+	case OpMultiply:
+	  kernels.multiply(a,b,d,m);
+	  break;
+	case OpDivide:
+	  kernels.divide(a,b,d,m);
+	  break;
+	case OpMax:
+	  kernels.maximum(a,b,d,m);
+	  break;
+	case OpMin:
+	  kernels.minimum(a,b,d,m);
+	  break;
+	case OpModulus:
+	  for (size_t i=0;i<m;i++)
+	    d[i]=modulusf(a[i],fabs(b[i]));
+	  break;
+	case OpExp:
+	  kernels.exp(a,d,m);
+	  break;
+	case OpSin:
+	  kernels.sin(a,d,m);
+	  break;
+	case OpCos:
+	  kernels.cos(a,d,m);
+	  break;
+	case OpTan:
+	  for (size_t i=0;i<m;i++)
+	    d[i]=tan(a[i]);
+	  break;
+	}
+    }
+
+  // Swapping hands the caller's old block to the registers, so neither side reallocates once both have grown to suit.
+  out.swap(reg[_result]);
+}
+
+template <typename T> void FunctionProgram::execute(const BasicXYZ<T>* in,BasicXYZ<T>* out,size_t n) const
+{
+  Registers registers;
+  BasicXYZBlock<T> result;
+  execute(BasicXYZBlock<T>(in,n),result,registers);
+  result.copy_to(out);
+}
+
+template void FunctionProgram::execute<float>(const XYZfBlock& in,XYZfBlock& out,Registers& registers) const;
+template void FunctionProgram::execute<double>(const XYZBlock& in,XYZBlock& out,Registers& registers) const;
+template void FunctionProgram::execute<float>(const XYZf* in,XYZf* out,size_t n) const;
+template void FunctionProgram::execute<double>(const XYZ* in,XYZ* out,size_t n) const;
@@ -0,0 +1,243 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file 
+  \brief Interface for class FunctionProgram.
+*/
+
+#ifndef _function_program_h_
+#define _function_program_h_
+
+#include "useful.h"
+
+#include "xyz.h"
+
+#include "simd_kernels.h"
+
+class FunctionNode;
+
+//! A function tree lowered to a flat sequence of register machine instructions.
+/*! Every register holds a whole batch of points, so instruction dispatch is paid once per batch,
+  and the parameters each instruction needs are inlined into the instruction itself
+  so the whole program is one contiguous array.
+  Registers are XYZBlocks, so the built-in operations can run on the SimdKernels chosen for the CPU.
+  Register 0 is the caller's block of input points and is never written.
+
+  Node types without an opcode of their own compile to a single OpEvaluate instruction
+  which calls back into evaluate_batch for that subtree.
+
+  Identical subtrees (see FunctionNode::is_same) compiled at the same input register are only computed once:
+  the program is really a DAG, sharing common subexpressions between their uses.
+  Mutation seldom duplicates subtrees, so this mostly pays off for hand edited or imported functions;
+  MutatableImage logs how often it fires.
+  The program therefore refers to (but doesn't own) nodes of the tree it was compiled from:
+  the tree must outlive the program and must not be mutated.
+ */
+class FunctionProgram : boost::noncopyable
+{
+ public:
+
+  //! Instruction opcodes.
+  /*! Unless noted, operations are componentwise on the source registers.
+   */
+  enum Opcode
+    {
+      OpEvaluate,  //!< dst=node->evaluate_batch(src0)
+      OpConstant,  //!< dst=(k[0],k[1],k[2])
+      OpTransform, //!< dst=src0 transformed by the 12 column-wise transform components in k
+      OpCone,      //!< dst=(src0.x*src0.z,src0.y*src0.z,src0.z)
+      OpTanhHalf,  //!< dst=tanh(0.5*src0)
+      OpAdd,       //!< dst=src0+src1
+      OpMultiply,  //!< dst=src0*src1
+      OpDivide,    //!< dst=src0/src1 (0 where src1 is 0)
+      OpMax,       //!< dst=max(src0,src1)
+      OpMin,       //!< dst=min(src0,src1)
+      OpModulus,   //!< dst=src0 modulus |src1|
+      OpExp,       //!< dst=exp(src0)
+      OpSin,       //!< dst=sin(src0)
+      OpCos,       //!< dst=cos(src0)
+      OpTan        //!< dst=tan(src0)
+    };
+
+  //! A single instruction.
+  struct Instruction
+  {
+    Opcode opcode;
+    uint dst;
+    uint src0;
+    uint src1;
+
+    //! Node to be called for OpEvaluate.
+    const FunctionNode* node;
+
+    //! Inlined constant parameters.
+    real k[12];
+  };
+
+  //! Scratch space for execute: the registers other than the input, and the buffers OpEvaluate converts through.
+  /*! Owned by the caller (typically one per thread) so running a batch allocates nothing once it has grown to suit.
+    It can be passed to any program, but only used by one thread at a time.
+   */
+  class Registers : boost::noncopyable
+  {
+  public:
+    //! Constructor.  Registers are allocated by the first execute using them.
+    Registers();
+
+    //! Destructor.
+    ~Registers();
+
+  private:
+    friend class FunctionProgram;
+
+    //! The scratch space for running in one scalar type.
+    template <typename T> struct Bank
+    {
+      //! Register blocks, indexed by register number (element 0 is unused: the input is read in place).
+      std::vector<BasicXYZBlock<T> > blocks;
+
+      //@{
+      //! Array-of-structures copies of OpEvaluate's source and result.
+      std::vector<BasicXYZ<T> > evaluate_in;
+      std::vector<BasicXYZ<T> > evaluate_out;
+      //@}
+    };
+
+    //! Scratch space for double precision.
+    Bank<double> _double_bank;
+
+    //! Scratch space for single precision.
+    Bank<float> _float_bank;
+
+    //! The scratch space for scalar type T.
+    template <typename T> Bank<T>& bank();
+  };
+
+  //! Compile a function tree, to be run with the given kernels.
+  static std::unique_ptr<FunctionProgram> compile(const FunctionNode& root,const SimdKernels& kernels=SimdKernels::best());
+
+  //! Destructor.
+  ~FunctionProgram();
+
+  //! Run the program over a block of points, setting out to the root node's values at them.
+  /*! Instantiated for float and double.
+    In single precision, OpEvaluate calls the float evaluate_batch, so nodes which need it still promote themselves to double.
+   */
+  template <typename T> void execute(const BasicXYZBlock<T>& in,BasicXYZBlock<T>& out,Registers& registers) const;
+
+  //! Run the program over n points, setting out[i] to the root node's value at in[i].
+  /*! Allocates its own registers, so for occasional use only.
+   */
+  template <typename T> void execute(const BasicXYZ<T>* in,BasicXYZ<T>* out,size_t n) const;
+
+  //! Number of instructions.
+  uint size() const
+    {
+      return _code.size();
+    }
+
+  //! Number of registers needed (including the input register).
+  uint registers() const
+    {
+      return _references.size();
+    }
+
+  //! Number of subtrees which reused the result of an identical subtree instead of being compiled again.
+  uint shared() const
+    {
+      return _shared;
+    }
+
+  //@{
+  //! Compiler interface, for use by FunctionNode::compile implementations.
+  /*! Registers returned by the emit methods (and by FunctionNode::compile) carry a reference owned by the caller,
+    which must be released once the caller has emitted the instructions consuming it.
+    Source registers passed in are only borrowed.
+    Arguments should be compiled with emit_node rather than by calling their compile directly, so common subexpressions are found.
+   */
+  uint emit_node(const FunctionNode& node,uint src0);
+  uint emit_op(Opcode op,uint src0,uint src1=0);
+  uint emit_op(Opcode op,uint src0,const std::vector<real>& k,uint first,uint count);
+  uint emit_evaluate(const FunctionNode& node,uint src0);
+  uint emit_binary(Opcode op,const FunctionNode& node,uint src0);
+  void retain(uint r);
+  void release(uint r);
+  //@}
+
+ protected:
+
+  //! Constructor.  Use compile().
+  FunctionProgram(const SimdKernels& kernels);
+
+  //! Return a register with no outstanding references (adding one).
+  uint allocate();
+
+  //! Append an instruction writing to a newly allocated register.
+  Instruction& append(Opcode op,uint src0,uint src1);
+
+  //! The kernels implementing the built-in operations.
+  const SimdKernels*const _kernels;
+
+  //! The instructions.
+  std::vector<Instruction> _code;
+
+  //! The register holding the result.
+  uint _result;
+
+  //! Outstanding references to each register while compiling; the size is the number of registers used.
+  std::vector<uint> _references;
+
+  //! Number of times each register has been allocated while compiling.
+  /*! A register with no outstanding references keeps its value until it is allocated again,
+    so a computed result is still available if its register's generation hasn't changed.
+   */
+  std::vector<uint> _generations;
+
+  //! A subtree already compiled.
+  struct Computed
+  {
+    const FunctionNode* node;
+    uint src0;
+    uint src0_generation;
+    uint result;
+    uint result_generation;
+  };
+
+  //! Subtrees compiled so far, by structural hash.  Only used while compiling.
+  std::multimap<size_t,Computed> _computed;
+
+  //! Structural hash of every node in the tree being compiled.  Only used while compiling.
+  std::map<const FunctionNode*,size_t> _hashes;
+
+  //! Number of common subexpressions found.
+  uint _shared;
+};
+
+template <> inline FunctionProgram::Registers::Bank<double>& FunctionProgram::Registers::bank<double>()
+{
+  return _double_bank;
+}
+
+template <> inline FunctionProgram::Registers::Bank<float>& FunctionProgram::Registers::bank<float>()
+{
+  return _float_bank;
+}
+
+#endif
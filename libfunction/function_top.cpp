@@ -24,18 +24,55 @@
 #include "function_boilerplate_instantiate.h"
 #include "function_top.h"
 
+#include "function_program.h"
 #include "mutation_parameters.h"
 #include "transform.h"
 
-const XYZ FunctionTop::evaluate(const XYZ& p) const
+template <typename XYZ,typename real> const XYZ FunctionTop::evaluate_generic(const XYZ& p) const
 {
-  const Transform space_transform(params(),0);
-  const XYZ sp(space_transform.transformed(p)); 
+  const XYZ sp(_space_transform.transformed(p)); 
   const XYZ v(arg(0)(sp));
-  const XYZ tv(tanh(0.5*v.x()),tanh(0.5*v.y()),tanh(0.5*v.z()));
+  const XYZ tv(tanh(real(0.5)*v.x()),tanh(real(0.5)*v.y()),tanh(real(0.5)*v.z()));
   // ...each component of tv is in [-1,1] so the transform parameters define a rhomboid in colour space.
-  const Transform colour_transform(params(),12);
-  return colour_transform.transformed(tv);
+  return _colour_transform.transformed(tv);
+}
+
+template <typename XYZ,typename real> void FunctionTop::evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+{
+  std::vector<XYZ> sp(n);
+  _space_transform.transformed(in,&sp[0],n);
+
+  arg(0)(&sp[0],out,n);
+
+  for (size_t i=0;i<n;i++)
+    {
+      const XYZ& v=out[i];
+      out[i]=XYZ(tanh(real(0.5)*v.x()),tanh(real(0.5)*v.y()),tanh(real(0.5)*v.z()));
+    }
+  _colour_transform.transformed(out,out,n);
+}
+
+template const XYZ FunctionTop::evaluate_generic<XYZ,real>(const XYZ& p) const;
+template const XYZf FunctionTop::evaluate_generic<XYZf,float>(const XYZf& p) const;
+template void FunctionTop::evaluate_batch_generic<XYZ,real>(const XYZ* in,XYZ* out,size_t n) const;
+template void FunctionTop::evaluate_batch_generic<XYZf,float>(const XYZf* in,XYZf* out,size_t n) const;
+
+uint FunctionTop::compile(FunctionProgram& program,uint input) const
+{
+  const uint sp=program.emit_op(FunctionProgram::OpTransform,input,params(),0,12);
+  const uint v=program.emit_node(arg(0),sp);
+  program.release(sp);
+  const uint tv=program.emit_op(FunctionProgram::OpTanhHalf,v);
+  program.release(v);
+  const uint r=program.emit_op(FunctionProgram::OpTransform,tv,params(),12,12);
+  program.release(tv);
+  return r;
+}
+
+void FunctionTop::update_derived()
+{
+  _space_transform=Transform(params(),0);
+  _colour_transform=Transform(params(),12);
 }
 
 std::unique_ptr<FunctionTop> FunctionTop::initial(const MutationParameters& parameters,const FunctionRegistration* specific_fn,bool unwrapped)
@@ -122,6 +159,16 @@ void FunctionTop::concatenate_pretransform_on_right(const Transform& transform)
   current_transform.concatenate_on_right(transform);
   for (uint i=0;i<12;i++)
     params()[i]=current_transform.get_columns()[i];
+  update_derived();
+}
+
+void FunctionTop::concatenate_pretransform_on_left(const Transform& transform)
+{
+  Transform current_transform(params(),0);
+  current_transform.concatenate_on_left(transform);
+  for (uint i=0;i<12;i++)
+    params()[i]=current_transform.get_columns()[i];
+  update_derived();
 }
 
 const Transform FunctionTop::interesting_pretransform(const MutationParameters& parameters,const real k)
@@ -212,12 +259,14 @@ void FunctionTop::reset_pretransform_parameters(const MutationParameters& parame
   const std::vector<real> p(t.get_columns());
   for (uint i=0;i<11;i++)
     params()[i]=p[i];
+  update_derived();
 }
 
 void FunctionTop::mutate_posttransform_parameters(const MutationParameters& parameters)
 {
   for (uint i=12;i<23;i++)
     params()[i]+=parameters.effective_magnitude_parameter_variation()*(parameters.r01()<0.5 ? -parameters.rnegexp() : parameters.rnegexp());
+  update_derived();
 }
 
 void FunctionTop::reset_posttransform_parameters(const MutationParameters& parameters)
@@ -226,4 +275,5 @@ void FunctionTop::reset_posttransform_parameters(const MutationParameters& param
   stubparams(p,parameters,12);
   for (uint i=0;i<11;i++)
     params()[12+i]=p[i];
+  update_derived();
 }
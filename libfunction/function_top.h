@@ -30,8 +30,7 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
-
-class Transform;
+#include "transform.h"
 
 //! Function intended primarily to be the top level function node.
 /*! First 12 parameters are a space transform, second 12 paramters are a colour space transform.
@@ -42,7 +41,11 @@ public:
   //! This returns a random tree suitable for use as a starting image.
   static std::unique_ptr<FunctionTop> initial(const MutationParameters& parameters,const FunctionRegistration* specific_fn=0,bool unwrapped=false);
 
-  virtual const XYZ evaluate(const XYZ& p) const;
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const;
+
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const;
+
+  virtual uint compile(FunctionProgram& program,uint input) const;
 
   virtual FunctionTop* is_a_FunctionTop()
   {
@@ -54,20 +57,35 @@ public:
       return this;
   }
 
+  //! Also absorbs any transform immediately below us into our own space transform.
+  virtual void optimise();
+
   //! Overridden so transform and colours don't keep changing
   virtual void mutate(const MutationParameters& parameters,bool mutate_own_parameters=true);
 
   virtual void concatenate_pretransform_on_right(const Transform& transform);
+  virtual void concatenate_pretransform_on_left(const Transform& transform);
 
   virtual void mutate_pretransform_parameters(const MutationParameters& parameters);
   virtual void reset_pretransform_parameters(const MutationParameters& parameters);
   virtual void mutate_posttransform_parameters(const MutationParameters& parameters);
   virtual void reset_posttransform_parameters(const MutationParameters& parameters);
 
+protected:
+
+  //! Rebuild the cached transforms from the parameters.
+  virtual void update_derived();
+
 private:
 
   const Transform interesting_pretransform(const MutationParameters& parameters,const real k);
 
+  //! Space transform, built from the first 12 parameters.
+  Transform _space_transform;
+
+  //! Colour space transform, built from the second 12 parameters.
+  Transform _colour_transform;
+
 FUNCTION_END(FunctionTop)
 
 #endif
@@ -27,6 +27,7 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
 
 #include "transform.h"
 
@@ -36,12 +37,59 @@
 FUNCTION_BEGIN(FunctionTransform,12,0,false,FnCore)
 
   //! Return the transformed position argument.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
   {
-    const Transform transform(params());
-    return transform.transformed(p);
+    return _transform.transformed(p);
   }
 
+  //! Return the transformed positions of a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+  {
+    _transform.transformed(in,out,n);
+  }
+
+  //! Compile to a single transform instruction.
+  virtual uint compile(FunctionProgram& program,uint input) const
+  {
+    return program.emit_op(FunctionProgram::OpTransform,input,params(),0,12);
+  }
+
+  //! Returns our transform.
+  virtual bool is_affine(Transform& t) const
+  {
+    t=_transform;
+    return true;
+  }
+
+  //! Accessor.
+  const Transform& transform() const
+  {
+    return _transform;
+  }
+
+  //! Create a node applying the given transform.
+  static std::unique_ptr<FunctionNode> from_transform(const Transform& t)
+  {
+    boost::ptr_vector<FunctionNode> a;
+    return std::unique_ptr<FunctionNode>(new FunctionTransform(t.get_columns(),a,0));
+  }
+
+ protected:
+
+  //! An identity transform is replaced by FunctionIdentity.
+  virtual std::unique_ptr<FunctionNode> optimised();
+
+  //! Rebuild the cached transform from the parameters.
+  virtual void update_derived()
+  {
+    _transform=Transform(params());
+  }
+
+ private:
+
+  //! The transform, built from the parameters.
+  Transform _transform;
+
 FUNCTION_END(FunctionTransform)
 
 //------------------------------------------------------------------------------------------
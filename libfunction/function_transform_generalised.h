@@ -33,12 +33,17 @@
 FUNCTION_BEGIN(FunctionTransformGeneralised,0,4,false,0)
 
   //! Return the transformed position argument.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
   {
-    const Transform transform(arg(0)(p),arg(1)(p),arg(2)(p),arg(3)(p));
+    const Transform transform(::XYZ(arg(0)(p)),::XYZ(arg(1)(p)),::XYZ(arg(2)(p)),::XYZ(arg(3)(p)));
     return transform.transformed(p);
   }
 
+  virtual bool is_constant() const
+  {
+    return false;
+  }
+
 FUNCTION_END(FunctionTransformGeneralised)
 
 #endif
@@ -28,16 +28,33 @@
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
 
 //------------------------------------------------------------------------------------------
 
 FUNCTION_BEGIN(FunctionAdd,0,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return arg(0)(p)+arg(1)(p);
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> v1(n);
+      arg(0)(in,out,n);
+      arg(1)(in,&v1[0],n);
+      for (size_t i=0;i<n;i++)
+	out[i]+=v1[i];
+    }
+
+  //! Compile to a single instruction combining the arguments.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_binary(FunctionProgram::OpAdd,*this,input);
+    }
   
 FUNCTION_END(FunctionAdd)
 
@@ -46,13 +63,29 @@ FUNCTION_END(FunctionAdd)
 FUNCTION_BEGIN(FunctionMultiply,0,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ v0(arg(0)(p));
       const XYZ v1(arg(1)(p));
       // NB Don't use v0*v1 as it would be cross-product.
       return XYZ(v0.x()*v1.x(),v0.y()*v1.y(),v0.z()*v1.z());
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> v1(n);
+      arg(0)(in,out,n);
+      arg(1)(in,&v1[0],n);
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ(out[i].x()*v1[i].x(),out[i].y()*v1[i].y(),out[i].z()*v1[i].z());
+    }
+
+  //! Compile to a single instruction combining the arguments.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_binary(FunctionProgram::OpMultiply,*this,input);
+    }
   
 FUNCTION_END(FunctionMultiply)
 
@@ -61,7 +94,7 @@ FUNCTION_END(FunctionMultiply)
 FUNCTION_BEGIN(FunctionDivide,0,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ v0(arg(0)(p));
       const XYZ v1(arg(1)(p));
@@ -73,6 +106,29 @@ FUNCTION_BEGIN(FunctionDivide,0,2,false,0)
 		 );
 
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> v1(n);
+      arg(0)(in,out,n);
+      arg(1)(in,&v1[0],n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ& v0=out[i];
+	  out[i]=XYZ(
+		     (v1[i].x()==0.0 ? 0.0 : v0.x()/v1[i].x()),
+		     (v1[i].y()==0.0 ? 0.0 : v0.y()/v1[i].y()),
+		     (v1[i].z()==0.0 ? 0.0 : v0.z()/v1[i].z())
+		     );
+	}
+    }
+
+  //! Compile to a single instruction combining the arguments.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_binary(FunctionProgram::OpDivide,*this,input);
+    }
   
 FUNCTION_END(FunctionDivide)
 
@@ -81,7 +137,7 @@ FUNCTION_END(FunctionDivide)
 FUNCTION_BEGIN(FunctionMax,0,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ v0(arg(0)(p));
       const XYZ v1(arg(1)(p));
@@ -91,6 +147,26 @@ FUNCTION_BEGIN(FunctionMax,0,2,false,0)
 		 std::max(v0.z(),v1.z())
 		 );
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> v1(n);
+      arg(0)(in,out,n);
+      arg(1)(in,&v1[0],n);
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ(
+		   std::max(out[i].x(),v1[i].x()),
+		   std::max(out[i].y(),v1[i].y()),
+		   std::max(out[i].z(),v1[i].z())
+		   );
+    }
+
+  //! Compile to a single instruction combining the arguments.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_binary(FunctionProgram::OpMax,*this,input);
+    }
   
 FUNCTION_END(FunctionMax)
 
@@ -99,7 +175,7 @@ FUNCTION_END(FunctionMax)
 FUNCTION_BEGIN(FunctionMin,0,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ v0(arg(0)(p));
       const XYZ v1(arg(1)(p));
@@ -109,6 +185,26 @@ FUNCTION_BEGIN(FunctionMin,0,2,false,0)
 		 std::min(v0.z(),v1.z())
 		 );
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> v1(n);
+      arg(0)(in,out,n);
+      arg(1)(in,&v1[0],n);
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ(
+		   std::min(out[i].x(),v1[i].x()),
+		   std::min(out[i].y(),v1[i].y()),
+		   std::min(out[i].z(),v1[i].z())
+		   );
+    }
+
+  //! Compile to a single instruction combining the arguments.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_binary(FunctionProgram::OpMin,*this,input);
+    }
   
 FUNCTION_END(FunctionMin)
 
@@ -120,7 +216,7 @@ FUNCTION_END(FunctionMin)
 FUNCTION_BEGIN(FunctionModulus,0,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ v0(arg(0)(p));
       const XYZ v1(arg(1)(p));
@@ -130,6 +226,26 @@ FUNCTION_BEGIN(FunctionModulus,0,2,false,0)
 		 modulusf(v0.z(),fabs(v1.z()))
 		 );
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> v1(n);
+      arg(0)(in,out,n);
+      arg(1)(in,&v1[0],n);
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ(
+		   modulusf(out[i].x(),fabs(v1[i].x())),
+		   modulusf(out[i].y(),fabs(v1[i].y())),
+		   modulusf(out[i].z(),fabs(v1[i].z()))
+		   );
+    }
+
+  //! Compile to a single instruction combining the arguments.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_binary(FunctionProgram::OpModulus,*this,input);
+    }
   
 FUNCTION_END(FunctionModulus)
 
@@ -138,10 +254,23 @@ FUNCTION_END(FunctionModulus)
 FUNCTION_BEGIN(FunctionExp,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(exp(p.x()),exp(p.y()),exp(p.z()));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ(exp(in[i].x()),exp(in[i].y()),exp(in[i].z()));
+    }
+
+  //! Compile to a single instruction.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_op(FunctionProgram::OpExp,input);
+    }
   
 FUNCTION_END(FunctionExp)
 
@@ -150,10 +279,23 @@ FUNCTION_END(FunctionExp)
 FUNCTION_BEGIN(FunctionSin,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(sin(p.x()),sin(p.y()),sin(p.z()));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ(sin(in[i].x()),sin(in[i].y()),sin(in[i].z()));
+    }
+
+  //! Compile to a single instruction.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_op(FunctionProgram::OpSin,input);
+    }
   
 FUNCTION_END(FunctionSin)
 
@@ -162,10 +304,23 @@ FUNCTION_END(FunctionSin)
 FUNCTION_BEGIN(FunctionCos,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(cos(p.x()),cos(p.y()),cos(p.z()));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ(cos(in[i].x()),cos(in[i].y()),cos(in[i].z()));
+    }
+
+  //! Compile to a single instruction.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_op(FunctionProgram::OpCos,input);
+    }
   
 FUNCTION_END(FunctionCos)
 
@@ -174,10 +329,23 @@ FUNCTION_END(FunctionCos)
 FUNCTION_BEGIN(FunctionTan,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(tan(p.x()),tan(p.y()),tan(p.z()));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ(tan(in[i].x()),tan(in[i].y()),tan(in[i].z()));
+    }
+
+  //! Compile to a single instruction.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_op(FunctionProgram::OpTan,input);
+    }
   
 FUNCTION_END(FunctionTan)
 
@@ -186,7 +354,7 @@ FUNCTION_END(FunctionTan)
 FUNCTION_BEGIN(FunctionFDIM,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(fdim(p.x(),p.y()),fdim(p.y(),p.z()),fdim(p.z(),p.x()));
     }
@@ -198,7 +366,7 @@ FUNCTION_END(FunctionFDIM)
 FUNCTION_BEGIN(FunctionFMA,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(fma(p.x(),p.y(),p.z()),fma(p.y(),p.z(),p.x()), fma(p.z(),p.x(),p.y()));
     }
@@ -37,12 +37,17 @@
 FUNCTION_BEGIN(FunctionChooseStrip,3,3,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       if (fabs(p.y()) > fabs(arg(2)(p)%XYZ(param(0),param(1),param(2)))) return arg(1)(p);
       else return arg(0)(p);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseStrip)
 
 //------------------------------------------------------------------------------------------
@@ -51,7 +56,7 @@ FUNCTION_END(FunctionChooseStrip)
 FUNCTION_BEGIN(FunctionChooseStripBlend,6,4,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real r0=fabs(arg(2)(p)%XYZ(param(0),param(1),param(2)));
       const real r1=fabs(arg(3)(p)%XYZ(param(3),param(4),param(5)));
@@ -68,6 +73,11 @@ FUNCTION_BEGIN(FunctionChooseStripBlend,6,4,false,FnStructure)
       return v0+(v1-v0)*(ay-inner)/(outer-inner);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseStripBlend)
 
 //------------------------------------------------------------------------------------------
@@ -76,7 +86,7 @@ FUNCTION_END(FunctionChooseStripBlend)
 FUNCTION_BEGIN(FunctionChooseSphere,0,4,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       if ((arg(0)(p)).magnitude2()<(arg(1)(p)).magnitude2())
 	return arg(2)(p);
@@ -92,7 +102,7 @@ FUNCTION_END(FunctionChooseSphere)
 FUNCTION_BEGIN(FunctionChooseRect,0,4,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ p0(arg(0)(p));
       const XYZ p1(arg(1)(p));
@@ -111,7 +121,7 @@ FUNCTION_END(FunctionChooseRect)
 FUNCTION_BEGIN(FunctionChooseFrom2InCubeMesh,0,2,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const int x=static_cast<int>(floorf(p.x()));
       const int y=static_cast<int>(floorf(p.y()));
@@ -123,6 +133,11 @@ FUNCTION_BEGIN(FunctionChooseFrom2InCubeMesh,0,2,false,FnStructure)
 	return arg(1)(p);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom2InCubeMesh);
 
 //------------------------------------------------------------------------------------------
@@ -131,7 +146,7 @@ FUNCTION_END(FunctionChooseFrom2InCubeMesh);
 FUNCTION_BEGIN(FunctionChooseFrom3InCubeMesh,0,3,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const int x=static_cast<int>(floorf(p.x()));
       const int y=static_cast<int>(floorf(p.y()));
@@ -140,6 +155,11 @@ FUNCTION_BEGIN(FunctionChooseFrom3InCubeMesh,0,3,false,FnStructure)
       return arg(modulusi(x+y+z,3))(p);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom3InCubeMesh)
 
 //------------------------------------------------------------------------------------------
@@ -148,7 +168,7 @@ FUNCTION_END(FunctionChooseFrom3InCubeMesh)
 FUNCTION_BEGIN(FunctionChooseFrom2InSquareGrid,0,2,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const int x=static_cast<int>(floorf(p.x()));
       const int y=static_cast<int>(floorf(p.y()));
@@ -159,6 +179,11 @@ FUNCTION_BEGIN(FunctionChooseFrom2InSquareGrid,0,2,false,FnStructure)
 	return arg(1)(p);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom2InSquareGrid)
 
 //------------------------------------------------------------------------------------------
@@ -167,7 +192,7 @@ FUNCTION_END(FunctionChooseFrom2InSquareGrid)
 FUNCTION_BEGIN(FunctionChooseFrom3InSquareGrid,0,3,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const int x=static_cast<int>(floorf(p.x()));
       const int y=static_cast<int>(floorf(p.y()));
@@ -175,6 +200,11 @@ FUNCTION_BEGIN(FunctionChooseFrom3InSquareGrid,0,3,false,FnStructure)
       return arg(modulusi(x+y,3))(p);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom3InSquareGrid)
 
 //------------------------------------------------------------------------------------------
@@ -183,7 +213,7 @@ FUNCTION_END(FunctionChooseFrom3InSquareGrid)
 FUNCTION_BEGIN(FunctionChooseFrom2InTriangleGrid,0,2,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       static const XYZ d0(1.0         ,0.0         ,0.0);
       static const XYZ d1(cos(  M_PI/3),sin(  M_PI/3),0.0);
@@ -199,6 +229,11 @@ FUNCTION_BEGIN(FunctionChooseFrom2InTriangleGrid,0,2,false,FnStructure)
 	return arg(1)(p);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom2InTriangleGrid)
 
 //------------------------------------------------------------------------------------------
@@ -209,7 +244,7 @@ FUNCTION_END(FunctionChooseFrom2InTriangleGrid)
 FUNCTION_BEGIN(FunctionChooseFrom3InTriangleGrid,0,3,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       static const XYZ d0(1.0         ,0.0         ,0.0);
       static const XYZ d1(cos(  M_PI/3),sin(  M_PI/3),0.0);
@@ -222,6 +257,11 @@ FUNCTION_BEGIN(FunctionChooseFrom3InTriangleGrid,0,3,false,FnStructure)
       return arg(modulusi(a+b+c,3))(p);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom3InTriangleGrid)
 
 //------------------------------------------------------------------------------------------
@@ -232,7 +272,7 @@ FUNCTION_END(FunctionChooseFrom3InTriangleGrid)
 FUNCTION_BEGIN(FunctionChooseFrom3InDiamondGrid,0,3,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       // Basis vectors for hex grid
       static const XYZ d0(1.0         ,0.0         ,0.0);
@@ -263,6 +303,11 @@ FUNCTION_BEGIN(FunctionChooseFrom3InDiamondGrid,0,3,false,FnStructure)
 	return arg(2)(p);
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom3InDiamondGrid)
 
 //------------------------------------------------------------------------------------------
@@ -271,13 +316,18 @@ FUNCTION_END(FunctionChooseFrom3InDiamondGrid)
 FUNCTION_BEGIN(FunctionChooseFrom3InHexagonGrid,0,3,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const std::pair<int,int> h=nearest_hex(p.x(),p.y());
       const uint which=h.second+((h.first&1)? 2 : 0);
       return arg(modulusi(which,3))(p);
     }
     
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom3InHexagonGrid)
 
 //------------------------------------------------------------------------------------------
@@ -286,7 +336,7 @@ FUNCTION_END(FunctionChooseFrom3InHexagonGrid)
 FUNCTION_BEGIN(FunctionChooseFrom2InBorderedHexagonGrid,1,2,false,FnStructure)
   
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const std::pair<int,int> h=nearest_hex(p.x(),p.y());
 
@@ -312,6 +362,11 @@ FUNCTION_BEGIN(FunctionChooseFrom2InBorderedHexagonGrid,1,2,false,FnStructure)
 
       return arg(in_border)(p);
     }  
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionChooseFrom2InBorderedHexagonGrid)
 
 //------------------------------------------------------------------------------------------
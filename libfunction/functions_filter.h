@@ -34,7 +34,7 @@
 FUNCTION_BEGIN(FunctionFilter2D,2,1,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return
 	arg(0)(p)
@@ -45,6 +45,30 @@ FUNCTION_BEGIN(FunctionFilter2D,2,1,false,0)
 	  +arg(0)(p+XYZ(0.0,-param(1),0.0))
 	  )/4.0;
     }
+
+  //! Evaluate function over a run of points.
+  /*! All 5 samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> q(5*n);
+      std::vector<XYZ> v(5*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ& p=in[i];
+	  q[5*i  ]=p;
+	  q[5*i+1]=p+XYZ(param(0),0.0,0.0);
+	  q[5*i+2]=p+XYZ(-param(0),0.0,0.0);
+	  q[5*i+3]=p+XYZ(0.0,param(1),0.0);
+	  q[5*i+4]=p+XYZ(0.0,-param(1),0.0);
+	}
+      evaluate_stencil(0,&q[0],&v[0],5*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ* w=&v[5*i];
+	  out[i]=w[0]-(w[1]+w[2]+w[3]+w[4])/4.0;
+	}
+    }
   
 FUNCTION_END(FunctionFilter2D)
 
@@ -53,7 +77,7 @@ FUNCTION_END(FunctionFilter2D)
 FUNCTION_BEGIN(FunctionFilter3D,3,1,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return
 	arg(0)(p)
@@ -66,6 +90,32 @@ FUNCTION_BEGIN(FunctionFilter3D,3,1,false,0)
 	  +arg(0)(p+XYZ(0.0,0.0,-param(2)))
 	  )/6.0;
     }
+
+  //! Evaluate function over a run of points.
+  /*! All 7 samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> q(7*n);
+      std::vector<XYZ> v(7*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ& p=in[i];
+	  q[7*i  ]=p;
+	  q[7*i+1]=p+XYZ(param(0),0.0,0.0);
+	  q[7*i+2]=p+XYZ(-param(0),0.0,0.0);
+	  q[7*i+3]=p+XYZ(0.0,param(1),0.0);
+	  q[7*i+4]=p+XYZ(0.0,-param(1),0.0);
+	  q[7*i+5]=p+XYZ(0.0,0.0,param(2));
+	  q[7*i+6]=p+XYZ(0.0,0.0,-param(2));
+	}
+      evaluate_stencil(0,&q[0],&v[0],7*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ* w=&v[7*i];
+	  out[i]=w[0]-(w[1]+w[2]+w[3]+w[4]+w[5]+w[6])/6.0;
+	}
+    }
   
 FUNCTION_END(FunctionFilter3D)
 
@@ -75,7 +125,7 @@ FUNCTION_END(FunctionFilter3D)
 FUNCTION_BEGIN(FunctionAverageSamples,3,1,true,FnIterative)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ baseline(param(0),param(1),param(2));
      
@@ -117,7 +167,7 @@ FUNCTION_END(FunctionAverageSamples)
 FUNCTION_BEGIN(FunctionStreak,3,1,true,FnIterative)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ baseline(param(0),param(1),param(2));
      
@@ -161,20 +211,70 @@ FUNCTION_END(FunctionStreak)
 FUNCTION_BEGIN(FunctionAverageRing,1,1,true,FnIterative)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       if (iterations()==1) return arg(0)(p);
 
-      const real da=2.0*M_PI/iterations();
       XYZ ret(0.0,0.0,0.0);
+      for (uint i=0;i<iterations();i++)
+	ret+=arg(0)(p+XYZ(_ring[i]));
+      return ret/iterations();
+    }
+
+  //! Evaluate function over a run of points.
+  /*! All the ring samples of every point go to the argument as a single batch
+    (split up when there are so many samples the batch would outgrow the caches).
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      if (iterations()==1)
+	{
+	  arg(0)(in,out,n);
+	  return;
+	}
+
+      const uint m=iterations();
+      const size_t chunk=std::max<size_t>(1,4096/m);
+      if (n>chunk)
+	{
+	  for (size_t i=0;i<n;i+=chunk)
+	    evaluate_batch(in+i,out+i,std::min(chunk,n-i));
+	  return;
+	}
+
+      std::vector<XYZ> q(m*n);
+      std::vector<XYZ> v(m*n);
+      for (size_t i=0;i<n;i++)
+	for (uint j=0;j<m;j++)
+	  q[m*i+j]=in[i]+XYZ(_ring[j]);
+      evaluate_stencil(0,&q[0],&v[0],m*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  XYZ ret(0.0,0.0,0.0);
+	  for (uint j=0;j<m;j++)
+	    ret+=v[m*i+j];
+	  out[i]=ret/m;
+	}
+    }
+
+ protected:
+
+  //! Tabulate the ring offsets, which only depend on the parameter and iteration count.
+  virtual void update_derived()
+    {
+      _ring.resize(iterations());
+      const real da=2.0*M_PI/iterations();
       for (uint i=0;i<iterations();i++)
 	{
 	  const real a=i*da;
-	  const XYZ delta(param(0)*cos(a),param(0)*sin(a),0.0);
-	  ret+=arg(0)(p+delta);
+	  _ring[i]=XYZ(param(0)*cos(a),param(0)*sin(a),0.0);
 	}
-      return ret/iterations();
     }
+
+ private:
+
+  //! Offset of each sample from the centre of the ring.
+  std::vector<XYZ> _ring;
   
 FUNCTION_END(FunctionAverageRing)
 
@@ -184,20 +284,72 @@ FUNCTION_END(FunctionAverageRing)
 FUNCTION_BEGIN(FunctionFilterRing,1,1,true,FnIterative)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       if (iterations()==1) return XYZ(0.0,0.0,0.0);
 
-      const real da=2.0*M_PI/iterations();
       XYZ ret(0.0,0.0,0.0);
+      for (uint i=0;i<iterations();i++)
+	ret+=arg(0)(p+XYZ(_ring[i]));
+      return ret/iterations()-arg(0)(p);
+    }
+
+  //! Evaluate function over a run of points.
+  /*! As FunctionAverageRing::evaluate_batch, with the centre sample added to each point's ring.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      if (iterations()==1)
+	{
+	  std::fill(out,out+n,XYZ(0.0,0.0,0.0));
+	  return;
+	}
+
+      const uint m=iterations()+1;
+      const size_t chunk=std::max<size_t>(1,4096/m);
+      if (n>chunk)
+	{
+	  for (size_t i=0;i<n;i+=chunk)
+	    evaluate_batch(in+i,out+i,std::min(chunk,n-i));
+	  return;
+	}
+
+      std::vector<XYZ> q(m*n);
+      std::vector<XYZ> v(m*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  q[m*i]=in[i];
+	  for (uint j=1;j<m;j++)
+	    q[m*i+j]=in[i]+XYZ(_ring[j-1]);
+	}
+      evaluate_stencil(0,&q[0],&v[0],m*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  XYZ ret(0.0,0.0,0.0);
+	  for (uint j=1;j<m;j++)
+	    ret+=v[m*i+j];
+	  out[i]=ret/iterations()-v[m*i];
+	}
+    }
+
+ protected:
+
+  //! Tabulate the ring offsets, as FunctionAverageRing.
+  virtual void update_derived()
+    {
+      _ring.resize(iterations());
+      const real da=2.0*M_PI/iterations();
       for (uint i=0;i<iterations();i++)
 	{
 	  const real a=i*da;
-	  const XYZ delta(param(0)*cos(a),param(0)*sin(a),0.0);
-	  ret+=arg(0)(p+delta);
+	  _ring[i]=XYZ(param(0)*cos(a),param(0)*sin(a),0.0);
 	}
-      return ret/iterations()-arg(0)(p);
     }
+
+ private:
+
+  //! Offset of each sample from the centre of the ring.
+  std::vector<XYZ> _ring;
   
 FUNCTION_END(FunctionFilterRing)
 
@@ -207,7 +359,7 @@ FUNCTION_END(FunctionFilterRing)
 FUNCTION_BEGIN(FunctionConvolveSamples,3,2,true,FnIterative)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ baseline(param(0),param(1),param(2));
      
@@ -249,21 +401,42 @@ FUNCTION_END(FunctionConvolveSamples)
 FUNCTION_BEGIN(FunctionAccumulateOctaves,0,1,true,FnIterative)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       XYZ ret(0.0,0.0,0.0);
-      real k=0.0;
       for (uint i=0;i<iterations();i++)
 	{
 	  const real scale=(1<<i);
 	  const real iscale=1.0/scale;
 	  ret+=iscale*(arg(0)(scale*p));
-	  k+=iscale;
 	}
-      ret/=k;
+      ret/=octave_weights(iterations());
       return ret;
     }
-  
+
+  //! Evaluate function over a run of points.
+  /*! Loops octave-major, so the argument is evaluated a whole run of points at a time.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::fill(out,out+n,XYZ(0.0,0.0,0.0));
+      std::vector<XYZ> p(n);
+      std::vector<XYZ> v(n);
+      for (uint i=0;i<iterations();i++)
+	{
+	  const real scale=(1<<i);
+	  const real iscale=1.0/scale;
+	  for (size_t j=0;j<n;j++)
+	    p[j]=scale*in[j];
+	  arg(0)(&p[0],&v[0],n);
+	  for (size_t j=0;j<n;j++)
+	    out[j]+=iscale*v[j];
+	}
+      const real k=octave_weights(iterations());
+      for (size_t j=0;j<n;j++)
+	out[j]/=k;
+    }
+
 FUNCTION_END(FunctionAccumulateOctaves)
 
 //------------------------------------------------------------------------------------------
@@ -34,7 +34,7 @@
 
 FUNCTION_BEGIN(FunctionFriezeGroupJumpFreeZ,0,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Jump(1.0),FreeZ());
     }
@@ -45,7 +45,7 @@ FUNCTION_END(FunctionFriezeGroupJumpFreeZ)
 
 FUNCTION_BEGIN(FunctionFriezeGroupJumpClampZ,1,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Jump(1.0),ClampZ(param(0)));
     }
@@ -56,22 +56,32 @@ FUNCTION_END(FunctionFriezeGroupJumpClampZ)
 
 FUNCTION_BEGIN(FunctionFriezeGroupJumpBlendClampZ,1,2,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupBlend(arg(0),arg(1),p,JumpBlend(1.0),ClampZ(param(0)));
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionFriezeGroupJumpBlendClampZ)
 
 //------------------------------------------------------------------------------------------
 
 FUNCTION_BEGIN(FunctionFriezeGroupJumpBlendFreeZ,0,2,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupBlend(arg(0),arg(1),p,JumpBlend(1.0),FreeZ());
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionFriezeGroupJumpBlendFreeZ)
 
 //------------------------------------------------------------------------------------------
@@ -79,7 +89,7 @@ FUNCTION_END(FunctionFriezeGroupJumpBlendFreeZ)
 /*
 FUNCTION_BEGIN(FunctionFriezeGroupJumpCutClampZ,2,2,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const int d=FriezegroupCut(arg(1),p,JumpCut(1.0),ClampZ(param(1)));
       return FriezegroupEvaluate(arg(0),p,Jump(1.0,d),ClampZ(param(0)));
@@ -93,7 +103,7 @@ FUNCTION_END(FunctionFriezeGroupJumpCutClampZ)
 /*
 FUNCTION_BEGIN(FunctionFriezeGroupJumpCutFreeZ,0,2,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const int d=FriezegroupCut(arg(1),p,JumpCut(1.0),FreeZ());
       return FriezegroupEvaluate(arg(0),p,Jump(1.0,d),FreeZ());
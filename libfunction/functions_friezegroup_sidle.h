@@ -34,7 +34,7 @@
 
 FUNCTION_BEGIN(FunctionFriezeGroupSidleFreeZ,0,1,false,FnStructure)
      
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {  
       return FriezegroupEvaluate(arg(0),p,Sidle(1.0),FreeZ());
     }
@@ -45,7 +45,7 @@ FUNCTION_END(FunctionFriezeGroupSidleFreeZ)
 
 FUNCTION_BEGIN(FunctionFriezeGroupSidleClampZ,1,1,false,FnStructure)
      
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {  
       return FriezegroupEvaluate(arg(0),p,Sidle(1.0),ClampZ(param(0)));
     }
@@ -34,7 +34,7 @@
 
 FUNCTION_BEGIN(FunctionFriezeGroupSpinhopFreeZ,0,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Spinhop(1.0),FreeZ());
     }
@@ -45,7 +45,7 @@ FUNCTION_END(FunctionFriezeGroupSpinhopFreeZ)
 
 FUNCTION_BEGIN(FunctionFriezeGroupSpinhopClampZ,1,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Spinhop(1.0),ClampZ(param(0)));
     }
@@ -56,7 +56,7 @@ FUNCTION_END(FunctionFriezeGroupSpinhopClampZ)
 
 FUNCTION_BEGIN(FunctionFriezeGroupSpinhopBlendClampZ,1,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupBlend(arg(0),p,SpinhopBlend(1.0),ClampZ(param(0)));
     }
@@ -67,7 +67,7 @@ FUNCTION_END(FunctionFriezeGroupSpinhopBlendClampZ)
 
 FUNCTION_BEGIN(FunctionFriezeGroupSpinhopBlendFreeZ,0,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupBlend(arg(0),p,SpinhopBlend(1.0),FreeZ());
     }
@@ -79,7 +79,7 @@ FUNCTION_END(FunctionFriezeGroupSpinhopBlendFreeZ)
 /*
 FUNCTION_BEGIN(FunctionFriezeGroupSpinhopCutClampZ,2,2,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const int d=SpinhopCut<ClampZ>(1.0)(arg(1),p,ClampZ(param(1)));
       return FriezegroupEvaluate(arg(0),p,Spinhop(1.0,d),ClampZ(param(0)));
@@ -93,7 +93,7 @@ FUNCTION_END(FunctionFriezeGroupSpinhopCutClampZ)
 /*
 FUNCTION_BEGIN(FunctionFriezeGroupSpinhopCutFreeZ,0,2,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const int d=SpinhopCut<FreeZ>(1.0)(arg(1),p,FreeZ());
       return FriezegroupEvaluate(arg(0),p,Spinhop(1.0,d),FreeZ());
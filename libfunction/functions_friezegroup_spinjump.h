@@ -34,7 +34,7 @@
 
 FUNCTION_BEGIN(FunctionFriezeGroupSpinjumpFreeZ,0,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Spinjump(1.0),FreeZ());
     }
@@ -46,7 +46,7 @@ FUNCTION_END(FunctionFriezeGroupSpinjumpFreeZ)
 FUNCTION_BEGIN(FunctionFriezeGroupSpinjumpClampZ,1,1,false,FnStructure)
   // Don't think this form can be warped without breaking symmetry
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Spinjump(1.0),ClampZ(param(0)));
     }
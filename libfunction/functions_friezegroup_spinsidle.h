@@ -61,7 +61,7 @@ struct SpinsidleBlend;
 
 FUNCTION_BEGIN(FunctionFriezeGroupSpinsidleFreeZ,0,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Spinsidle(),FreeZ());
     }
@@ -72,7 +72,7 @@ FUNCTION_END(FunctionFriezeGroupSpinsidleFreeZ)
 
 FUNCTION_BEGIN(FunctionFriezeGroupSpinsidleClampZ,1,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Spinsidle(),ClampZ(param(0)));
     }
@@ -60,7 +60,7 @@ struct StepBlend;
 
 FUNCTION_BEGIN(FunctionFriezeGroupStepFreeZ,0,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Step(),FreeZ());
     }
@@ -71,7 +71,7 @@ FUNCTION_END(FunctionFriezeGroupStepFreeZ)
 
 FUNCTION_BEGIN(FunctionFriezeGroupStepClampZ,1,1,false,FnStructure)
 
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return FriezegroupEvaluate(arg(0),p,Step(),ClampZ(param(0)));
     }
@@ -34,7 +34,7 @@
 FUNCTION_BEGIN(FunctionCross,0,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ v0(arg(0)(p));
       const XYZ v1(arg(1)(p));
@@ -49,7 +49,7 @@ FUNCTION_END(FunctionCross)
 FUNCTION_BEGIN(FunctionGeometricInversion,0,1,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real radius2=p.magnitude2();
       const XYZ ip(p/radius2);
@@ -65,7 +65,7 @@ FUNCTION_END(FunctionGeometricInversion)
 FUNCTION_BEGIN(FunctionReflect,0,3,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ pt_in_plane(arg(0)(p));
       const XYZ normal(arg(1)(p).normalised());
@@ -32,9 +32,12 @@
 //------------------------------------------------------------------------------------------
 
 FUNCTION_BEGIN(FunctionDerivative,3,1,false,0)
+
+  //! Steps of epsilon() don't resolve in single precision, so evaluate in double.
+  static constexpr bool promote_to_double=true;
      
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ d(epsilon()*XYZ(param(0),param(1),param(2)).normalised());
       
@@ -43,15 +46,37 @@ FUNCTION_BEGIN(FunctionDerivative,3,1,false,0)
 
       return (v1-v0)*inv_epsilon2();
     }
+
+  //! Evaluate function over a run of points.
+  /*! Both samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      const XYZ d(epsilon()*XYZ(param(0),param(1),param(2)).normalised());
+
+      std::vector<XYZ> q(2*n);
+      std::vector<XYZ> v(2*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  q[2*i  ]=in[i]-d;
+	  q[2*i+1]=in[i]+d;
+	}
+      evaluate_stencil(0,&q[0],&v[0],2*n);
+      for (size_t i=0;i<n;i++)
+	out[i]=(v[2*i+1]-v[2*i])*inv_epsilon2();
+    }
   
 FUNCTION_END(FunctionDerivative)
 
 //------------------------------------------------------------------------------------------
 
 FUNCTION_BEGIN(FunctionDerivativeGeneralised,0,2,false,0)
+
+  //! Evaluated in double, as FunctionDerivative.
+  static constexpr bool promote_to_double=true;
      
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ d(epsilon()*(arg(1)(p)).normalised());
       
@@ -60,17 +85,39 @@ FUNCTION_BEGIN(FunctionDerivativeGeneralised,0,2,false,0)
 
       return (v1-v0)*inv_epsilon2();
     }
+
+  //! Evaluate function over a run of points.
+  /*! Both samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> q(2*n);
+      std::vector<XYZ> v(2*n);
+      arg(1)(in,&v[0],n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ d(epsilon()*v[i].normalised());
+	  q[2*i  ]=in[i]-d;
+	  q[2*i+1]=in[i]+d;
+	}
+      evaluate_stencil(0,&q[0],&v[0],2*n);
+      for (size_t i=0;i<n;i++)
+	out[i]=(v[2*i+1]-v[2*i])*inv_epsilon2();
+    }
   
 FUNCTION_END(FunctionDerivativeGeneralised)
 
 //------------------------------------------------------------------------------------------
 
 FUNCTION_BEGIN(FunctionGradient,3,1,false,0)
+
+  //! Evaluated in double: the central differences need it.
+  static constexpr bool promote_to_double=true;
      
   //! Evaluate function.
   /*! Gradient converts scalar to vector, so need a scalar to work on.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ k(param(0),param(1),param(2));
 
@@ -84,17 +131,39 @@ FUNCTION_BEGIN(FunctionGradient,3,1,false,0)
 
       return XYZ(vx1-vx0,vy1-vy0,vz1-vz0)*inv_epsilon2();
     }
+
+  //! Evaluate function over a run of points.
+  /*! All 6 samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      const XYZ k(param(0),param(1),param(2));
+
+      std::vector<XYZ> q(6*n);
+      std::vector<XYZ> v(6*n);
+      for (size_t i=0;i<n;i++)
+	central_stencil(in[i],epsilon(),&q[6*i]);
+      evaluate_stencil(0,&q[0],&v[0],6*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ* w=&v[6*i];
+	  out[i]=XYZ(k%w[3]-k%w[0],k%w[4]-k%w[1],k%w[5]-k%w[2])*inv_epsilon2();
+	}
+    }
   
 FUNCTION_END(FunctionGradient)
 
 //------------------------------------------------------------------------------------------
 
 FUNCTION_BEGIN(FunctionGradientGeneralised,0,2,false,0)
+
+  //! Evaluated in double, as FunctionGradient.
+  static constexpr bool promote_to_double=true;
      
   //! Evaluate function.
   /*! Gradient converts scalar to vector, so need a scalar to work on.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ k(arg(1)(p));
 
@@ -108,6 +177,26 @@ FUNCTION_BEGIN(FunctionGradientGeneralised,0,2,false,0)
 
       return XYZ(vx1-vx0,vy1-vy0,vz1-vz0)*inv_epsilon2();
     }
+
+  //! Evaluate function over a run of points.
+  /*! All 6 samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> k(n);
+      arg(1)(in,&k[0],n);
+
+      std::vector<XYZ> q(6*n);
+      std::vector<XYZ> v(6*n);
+      for (size_t i=0;i<n;i++)
+	central_stencil(in[i],epsilon(),&q[6*i]);
+      evaluate_stencil(0,&q[0],&v[0],6*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ* w=&v[6*i];
+	  out[i]=XYZ(k[i]%w[3]-k[i]%w[0],k[i]%w[4]-k[i]%w[1],k[i]%w[5]-k[i]%w[2])*inv_epsilon2();
+	}
+    }
   
 FUNCTION_END(FunctionGradientGeneralised)
 
@@ -115,10 +204,13 @@ FUNCTION_END(FunctionGradientGeneralised)
 
 FUNCTION_BEGIN(FunctionDivergence,0,1,false,0)
 
+  //! Evaluated in double, as FunctionGradient.
+  static constexpr bool promote_to_double=true;
+
   //! Evaluate function.
   /*! Divergence maps scalar to a scalar, so no problem doing vector->vector.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {      
       const XYZ vx0(arg(0)(p-XYZ(epsilon(),0.0,0.0)));
       const XYZ vy0(arg(0)(p-XYZ(0.0,epsilon(),0.0)));
@@ -130,6 +222,23 @@ FUNCTION_BEGIN(FunctionDivergence,0,1,false,0)
 
       return (vx1-vx0+vy1-vy0+vz1-vz0)*inv_epsilon2();
     }
+
+  //! Evaluate function over a run of points.
+  /*! All 6 samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> q(6*n);
+      std::vector<XYZ> v(6*n);
+      for (size_t i=0;i<n;i++)
+	central_stencil(in[i],epsilon(),&q[6*i]);
+      evaluate_stencil(0,&q[0],&v[0],6*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ* w=&v[6*i];
+	  out[i]=(w[3]-w[0]+w[4]-w[1]+w[5]-w[2])*inv_epsilon2();
+	}
+    }
   
 FUNCTION_END(FunctionDivergence)
 
@@ -137,22 +246,46 @@ FUNCTION_END(FunctionDivergence)
 
 FUNCTION_BEGIN(FunctionCurl,0,1,false,0)
 
+  //! Evaluated in double, as FunctionGradient.
+  static constexpr bool promote_to_double=true;
+
   //! Evaluate function.
   /*! Curl maps vector to vector, which is what we want.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      const XYZ vx0(arg(0)(p-XYZ(epsilon(),0.0,0.0)));
-      const XYZ vy0(arg(0)(p-XYZ(0.0,epsilon(),0.0)));
-      const XYZ vz0(arg(0)(p-XYZ(0.0,0.0,epsilon())));
+      XYZ q[6];
+      central_stencil(p,epsilon(),q);
 
-      const XYZ vx1(arg(0)(p+XYZ(epsilon(),0.0,0.0)));
-      const XYZ vy1(arg(0)(p+XYZ(0.0,epsilon(),0.0)));
-      const XYZ vz1(arg(0)(p+XYZ(0.0,0.0,epsilon())));
+      XYZ v[6];
+      for (uint j=0;j<6;j++)
+	v[j]=arg(0)(q[j]);
+
+      return curl(v);
+    }
+
+  //! Evaluate function over a run of points.
+  /*! All 6 samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> q(6*n);
+      std::vector<XYZ> v(6*n);
+      for (size_t i=0;i<n;i++)
+	central_stencil(in[i],epsilon(),&q[6*i]);
+      evaluate_stencil(0,&q[0],&v[0],6*n);
+      for (size_t i=0;i<n;i++)
+	out[i]=curl(&v[6*i]);
+    }
 
-      const XYZ d_dx((vx1-vx0)*inv_epsilon2());
-      const XYZ d_dy((vy1-vy0)*inv_epsilon2());
-      const XYZ d_dz((vz1-vz0)*inv_epsilon2());
+ protected:
+
+  //! Curl from the argument's values at the points of a central_stencil.
+  static const XYZ curl(const XYZ* v)
+    {
+      const XYZ d_dx((v[3]-v[0])*inv_epsilon2());
+      const XYZ d_dy((v[4]-v[1])*inv_epsilon2());
+      const XYZ d_dz((v[5]-v[2])*inv_epsilon2());
 
       const real dzdy=d_dy.z();
       const real dydz=d_dz.y();
@@ -176,28 +309,53 @@ FUNCTION_END(FunctionCurl)
 //------------------------------------------------------------------------------------------
 
 FUNCTION_BEGIN(FunctionScalarLaplacian,0,1,false,0)
+
+  //! Evaluated in double: second differences over epsilon() are lost entirely in float.
+  static constexpr bool promote_to_double=true;
      
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       // Need to use a bigger baseline to avoid noise being amplified
-      const XYZ vx0(arg(0)(p-XYZ(big_epsilon(),0.0,0.0)));
-      const XYZ vy0(arg(0)(p-XYZ(0.0,big_epsilon(),0.0)));
-      const XYZ vz0(arg(0)(p-XYZ(0.0,0.0,big_epsilon())));
+      XYZ q[6];
+      central_stencil(p,big_epsilon(),q);
 
-      const XYZ v(arg(0)(p));
+      XYZ w[6];
+      for (uint j=0;j<6;j++)
+	w[j]=arg(0)(q[j]);
 
-      const XYZ vx1(arg(0)(p+XYZ(big_epsilon(),0.0,0.0)));
-      const XYZ vy1(arg(0)(p+XYZ(0.0,big_epsilon(),0.0)));
-      const XYZ vz1(arg(0)(p+XYZ(0.0,0.0,big_epsilon())));
+      return laplacian(arg(0)(p),w);
+    }
 
-      const XYZ dx0(v-vx0);
-      const XYZ dy0(v-vy0);
-      const XYZ dz0(v-vz0);
+  //! Evaluate function over a run of points.
+  /*! All 7 samples of every point go to the argument as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> q(7*n);
+      std::vector<XYZ> v(7*n);
+      for (size_t i=0;i<n;i++)
+	{
+	  central_stencil(in[i],big_epsilon(),&q[7*i]);
+	  q[7*i+6]=in[i];
+	}
+      evaluate_stencil(0,&q[0],&v[0],7*n);
+      for (size_t i=0;i<n;i++)
+	out[i]=laplacian(v[7*i+6],&v[7*i]);
+    }
+
+ protected:
+
+  //! Laplacian from the argument's value v at the centre and its values w at the points of a central_stencil.
+  static const XYZ laplacian(const XYZ& v,const XYZ* w)
+    {
+      const XYZ dx0(v-w[0]);
+      const XYZ dy0(v-w[1]);
+      const XYZ dz0(v-w[2]);
 
-      const XYZ dx1(vx1-v);
-      const XYZ dy1(vy1-v);
-      const XYZ dz1(vz1-v);
+      const XYZ dx1(w[3]-v);
+      const XYZ dy1(w[4]-v);
+      const XYZ dz1(w[5]-v);
 
       return XYZ(dx1-dx0+dy1-dy0+dz1-dz0)/(big_epsilon()*big_epsilon());
     }
@@ -19,10 +19,63 @@
 
 /*! \file
   \brief Implementation of specific Function classes.
-  Except there's nothing here because it's all in the header.
+  Except there's little here because it's nearly all in the header;
+  just the batch helpers.
 */
 
 
 
 #include "function_boilerplate_instantiate.h"
 #include "functions_juliabrot.h"
+
+#include "simd_kernels.h"
+
+void brot_batch(const std::vector<real>& z,const std::vector<real>& c,uint iterations,std::vector<uint>& i)
+{
+  assert(z.size()==2*i.size() && c.size()==2*i.size());
+  if (!i.empty())
+    SimdKernels::best().table<real>().escape_time(&z[0],&c[0],iterations,&i[0],i.size());
+}
+
+void brot_choose(const FunctionNode& in_set,const FunctionNode& escaped,const std::vector<uint>& i,uint iterations,const XYZ* in,XYZ* out,size_t n)
+{
+  // Gather the points in set to the front and the escaped points to the back, so each argument is evaluated as a single batch.
+  std::vector<size_t> order(n);
+  std::vector<XYZ> points(n);
+  size_t front=0;
+  size_t back=n;
+  for (size_t k=0;k<n;k++)
+    {
+      const size_t j=(i[k]==iterations ? front++ : --back);
+      order[j]=k;
+      points[j]=in[k];
+    }
+
+  std::vector<XYZ> values(n);
+  if (front>0)
+    in_set(&points[0],&values[0],front);
+  if (front<n)
+    escaped(&points[front],&values[front],n-front);
+  for (size_t j=0;j<n;j++)
+    out[order[j]]=values[j];
+}
+
+void brot_contour(const std::vector<uint>& i,uint iterations,XYZ* out)
+{
+  for (size_t k=0;k<i.size();k++)
+    out[k]=(i[k]==iterations ? XYZ::fill(-1.0) : XYZ::fill(static_cast<real>(i[k])/iterations));
+}
+
+void juliabrot_points(const std::vector<real>& params,const XYZ* in,size_t n,std::vector<real>& z,std::vector<real>& c)
+{
+  z.resize(2*n);
+  c.resize(2*n);
+  for (size_t k=0;k<n;k++)
+    {
+      const XYZ& p=in[k];
+      z[k]  =p.x()*params[ 0]+p.y()*params[ 1]+p.z()*params[ 2]+params[ 3];
+      z[n+k]=p.x()*params[ 4]+p.y()*params[ 5]+p.z()*params[ 6]+params[ 7];
+      c[k]  =p.x()*params[ 8]+p.y()*params[ 9]+p.z()*params[10]+params[11];
+      c[n+k]=p.x()*params[12]+p.y()*params[13]+p.z()*params[14]+params[15];
+    }
+}
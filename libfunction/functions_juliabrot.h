@@ -57,17 +57,52 @@ inline uint brot(const real z0r,const real z0i,const real cr,const real ci,const
   return i;
 }
 
+//! Batch version of brot, using the escape time kernel for the CPU.
+/*! z holds the starting points' real parts then their imaginary parts, and c the same for the constants.
+  Sets i to the results for each point.
+ */
+void brot_batch(const std::vector<real>& z,const std::vector<real>& c,uint iterations,std::vector<uint>& i);
+
+//! Evaluate the batch of points in set (i==iterations) with one function and the rest with another, a batch each.
+void brot_choose(const FunctionNode& in_set,const FunctionNode& escaped,const std::vector<uint>& i,uint iterations,const XYZ* in,XYZ* out,size_t n);
+
+//! Set out to the contour value for each of the results of brot_batch: -1 in set, 0-1 for escaped points.
+void brot_contour(const std::vector<uint>& i,uint iterations,XYZ* out);
+
+//! Set z and c for a batch of Juliabrot points: each component of the 4d point is given by 4 parameters (3 basis vector components and an offset).
+void juliabrot_points(const std::vector<real>& params,const XYZ* in,size_t n,std::vector<real>& z,std::vector<real>& c);
+
 //------------------------------------------------------------------------------------------
 
 //! Function selects arg to evaluate based on test for point in Mandelbrot set.
 FUNCTION_BEGIN(FunctionMandelbrotChoose,0,2,true,FnIterative|FnFractal)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return (brot(0.0,0.0,p.x(),p.y(),iterations())==iterations() ? arg(0)(p) : arg(1)(p));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<real> z(2*n,0.0);
+      std::vector<real> c(2*n);
+      for (size_t k=0;k<n;k++)
+	{
+	  c[k]=in[k].x();
+	  c[n+k]=in[k].y();
+	}
+      std::vector<uint> i(n);
+      brot_batch(z,c,iterations(),i);
+      brot_choose(arg(0),arg(1),i,iterations(),in,out,n);
+    }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionMandelbrotChoose)
 
 //-----------------------------------------------------------------------------------------
@@ -76,11 +111,26 @@ FUNCTION_END(FunctionMandelbrotChoose)
 FUNCTION_BEGIN(FunctionMandelbrotContour,0,0,true,FnIterative|FnFractal)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const uint i=brot(0.0,0.0,p.x(),p.y(),iterations());
       return (i==iterations() ? XYZ::fill(-1.0) : XYZ::fill(static_cast<real>(i)/iterations()));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<real> z(2*n,0.0);
+      std::vector<real> c(2*n);
+      for (size_t k=0;k<n;k++)
+	{
+	  c[k]=in[k].x();
+	  c[n+k]=in[k].y();
+	}
+      std::vector<uint> i(n);
+      brot_batch(z,c,iterations(),i);
+      brot_contour(i,iterations(),out);
+    }
   
 FUNCTION_END(FunctionMandelbrotContour)
 
@@ -90,11 +140,33 @@ FUNCTION_END(FunctionMandelbrotContour)
 FUNCTION_BEGIN(FunctionJuliaChoose,2,2,true,FnIterative|FnFractal)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return (brot(p.x(),p.y(),param(0),param(1),iterations())==iterations() ? arg(0)(p) : arg(1)(p));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<real> z(2*n);
+      std::vector<real> c(2*n);
+      for (size_t k=0;k<n;k++)
+	{
+	  z[k]=in[k].x();
+	  z[n+k]=in[k].y();
+	  c[k]=param(0);
+	  c[n+k]=param(1);
+	}
+      std::vector<uint> i(n);
+      brot_batch(z,c,iterations(),i);
+      brot_choose(arg(0),arg(1),i,iterations(),in,out,n);
+    }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionJuliaChoose)
 
 //------------------------------------------------------------------------------------------
@@ -103,11 +175,28 @@ FUNCTION_END(FunctionJuliaChoose)
 FUNCTION_BEGIN(FunctionJuliaContour,2,0,true,FnIterative|FnFractal)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const uint i=brot(p.x(),p.y(),param(0),param(1),iterations());
       return (i==iterations() ? XYZ::fill(-1.0) : XYZ::fill(static_cast<real>(i)/iterations()));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<real> z(2*n);
+      std::vector<real> c(2*n);
+      for (size_t k=0;k<n;k++)
+	{
+	  z[k]=in[k].x();
+	  z[n+k]=in[k].y();
+	  c[k]=param(0);
+	  c[n+k]=param(1);
+	}
+      std::vector<uint> i(n);
+      brot_batch(z,c,iterations(),i);
+      brot_contour(i,iterations(),out);
+    }
   
 FUNCTION_END(FunctionJuliaContour)
 
@@ -120,7 +209,7 @@ FUNCTION_END(FunctionJuliaContour)
 FUNCTION_BEGIN(FunctionJuliabrotChoose,16,2,true,FnIterative|FnFractal)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real zr=p.x()*param( 0)+p.y()*param( 1)+p.z()*param( 2)+param( 3);
       const real zi=p.x()*param( 4)+p.y()*param( 5)+p.z()*param( 6)+param( 7);
@@ -128,7 +217,23 @@ FUNCTION_BEGIN(FunctionJuliabrotChoose,16,2,true,FnIterative|FnFractal)
       const real ci=p.x()*param(12)+p.y()*param(13)+p.z()*param(14)+param(15);
       return (brot(zr,zi,cr,ci,iterations())==iterations() ? arg(0)(p) : arg(1)(p));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<real> z;
+      std::vector<real> c;
+      juliabrot_points(params(),in,n,z,c);
+      std::vector<uint> i(n);
+      brot_batch(z,c,iterations(),i);
+      brot_choose(arg(0),arg(1),i,iterations(),in,out,n);
+    }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionJuliabrotChoose)
 
 //------------------------------------------------------------------------------------------
@@ -140,7 +245,7 @@ FUNCTION_END(FunctionJuliabrotChoose)
 FUNCTION_BEGIN(FunctionJuliabrotContour,16,0,true,FnIterative|FnFractal)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real zr=p.x()*param( 0)+p.y()*param( 1)+p.z()*param( 2)+param( 3);
       const real zi=p.x()*param( 4)+p.y()*param( 5)+p.z()*param( 6)+param( 7);
@@ -149,6 +254,17 @@ FUNCTION_BEGIN(FunctionJuliabrotContour,16,0,true,FnIterative|FnFractal)
       const uint i=brot(zr,zi,cr,ci,iterations());
       return (i==iterations() ? XYZ::fill(-1.0) : XYZ::fill(static_cast<real>(i)/iterations()));
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<real> z;
+      std::vector<real> c;
+      juliabrot_points(params(),in,n,z,c);
+      std::vector<uint> i(n);
+      brot_batch(z,c,iterations(),i);
+      brot_contour(i,iterations(),out);
+    }
   
 FUNCTION_END(FunctionJuliabrotContour)
 
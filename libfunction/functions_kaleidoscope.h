@@ -29,24 +29,87 @@
 
 #include "function_boilerplate.h"
 
+//! Fill in the rotations through each multiple j*pi/n of the sector angle of an n-way fold of the plane, for j up to n+2.
+/*! The kaleidoscope and windmill functions fold every point into a sector by rotating it through one of these,
+  rather than working out its polar co-ordinates with trigonometry.
+  Rotations are held as (cos,sin) pairs.
+  Absurd numbers of sectors aren't tabulated: see sector_rotation.
+ */
+inline void sector_rotations(uint n,std::vector<XY>& rotations)
+{
+  rotations.clear();
+  if (n>4096) return;
+  for (uint j=0;j<=n+2;j++)
+    {
+      const real a=j*(M_PI/n);
+      rotations.push_back(XY(cos(a),sin(a)));
+    }
+}
+
+//! Rotation through j*pi/n, from the table built by sector_rotations if it's there.
+inline const XY sector_rotation(const std::vector<XY>& rotations,uint n,uint j)
+{
+  if (j<rotations.size()) return rotations[j];
+  const real a=j*(M_PI/n);
+  return XY(cos(a),sin(a));
+}
+
 //------------------------------------------------------------------------------------------
 
 //! Implements reflection of sampling point about multiple planes
 FUNCTION_BEGIN(FunctionKaleidoscope,1,1,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      const uint n=2+static_cast<uint>(floor(8.0*fabs(param(0))));
+      return arg(0)(fold<XYZ,real>(p));
+    }
 
-      const real a=atan2(p.x(),p.y());
-      const real r=sqrt(p.x()*p.x()+p.y()*p.y());
-      
-      const real sa=trianglef(a,M_PI/n);
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> q(n);
+      for (size_t i=0;i<n;i++)
+	q[i]=fold<XYZ,real>(in[i]);
+      arg(0)(&q[0],out,n);
+    }
 
-      const XYZ s(r*sin(sa),r*cos(sa),p.z());
-      return arg(0)(s);
+ protected:
+
+  //! Tabulate the rotations for the number of sectors.
+  virtual void update_derived()
+    {
+      _n=2+static_cast<uint>(floor(8.0*fabs(param(0))));
+      sector_rotations(_n,_rotations);
+    }
+
+ private:
+
+  //! Reflect and rotate a point into the first sector.
+  /*! The angle a point is folded to is trianglef of its angle, which is reached by
+    reflecting the point into the right half plane and rotating it back through
+    the even multiple of the sector angle below (or, for the reflected half of each pair of sectors, above) it,
+    and reflecting it again in the latter case.
+   */
+  template <typename XYZ,typename real> const XYZ fold(const XYZ& p) const
+    {
+      const real a=fabs(atan2(p.x(),p.y()));
+      const real y=M_PI/_n;
+      const real r=fmod(a,2.0*y);
+      const bool reflect=(r>y);
+      const uint j=2*static_cast<uint>(lround((a-r)/(2.0*y)))+(reflect ? 2 : 0);
+
+      const XY c(sector_rotation(_rotations,_n,j));
+      const real x=fabs(p.x());
+      const real sx=x*c.x()-p.y()*c.y();
+      return XYZ((reflect ? -sx : sx),p.y()*c.x()+x*c.y(),p.z());
     }
+
+  //! Number of sectors.
+  uint _n;
+
+  //! Rotations through multiples of the sector angle.
+  std::vector<XY> _rotations;
   
 FUNCTION_END(FunctionKaleidoscope)
 
@@ -58,14 +121,14 @@ FUNCTION_END(FunctionKaleidoscope)
 FUNCTION_BEGIN(FunctionKaleidoscopeZRotate,2,1,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const uint n=2+static_cast<uint>(floor(8.0*fabs(param(0))));
 
       const real a=atan2(p.x(),p.y());
       const real r=sqrt(p.x()*p.x()+p.y()*p.y());
       
-      const real sa=trianglef(a,M_PI/n)+param(1)*p.z();
+      const real sa=trianglef(a,real(M_PI/n))+param(1)*p.z();
 
       const XYZ s(r*sin(sa),r*cos(sa),0.0);
       return arg(0)(s);
@@ -79,14 +142,14 @@ FUNCTION_END(FunctionKaleidoscopeZRotate)
 FUNCTION_BEGIN(FunctionKaleidoscopeTwist,2,1,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const uint n=2+static_cast<uint>(floor(8.0*fabs(param(0))));
 
       const real a=atan2(p.x(),p.y());
       const real r=sqrt(p.x()*p.x()+p.y()*p.y());
       
-      const real sa=trianglef(a-r*param(1),M_PI/n);
+      const real sa=trianglef(a-r*real(param(1)),real(M_PI/n));
 
       const XYZ s(r*sin(sa),r*cos(sa),p.z());
       return arg(0)(s);
@@ -100,18 +163,48 @@ FUNCTION_END(FunctionKaleidoscopeTwist)
 FUNCTION_BEGIN(FunctionWindmill,1,1,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      const uint n=1+static_cast<uint>(floor(8.0*fabs(param(0))));
+      return arg(0)(fold<XYZ,real>(p));
+    }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> q(n);
+      for (size_t i=0;i<n;i++)
+	q[i]=fold<XYZ,real>(in[i]);
+      arg(0)(&q[0],out,n);
+    }
+
+ protected:
 
+  //! Tabulate the rotations for the number of sectors.
+  virtual void update_derived()
+    {
+      _n=1+static_cast<uint>(floor(8.0*fabs(param(0))));
+      sector_rotations(_n,_rotations);
+    }
+
+ private:
+
+  //! Rotate a point into the first sector, through the multiple of the sector angle below it.
+  template <typename XYZ,typename real> const XYZ fold(const XYZ& p) const
+    {
       const real a=atan2(p.x(),p.y());
-      const real r=sqrt(p.x()*p.x()+p.y()*p.y());
-      
-      const real sa=modulusf(a,M_PI/n);
+      const real y=M_PI/_n;
+      const long k=lround((a-modulusf(a,y))/y);
 
-      const XYZ s(r*sin(sa),r*cos(sa),p.z());
-      return arg(0)(s);
+      XY c(sector_rotation(_rotations,_n,static_cast<uint>(labs(k))));
+      if (k<0) c.y(-c.y());
+      return XYZ(p.x()*c.x()-p.y()*c.y(),p.y()*c.x()+p.x()*c.y(),p.z());
     }
+
+  //! Number of sectors.
+  uint _n;
+
+  //! Rotations through multiples of the sector angle.
+  std::vector<XY> _rotations;
   
 FUNCTION_END(FunctionWindmill)
 
@@ -123,14 +216,14 @@ FUNCTION_END(FunctionWindmill)
 FUNCTION_BEGIN(FunctionWindmillZRotate,2,1,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const uint n=1+static_cast<uint>(floor(8.0*fabs(param(0))));
 
       const real a=atan2(p.x(),p.y());
       const real r=sqrt(p.x()*p.x()+p.y()*p.y());
       
-      const real sa=modulusf(a,M_PI/n)+param(1)*p.z();
+      const real sa=modulusf(a,real(M_PI/n))+param(1)*p.z();
 
       const XYZ s(r*sin(sa),r*cos(sa),0.0);
       return arg(0)(s);
@@ -144,14 +237,14 @@ FUNCTION_END(FunctionWindmillZRotate)
 FUNCTION_BEGIN(FunctionWindmillTwist,2,1,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const uint n=1+static_cast<uint>(floor(8.0*fabs(param(0))));
 
       const real a=atan2(p.x(),p.y());
       const real r=sqrt(p.x()*p.x()+p.y()*p.y());
       
-      const real sa=modulusf(a-r*param(1),M_PI/n);
+      const real sa=modulusf(a-r*real(param(1)),real(M_PI/n));
 
       const XYZ s(r*sin(sa),r*cos(sa),p.z());
       return arg(0)(s);
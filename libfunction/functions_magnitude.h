@@ -35,7 +35,7 @@
 FUNCTION_BEGIN(FunctionMagnitudes,0,3,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(
 		 arg(0)(p).magnitude(),
@@ -52,7 +52,7 @@ FUNCTION_END(FunctionMagnitudes)
 FUNCTION_BEGIN(FunctionMagnitude,3,1,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return arg(0)(p).magnitude()*XYZ(param(0),param(1),param(2));
     }
@@ -29,6 +29,7 @@ out into separate files eventually.
 #include "useful.h"
 
 #include "function_boilerplate.h"
+#include "function_program.h"
 
 //------------------------------------------------------------------------------------------
 
@@ -36,10 +37,16 @@ out into separate files eventually.
 FUNCTION_BEGIN(FunctionCone,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(p.x()*p.z(),p.y()*p.z(),p.z());
     }
+
+  //! Compile to a single instruction.
+  virtual uint compile(FunctionProgram& program,uint input) const
+    {
+      return program.emit_op(FunctionProgram::OpCone,input);
+    }
   
 FUNCTION_END(FunctionCone)
 
@@ -49,7 +56,7 @@ FUNCTION_END(FunctionCone)
 FUNCTION_BEGIN(FunctionExpCone,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real k=exp(p.z());
       return XYZ(p.x()*k,p.y()*k,p.z());
@@ -65,7 +72,7 @@ FUNCTION_END(FunctionExpCone)
 FUNCTION_BEGIN(FunctionSeparateZ,3,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ v=arg(0)(XYZ(p.x(),p.y(),0.0));
       return arg(1)(v+p.z()*XYZ(param(0),param(1),param(2)));
@@ -79,7 +86,7 @@ FUNCTION_END(FunctionSeparateZ)
 FUNCTION_BEGIN(FunctionIterate,0,1,true,FnIterative)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       XYZ ret(p);
       for (uint i=0;i<iterations();i++)
@@ -102,7 +109,7 @@ FUNCTION_END(FunctionIterate)
 FUNCTION_BEGIN(FunctionCellular,0,1,true,FnIterative)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p)
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p)
     {
       return XYZ(0.0,0.0,0.0);
     }
@@ -39,12 +39,24 @@
 FUNCTION_BEGIN(FunctionNoiseOneChannel,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       // Crank up the frequency a bit otherwise don't see much variation in base case
       const real v=_noise(2.0*p);
       return XYZ(v,v,v);
     }
+
+  //! Evaluate function over a run of points.
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<XYZ> p(n);
+      std::vector<real> v(n);
+      for (size_t i=0;i<n;i++)
+	p[i]=2.0*in[i];
+      _noise(&p[0],&v[0],n);
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ::fill(v[i]);
+    }
   
  protected:
   static Noise _noise;
@@ -59,20 +71,23 @@ FUNCTION_END(FunctionNoiseOneChannel)
 FUNCTION_BEGIN(FunctionMultiscaleNoiseOneChannel,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      real t=0.0;
-      real tm=0.0;
-      for (uint i=0;i<8;i++)
-	{
-	  const real k=(1<<i);
-	  const real ik=1.0/k;
-	  t+=ik*_noise(k*p);
-	  tm+=ik;
-	}
-      const real v=t/tm;
+      const real v=_noise.fbm(p,8)/octave_weights(8);
       return XYZ(v,v,v);
     }
+
+  //! Evaluate function over a run of points.
+  /*! All the octaves are summed in a single pass.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<real> v(n);
+      _noise.fbm(in,&v[0],n,8);
+      const real tm=octave_weights(8);
+      for (size_t i=0;i<n;i++)
+	out[i]=XYZ::fill(v[i]/tm);
+    }
   
  protected:
   static Noise _noise;
@@ -87,10 +102,18 @@ FUNCTION_END(FunctionMultiscaleNoiseOneChannel)
 FUNCTION_BEGIN(FunctionNoiseThreeChannel,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ(_noise0(p),_noise1(p),_noise2(p));
     }
+
+  //! Evaluate function over a run of points.
+  /*! All three channels are evaluated in a single pass.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      Noise::evaluate(_noise0,_noise1,_noise2,in,out,n);
+    }
   
  protected:
   static Noise _noise0;
@@ -107,19 +130,20 @@ FUNCTION_END(FunctionNoiseThreeChannel)
 FUNCTION_BEGIN(FunctionMultiscaleNoiseThreeChannel,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
+    {
+      return Noise::fbm(_noise0,_noise1,_noise2,p,8)/octave_weights(8);
+    }
+
+  //! Evaluate function over a run of points.
+  /*! All the octaves of all three channels are summed in a single pass.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
     {
-      XYZ t(0.0,0.0,0.0);
-      real tm=0.0;
-      for (uint i=0;i<8;i++)
-	{
-	  const real k=(1<<i);
-	  const real ik=1.0/k;
-	  const XYZ kp(k*p);
-	  t+=ik*XYZ(_noise0(kp),_noise1(kp),_noise2(kp));
-	  tm+=ik;
-	}
-      return t/tm;
+      Noise::fbm(_noise0,_noise1,_noise2,in,out,n,8);
+      const real tm=octave_weights(8);
+      for (size_t i=0;i<n;i++)
+	out[i]=out[i]/tm;
     }
   
  protected:
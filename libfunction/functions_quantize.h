@@ -37,7 +37,7 @@ FUNCTION_BEGIN(FunctionPixelize,2,0,false,FnStructure)
   //! Evaluate function.
   /*! Quantize coordinates to 2D grid
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ
 	(
@@ -56,7 +56,7 @@ FUNCTION_BEGIN(FunctionVoxelize,3,0,false,FnStructure)
   //! Evaluate function.
   /*! Quantize coordinates to 3D grid.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return XYZ
 	(
@@ -75,7 +75,7 @@ FUNCTION_BEGIN(FunctionPixelizeHex,1,0,false,FnStructure)
   //! Evaluate function.
   /*! Quantize coordinates to 2D hexgrid.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const std::pair<int,int> h=nearest_hex(p.x()/param(0),p.y()/param(0));
       //std::cerr << h.first << " " << h.second << "\n";
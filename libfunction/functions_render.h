@@ -40,7 +40,7 @@
 FUNCTION_BEGIN(FunctionOrthoSphereShaded,3,2,false,FnRender)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real pr2=p.x()*p.x()+p.y()*p.y();
       if (pr2<1.0)
@@ -60,6 +60,11 @@ FUNCTION_BEGIN(FunctionOrthoSphereShaded,3,2,false,FnRender)
 	}
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionOrthoSphereShaded)
 
 //------------------------------------------------------------------------------------------
@@ -73,8 +78,11 @@ FUNCTION_END(FunctionOrthoSphereShaded)
 */
 FUNCTION_BEGIN(FunctionOrthoSphereShadedBumpMapped,3,3,false,FnRender)
 
+  //! Evaluated in double: the bump map is a finite difference over epsilon().
+  static constexpr bool promote_to_double=true;
+
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real pr2=p.x()*p.x()+p.y()*p.y();
       if (pr2<1.0)
@@ -107,7 +115,92 @@ FUNCTION_BEGIN(FunctionOrthoSphereShadedBumpMapped,3,3,false,FnRender)
 	  return arg(0)(p);
 	}
     }
+
+  //! Evaluate function over a run of points.
+  /*! The background, texture and all 4 bump map samples of the points are each evaluated as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<size_t> background;
+      std::vector<XYZ> background_in;
+      std::vector<size_t> sphere;
+      std::vector<XYZ> normals;
+      std::vector<XYZ> tangents;
+      std::vector<XYZ> q;
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ& p=in[i];
+	  const real pr2=p.x()*p.x()+p.y()*p.y();
+	  if (pr2<1.0)
+	    {
+	      const real z=-sqrt(1.0-pr2);
+	      const XYZ normal(p.x(),p.y(),z);
+
+	      // Tangent vectors
+	      const XYZ east((XYZ(0.0,1.0,0.0)*normal).normalised());
+	      const XYZ north(normal*east);
+
+	      sphere.push_back(i);
+	      normals.push_back(normal);
+	      tangents.push_back(east);
+	      tangents.push_back(north);
+	      q.push_back(normal-epsilon()*east);
+	      q.push_back(normal+epsilon()*east);
+	      q.push_back(normal-epsilon()*north);
+	      q.push_back(normal+epsilon()*north);
+	    }
+	  else
+	    {
+	      background.push_back(i);
+	      background_in.push_back(p);
+	    }
+	}
+
+      if (!background.empty())
+	{
+	  std::vector<XYZ> v(background.size());
+	  arg(0)(&background_in[0],&v[0],background.size());
+	  for (size_t j=0;j<background.size();j++)
+	    out[background[j]]=v[j];
+	}
+
+      if (sphere.empty()) return;
+
+      std::vector<XYZ> bump(q.size());
+      evaluate_stencil(2,&q[0],&bump[0],q.size());
+
+      const XYZ lu(param(0),param(1),param(2));
+      const XYZ l(lu.normalised());
+
+      std::vector<XYZ> texture(sphere.size());
+      arg(1)(&normals[0],&texture[0],sphere.size());
+
+      for (size_t j=0;j<sphere.size();j++)
+	{
+	  const XYZ& n=normals[j];
+	  const XYZ& east=tangents[2*j];
+	  const XYZ& north=tangents[2*j+1];
+
+	  const real e0=bump[4*j  ].magnitude2();
+	  const real e1=bump[4*j+1].magnitude2();
+	  const real n0=bump[4*j+2].magnitude2();
+	  const real n1=bump[4*j+3].magnitude2();
+
+	  const real de=(e1-e0)*inv_epsilon2();
+	  const real dn=(n1-n0)*inv_epsilon2();
+
+	  const XYZ perturbed_n((n-east*de-north*dn).normalised());
+
+	  const real i=0.5*(1.0+l%perturbed_n); // In range 0-1
+	  out[sphere[j]]=i*texture[j];
+	}
+    }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionOrthoSphereShadedBumpMapped)
 
 
@@ -121,7 +214,7 @@ FUNCTION_END(FunctionOrthoSphereShadedBumpMapped)
 FUNCTION_BEGIN(FunctionOrthoSphereReflect,0,2,false,FnRender)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real pr2=p.x()*p.x()+p.y()*p.y();
       if (pr2<1.0)
@@ -145,6 +238,11 @@ FUNCTION_BEGIN(FunctionOrthoSphereReflect,0,2,false,FnRender)
 	}
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionOrthoSphereReflect)
 
 //------------------------------------------------------------------------------------------
@@ -157,8 +255,11 @@ FUNCTION_END(FunctionOrthoSphereReflect)
 */
 FUNCTION_BEGIN(FunctionOrthoSphereReflectBumpMapped,0,3,false,FnRender)
 
+  //! Evaluated in double, as FunctionOrthoSphereShadedBumpMapped.
+  static constexpr bool promote_to_double=true;
+
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real pr2=p.x()*p.x()+p.y()*p.y();
       if (pr2<1.0)
@@ -195,7 +296,95 @@ FUNCTION_BEGIN(FunctionOrthoSphereReflectBumpMapped,0,3,false,FnRender)
 	  return arg(0)(p);
 	}
     }
+
+  //! Evaluate function over a run of points.
+  /*! The background, texture and all 4 bump map samples of the points are each evaluated as a single batch.
+   */
+  template <typename XYZ,typename real> void evaluate_batch_generic(const XYZ* in,XYZ* out,size_t n) const
+    {
+      std::vector<size_t> background;
+      std::vector<XYZ> background_in;
+      std::vector<size_t> sphere;
+      std::vector<XYZ> normals;
+      std::vector<XYZ> tangents;
+      std::vector<XYZ> q;
+      for (size_t i=0;i<n;i++)
+	{
+	  const XYZ& p=in[i];
+	  const real pr2=p.x()*p.x()+p.y()*p.y();
+	  if (pr2<1.0)
+	    {
+	      const real z=-sqrt(1.0-pr2);
+	      const XYZ normal(p.x(),p.y(),z);
+
+	      // Tangent vectors
+	      const XYZ east((XYZ(0.0,1.0,0.0)*normal).normalised());
+	      const XYZ north(normal*east);
+
+	      sphere.push_back(i);
+	      normals.push_back(normal);
+	      tangents.push_back(east);
+	      tangents.push_back(north);
+	      q.push_back(normal-epsilon()*east);
+	      q.push_back(normal+epsilon()*east);
+	      q.push_back(normal-epsilon()*north);
+	      q.push_back(normal+epsilon()*north);
+	    }
+	  else
+	    {
+	      background.push_back(i);
+	      background_in.push_back(p);
+	    }
+	}
+
+      if (!background.empty())
+	{
+	  std::vector<XYZ> v(background.size());
+	  arg(0)(&background_in[0],&v[0],background.size());
+	  for (size_t j=0;j<background.size();j++)
+	    out[background[j]]=v[j];
+	}
+
+      if (sphere.empty()) return;
+
+      std::vector<XYZ> bump(q.size());
+      evaluate_stencil(2,&q[0],&bump[0],q.size());
+
+      // The ray _towards_ the viewer is (0 0 -1)
+      const XYZ v(0.0,0.0,-1.0);
+
+      std::vector<XYZ> reflected(sphere.size());
+      for (size_t j=0;j<sphere.size();j++)
+	{
+	  const XYZ& n=normals[j];
+	  const XYZ& east=tangents[2*j];
+	  const XYZ& north=tangents[2*j+1];
+
+	  const real e0=bump[4*j  ].magnitude2();
+	  const real e1=bump[4*j+1].magnitude2();
+	  const real n0=bump[4*j+2].magnitude2();
+	  const real n1=bump[4*j+3].magnitude2();
+
+	  const real de=(e1-e0)*inv_epsilon2();
+	  const real dn=(n1-n0)*inv_epsilon2();
+
+	  const XYZ perturbed_n((n-east*de-north*dn).normalised());
+
+	  // The reflected ray is (2n.v)n-v
+	  reflected[j]=(2.0*(perturbed_n%v))*perturbed_n-v;
+	}
+
+      std::vector<XYZ> environment(sphere.size());
+      arg(1)(&reflected[0],&environment[0],sphere.size());
+      for (size_t j=0;j<sphere.size();j++)
+	out[sphere[j]]=environment[j];
+    }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionOrthoSphereReflectBumpMapped)
 
 //------------------------------------------------------------------------------------------
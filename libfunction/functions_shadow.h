@@ -34,11 +34,19 @@
 FUNCTION_BEGIN(FunctionShadow,4,1,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return
 	arg(0)(p)+param(3)*arg(0)(p+XYZ(param(0),param(1),param(2)));
     }
+
+ protected:
+
+  //! With zero weight this is just the function itself.
+  virtual std::unique_ptr<FunctionNode> optimised()
+    {
+      return (param(3)==0.0 ? take_arg(*this,0) : std::unique_ptr<FunctionNode>());
+    }
   
 FUNCTION_END(FunctionShadow)
 
@@ -48,11 +56,19 @@ FUNCTION_END(FunctionShadow)
 FUNCTION_BEGIN(FunctionShadowGeneralised,1,2,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       return
 	arg(0)(p)+param(0)*arg(0)(p+arg(1)(p));
     }
+
+ protected:
+
+  //! With zero weight this is just the function itself.
+  virtual std::unique_ptr<FunctionNode> optimised()
+    {
+      return (param(0)==0.0 ? take_arg(*this,0) : std::unique_ptr<FunctionNode>());
+    }
   
 FUNCTION_END(FunctionShadowGeneralised)
 
@@ -35,7 +35,7 @@
 FUNCTION_BEGIN(FunctionCartesianToSpherical,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
   {
     const real r=p.magnitude();
     
@@ -54,7 +54,7 @@ FUNCTION_END(FunctionCartesianToSpherical)
 FUNCTION_BEGIN(FunctionSphericalToCartesian,0,0,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
   {
     const real r=p.x();
     const real theta=M_PI*p.y();
@@ -75,7 +75,7 @@ FUNCTION_END(FunctionSphericalToCartesian)
 FUNCTION_BEGIN(FunctionEvaluateInSpherical,0,1,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real in_r=p.magnitude();
       const real in_theta=atan2(p.y(),p.x())*(1.0/M_PI);
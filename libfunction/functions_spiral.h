@@ -34,7 +34,7 @@
 FUNCTION_BEGIN(FunctionSpiralLinear,0,1,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real r=p.magnitude();
       real theta=atan2(p.y(),p.x());
@@ -54,7 +54,7 @@ FUNCTION_END(FunctionSpiralLinear)
 FUNCTION_BEGIN(FunctionSpiralLogarithmic,0,1,false,FnStructure)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const real r=p.magnitude();
       real theta=atan2(p.y(),p.x());
@@ -37,7 +37,7 @@ FUNCTION_BEGIN(FunctionTartanSelectFree,10,6,false,FnStructure)
       2 bits used to select from 4 possibilities.
       There's no guarantee of a repetitive pattern unless the generator functions are.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ p0(p.x(),param(0),param(1));
       const XYZ p1(param(2),p.y(),param(3));
@@ -59,10 +59,10 @@ FUNCTION_BEGIN(FunctionTartanSelect,14,6,false,FnStructure)
   //! Evaluate function.
   /*! Similar to function free except the generators repeat.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      const real x=(param(0)>0.0 ? modulusf(p.x(),param(1)) : trianglef(p.x(),param(1)));
-      const real y=(param(2)>0.0 ? modulusf(p.y(),param(3)) : trianglef(p.y(),param(3)));
+      const real x=(param(0)>0.0 ? modulusf(p.x(),real(param(1))) : trianglef(p.x(),real(param(1))));
+      const real y=(param(2)>0.0 ? modulusf(p.y(),real(param(3))) : trianglef(p.y(),real(param(3))));
       const XYZ p0(x,param(4),param(5));
       const XYZ p1(param(6),y,param(7));
       const XYZ d0(param(8),param(9),param(10));
@@ -83,10 +83,10 @@ FUNCTION_BEGIN(FunctionTartanSelectRepeat,14,6,false,FnStructure)
   //! Evaluate function.
   /*! Similar to above function except the invoked functions repeat too.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      const real x=(param(0)>0.0 ? modulusf(p.x(),param(1)) : trianglef(p.x(),param(1)));
-      const real y=(param(2)>0.0 ? modulusf(p.y(),param(3)) : trianglef(p.y(),param(3)));
+      const real x=(param(0)>0.0 ? modulusf(p.x(),real(param(1))) : trianglef(p.x(),real(param(1))));
+      const real y=(param(2)>0.0 ? modulusf(p.y(),real(param(3))) : trianglef(p.y(),real(param(3))));
       const XYZ p0(x,param(4),param(5));
       const XYZ p1(param(6),y,param(7));
       const XYZ d0(param(8),param(9),param(10));
@@ -107,7 +107,7 @@ FUNCTION_BEGIN(FunctionTartanMixFree,4,2,false,0)
   //! Evaluate function.
   /*! As above, but mix 2 functions.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ p0(p.x(),param(0),param(1));
       const XYZ p1(param(2),p.y(),param(3));
@@ -125,10 +125,10 @@ FUNCTION_BEGIN(FunctionTartanMixRepeat,8,2,false,0)
   //! Evaluate function.
   /*! As above, but mix 2 functions.
    */
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      const real x=(param(0)>0.0 ? modulusf(p.x(),param(1)) : trianglef(p.x(),param(1)));
-      const real y=(param(2)>0.0 ? modulusf(p.y(),param(3)) : trianglef(p.y(),param(3)));
+      const real x=(param(0)>0.0 ? modulusf(p.x(),real(param(1))) : trianglef(p.x(),real(param(1))));
+      const real y=(param(2)>0.0 ? modulusf(p.y(),real(param(3))) : trianglef(p.y(),real(param(3))));
       const XYZ p0(x,param(4),param(5));
       const XYZ p1(param(6),y,param(7));
       const XYZ warp(arg(0)(p0));
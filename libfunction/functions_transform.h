@@ -37,7 +37,7 @@
 FUNCTION_BEGIN(FunctionIsotropicScale,1,0,false,0)
 
   //! Return the evaluation of arg(0) at the transformed position argument.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
   {
     return param(0)*p;
   }
@@ -52,9 +52,9 @@ FUNCTION_END(FunctionIsotropicScale)
 FUNCTION_BEGIN(FunctionPreTransformGeneralised,0,5,false,0)
 
   //! Return the evaluation of arg(0) at the transformed position argument.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      const Transform transform(arg(1)(p),arg(2)(p),arg(3)(p),arg(4)(p));
+      const Transform transform(::XYZ(arg(1)(p)),::XYZ(arg(2)(p)),::XYZ(arg(3)(p)),::XYZ(arg(4)(p)));
       return arg(0)(transform.transformed(p));
     }
 
@@ -68,9 +68,9 @@ FUNCTION_END(FunctionPreTransformGeneralised)
 FUNCTION_BEGIN(FunctionPostTransformGeneralised,0,5,false,0)
 
   //! Return the evaluation of arg(0) at the transformed position argument.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
-      const Transform transform(arg(1)(p),arg(2)(p),arg(3)(p),arg(4)(p));
+      const Transform transform(::XYZ(arg(1)(p)),::XYZ(arg(2)(p)),::XYZ(arg(3)(p)),::XYZ(arg(4)(p)));
       return transform.transformed(arg(0)(p));
     }
 
@@ -84,7 +84,7 @@ FUNCTION_END(FunctionPostTransformGeneralised)
 FUNCTION_BEGIN(FunctionTransformQuadratic,30,0,false,0)
 
   //! Return p transformed.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ translate(param( 0),param( 1),param( 2));
       const XYZ basis_x  (param( 3),param( 4),param( 5));
@@ -111,7 +111,7 @@ FUNCTION_END(FunctionTransformQuadratic)
 FUNCTION_BEGIN(FunctionRotate,0,1,false,0)
 
   //! Evaluate function.
-  virtual const XYZ evaluate(const XYZ& p) const
+  template <typename XYZ,typename real> const XYZ evaluate_generic(const XYZ& p) const
     {
       const XYZ a(arg(0)(p)*M_PI);
       
@@ -122,6 +122,11 @@ FUNCTION_BEGIN(FunctionRotate,0,1,false,0)
       return rx*(ry*(rz*p));
     }
   
+  virtual bool is_constant() const
+    {
+      return false;
+    }
+
 FUNCTION_END(FunctionRotate)
 
 //------------------------------------------------------------------------------------------
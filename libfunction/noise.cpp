@@ -25,6 +25,7 @@
 
 #include "noise.h"
 #include "random.h"
+#include "simd_kernels.h"
 
 Noise::Noise(uint seed)
 {
@@ -37,92 +38,124 @@ Noise::Noise(uint seed)
   int i;
   
   for (i=0;i<N;i++)
-    _g[i]=RandomXYZSphereNormal(r_01);
+    {
+      const XYZ g=RandomXYZSphereNormal(r_01);
+      _g[4*i  ]=g.x();
+      _g[4*i+1]=g.y();
+      _g[4*i+2]=g.z();
+      _g[4*i+3]=0.0;
+    }
   
   // Create a pseudorandom permutation of [1..B] 
+
+  int p[N+1];
   
   for (i=0;i<=N;i++)
-    _p[i]=i;
+    p[i]=i;
   
   for (i=N;i>0;i-=2) 
     {
       int j=((int)(r_01()*N));
-      int k=_p[i];
-      _p[i]=_p[j];
-      _p[j]=k;
+      int k=p[i];
+      p[i]=p[j];
+      p[j]=k;
     }
   
-  // Extend g and p arrays to allow for faster indexing
+  // The classic generator extends the table by repeating the first entries (overwriting entry N),
+  // and every entry is only ever used modulo N.
   
-  for (i=0;i<N+2;i++)
-    {
-      _p[N+i]=_p[i];
-      _g[N+i]=_g[i];
-    }
+  for (i=0;i<N;i++)
+    _p[i]=(p[i]&(N-1));
 }
 
-inline real value(const XYZ& q,real rx,real ry,real rz)
+template <typename T> T Noise::operator()(const BasicXYZ<T>& p) const
 {
-  return rx*q.x()+ry*q.y()+rz*q.z();
+  return fbm(p,1);
 }
 
-inline real surve(real t)
+template <typename T> void Noise::operator()(const BasicXYZ<T>* p,T* d,size_t n) const
 {
-  return t*t*(3.0-2.0*t);
+  fbm(p,d,n,1);
 }
 
-inline real lerp(real t,real a,real b)
+template <typename T> void Noise::evaluate(const Noise& x,const Noise& y,const Noise& z,const BasicXYZ<T>* p,BasicXYZ<T>* d,size_t n)
 {
-  return a+t*(b-a);
+  fbm(x,y,z,p,d,n,1);
 }
 
-real Noise::operator()(const XYZ& p) const
+template <typename T> T Noise::fbm(const BasicXYZ<T>& p,uint octaves) const
 {
-  // Crank up the frequency a bit otherwise don't see much variation in base case
-  const real tx=2.0*p.x()+10000.0;
-  const real ty=2.0*p.y()+10000.0;
-  const real tz=2.0*p.z()+10000.0;
-  
-  const int itx=(int)tx;
-  const int ity=(int)ty;
-  const int itz=(int)tz;
-
-  const real rx0=tx-itx;
-  const real ry0=ty-ity;
-  const real rz0=tz-itz;
-
-  const real rx1=rx0-1.0;
-  const real ry1=ry0-1.0;
-  const real rz1=rz0-1.0;
-
-  const int bx0=(itx&(N-1));
-  const int bx1=((bx0+1)&(N-1));
-  const int by0=(ity&(N-1));
-  const int by1=((by0+1)&(N-1));
-  const int bz0=(itz&(N-1));
-  const int bz1=((bz0+1)&(N-1));
-      
-  const int i=_p[bx0];
-  const int b00=_p[i+by0];
-  const int b01=_p[i+by1];
-      
-  const int j=_p[bx1];
-  const int b10=_p[j+by0];
-  const int b11=_p[j+by1];
-  
-  const real sx=surve(rx0);
+  const int* permutations=_p;
+  const real* gradients=_g;
+  const real a[3]={p.x(),p.y(),p.z()};
+  real v;
+  SimdKernels::scalar().noise(&permutations,&gradients,1,octaves,a,&v,1);
+  return v;
+}
+
+//! Lay out n points structure-of-arrays (and in double), as the kernels want them.
+template <typename T> static void split(const BasicXYZ<T>* p,size_t n,std::vector<real>& a)
+{
+  a.resize(3*n);
+  for (size_t i=0;i<n;i++)
+    {
+      a[i]=p[i].x();
+      a[n+i]=p[i].y();
+      a[2*n+i]=p[i].z();
+    }
+}
 
-  const real a0=lerp(sx,value(_g[b00+bz0],rx0,ry0,rz0),value(_g[b10+bz0],rx1,ry0,rz0));
-  const real b0=lerp(sx,value(_g[b01+bz0],rx0,ry1,rz0),value(_g[b11+bz0],rx1,ry1,rz0));
-  const real a1=lerp(sx,value(_g[b00+bz1],rx0,ry0,rz1),value(_g[b10+bz1],rx1,ry0,rz1));
-  const real b1=lerp(sx,value(_g[b01+bz1],rx0,ry1,rz1),value(_g[b11+bz1],rx1,ry1,rz1));
+template <typename T> void Noise::fbm(const BasicXYZ<T>* p,T* d,size_t n,uint octaves) const
+{
+  if (n==0) return;
 
-  const real sy=surve(ry0);
-      
-  const real c=lerp(sy,a0,b0);  
-  const real d=lerp(sy,a1,b1);
+  std::vector<real> a;
+  split(p,n,a);
 
-  const real sz=surve(rz0);
-  
-  return 1.5*lerp(sz,c,d);
+  const int* permutations=_p;
+  const real* gradients=_g;
+  std::vector<real> v(n);
+  SimdKernels::best().noise(&permutations,&gradients,1,octaves,&a[0],&v[0],n);
+  std::copy(v.begin(),v.end(),d);
 }
+
+template <typename T> const BasicXYZ<T> Noise::fbm(const Noise& x,const Noise& y,const Noise& z,const BasicXYZ<T>& p,uint octaves)
+{
+  const int*const permutations[3]={x._p,y._p,z._p};
+  const real*const gradients[3]={x._g,y._g,z._g};
+  const real a[3]={p.x(),p.y(),p.z()};
+  real v[3];
+  SimdKernels::scalar().noise(permutations,gradients,3,octaves,a,v,1);
+  return BasicXYZ<T>(v[0],v[1],v[2]);
+}
+
+template <typename T> void Noise::fbm(const Noise& x,const Noise& y,const Noise& z,const BasicXYZ<T>* p,BasicXYZ<T>* d,size_t n,uint octaves)
+{
+  if (n==0) return;
+
+  std::vector<real> a;
+  split(p,n,a);
+
+  const int*const permutations[3]={x._p,y._p,z._p};
+  const real*const gradients[3]={x._g,y._g,z._g};
+  std::vector<real> v(3*n);
+  SimdKernels::best().noise(permutations,gradients,3,octaves,&a[0],&v[0],n);
+
+  for (size_t i=0;i<n;i++)
+    d[i]=BasicXYZ<T>(v[i],v[n+i],v[2*n+i]);
+}
+
+template float Noise::operator()<float>(const XYZf& p) const;
+template double Noise::operator()<double>(const XYZ& p) const;
+template void Noise::operator()<float>(const XYZf* p,float* d,size_t n) const;
+template void Noise::operator()<double>(const XYZ* p,double* d,size_t n) const;
+template void Noise::evaluate<float>(const Noise& x,const Noise& y,const Noise& z,const XYZf* p,XYZf* d,size_t n);
+template void Noise::evaluate<double>(const Noise& x,const Noise& y,const Noise& z,const XYZ* p,XYZ* d,size_t n);
+template float Noise::fbm<float>(const XYZf& p,uint octaves) const;
+template double Noise::fbm<double>(const XYZ& p,uint octaves) const;
+template void Noise::fbm<float>(const XYZf* p,float* d,size_t n,uint octaves) const;
+template void Noise::fbm<double>(const XYZ* p,double* d,size_t n,uint octaves) const;
+template const XYZf Noise::fbm<float>(const Noise& x,const Noise& y,const Noise& z,const XYZf& p,uint octaves);
+template const XYZ Noise::fbm<double>(const Noise& x,const Noise& y,const Noise& z,const XYZ& p,uint octaves);
+template void Noise::fbm<float>(const Noise& x,const Noise& y,const Noise& z,const XYZf* p,XYZf* d,size_t n,uint octaves);
+template void Noise::fbm<double>(const Noise& x,const Noise& y,const Noise& z,const XYZ* p,XYZ* d,size_t n,uint octaves);
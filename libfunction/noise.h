@@ -29,6 +29,12 @@
 #include "xyz.h"
 
 //! Perlin noise generator.
+/*! The tables are compacted to Noise::N entries (the classic generator's are extended to 2N+2 to save reducing indices),
+  with the gradients padded to 4 components, so they suit the vector kernels.
+  Values are the same as the classic generator's for the same seed, so saved images don't change.
+  The methods are instantiated for float and double points, but noise is always computed in double:
+  the lattice is offset by 10000, which float can only resolve to about a thousandth.
+ */
 class Noise
 {
 public:
@@ -36,16 +42,39 @@ public:
   Noise(uint seed);
 
   //! Return noise value at a point.
-  real operator()(const XYZ& p) const;
-  
-protected:
+  template <typename T> T operator()(const BasicXYZ<T>& p) const;
+
+  //! Set d[i] to the noise value at p[i] for n points.
+  template <typename T> void operator()(const BasicXYZ<T>* p,T* d,size_t n) const;
+
+  //! Set the components of d[i] to the noise values of three generators at p[i] for n points, in a single pass.
+  template <typename T> static void evaluate(const Noise& x,const Noise& y,const Noise& z,const BasicXYZ<T>* p,BasicXYZ<T>* d,size_t n);
+
+  //! Return the fractal (fBm) sum of octaves o of noise(2^o*p)/2^o at a point.
+  /*! The octaves are summed in a single fused pass, sharing the work of each octave between channels
+    rather than going back to the tables for each octave in turn.
+    Not normalised, so with a single octave this is just noise.
+   */
+  template <typename T> T fbm(const BasicXYZ<T>& p,uint octaves) const;
+
+  //! Set d[i] to the fractal sum of octaves at p[i] for n points.
+  template <typename T> void fbm(const BasicXYZ<T>* p,T* d,size_t n,uint octaves) const;
+
+  //! Return the fractal sums of octaves of three generators at a point.
+  template <typename T> static const BasicXYZ<T> fbm(const Noise& x,const Noise& y,const Noise& z,const BasicXYZ<T>& p,uint octaves);
+
+  //! Set the components of d[i] to the fractal sums of octaves of three generators at p[i] for n points, in a single pass.
+  template <typename T> static void fbm(const Noise& x,const Noise& y,const Noise& z,const BasicXYZ<T>* p,BasicXYZ<T>* d,size_t n,uint octaves);
+
   //! Number of table entries.
   enum {N=256};
-  
-  int _p[N+N+2];
-  XYZ _g[N+N+2];
-  
-  //void setup(const XYZ&,int,int&,int&,real&,real&);
+
+protected:
+  //! Permutation table, reduced modulo N.
+  int _p[N];
+
+  //! Gradients, padded to 4 components.
+  real _g[4*N];
 };
 
 #endif
@@ -0,0 +1,296 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Implementation of struct SimdKernels and the scalar kernels.
+*/
+
+#include "simd_kernels.h"
+
+#ifdef SIMD_KERNELS_X86
+//@{
+//! Defined by the per-instruction-set translation units.
+extern const SimdKernels simd_kernels_sse2;
+extern const SimdKernels simd_kernels_avx2;
+//@}
+#endif
+
+namespace
+{
+  template <typename T> void scalar_add(const T* a,const T* b,T* d,size_t m)
+  {
+    for (size_t i=0;i<m;i++)
+      d[i]=a[i]+b[i];
+  }
+
+  template <typename T> void scalar_multiply(const T* a,const T* b,T* d,size_t m)
+  {
+    for (size_t i=0;i<m;i++)
+      d[i]=a[i]*b[i];
+  }
+
+  template <typename T> void scalar_divide(const T* a,const T* b,T* d,size_t m)
+  {
+    for (size_t i=0;i<m;i++)
+      d[i]=(b[i]==T(0) ? T(0) : a[i]/b[i]);
+  }
+
+  template <typename T> void scalar_maximum(const T* a,const T* b,T* d,size_t m)
+  {
+    for (size_t i=0;i<m;i++)
+      d[i]=std::max(a[i],b[i]);
+  }
+
+  template <typename T> void scalar_minimum(const T* a,const T* b,T* d,size_t m)
+  {
+    for (size_t i=0;i<m;i++)
+      d[i]=std::min(a[i],b[i]);
+  }
+
+  template <typename T> void scalar_exp(const T* a,T* d,size_t m)
+  {
+    for (size_t i=0;i<m;i++)
+      d[i]=std::exp(a[i]);
+  }
+
+  template <typename T> void scalar_sin(const T* a,T* d,size_t m)
+  {
+    for (size_t i=0;i<m;i++)
+      d[i]=std::sin(a[i]);
+  }
+
+  template <typename T> void scalar_cos(const T* a,T* d,size_t m)
+  {
+    for (size_t i=0;i<m;i++)
+      d[i]=std::cos(a[i]);
+  }
+
+  template <typename T> void scalar_transform(const T* k,const T* a,T* d,size_t n)
+  {
+    for (size_t i=0;i<n;i++)
+      {
+	const T px=a[i];
+	const T py=a[n+i];
+	const T pz=a[2*n+i];
+	d[i]    =k[0]+k[3]*px+k[6]*py+k[ 9]*pz;
+	d[n+i]  =k[1]+k[4]*px+k[7]*py+k[10]*pz;
+	d[2*n+i]=k[2]+k[5]*px+k[8]*py+k[11]*pz;
+      }
+  }
+
+  template <typename T> void scalar_cone(const T* a,T* d,size_t n)
+  {
+    for (size_t i=0;i<n;i++)
+      {
+	const T pz=a[2*n+i];
+	d[i]=a[i]*pz;
+	d[n+i]=a[n+i]*pz;
+	d[2*n+i]=pz;
+      }
+  }
+
+  template <typename T> void scalar_escape_time(const T* z,const T* c,uint iterations,uint* d,size_t m)
+  {
+    for (size_t k=0;k<m;k++)
+      {
+	T zr=z[k];
+	T zi=z[m+k];
+	const T cr=c[k];
+	const T ci=c[m+k];
+
+	// Mandelbrot points in the main cardioid or the period 2 bulb never escape.
+	const T qr=cr-T(0.25);
+	const T q=qr*qr+ci*ci;
+	if (zr==T(0) && zi==T(0) && (q*(q+qr)<T(0.25)*ci*ci || (cr+T(1))*(cr+T(1))+ci*ci<T(0.0625)))
+	  {
+	    d[k]=iterations;
+	    continue;
+	  }
+
+	// Brent's cycle detection: compare with the point saved at the last power of two iterations.
+	T sr=zr;
+	T si=zi;
+	uint i;
+	for (i=0;i<iterations;i++)
+	  {
+	    const T zr2=zr*zr;
+	    const T zi2=zi*zi;
+
+	    if (zr2+zi2>T(4))
+	      break;
+
+	    const T nzr=zr2-zi2+cr;
+	    const T nzi=T(2)*zr*zi+ci;
+
+	    zr=nzr;
+	    zi=nzi;
+
+	    if (zr==sr && zi==si)
+	      {
+		i=iterations;
+		break;
+	      }
+
+	    if (((i+1)&i)==0)
+	      {
+		sr=zr;
+		si=zi;
+	      }
+	  }
+	d[k]=i;
+      }
+  }
+
+  //@{
+  //! Helpers for noise.
+  inline double noise_value(const double* g,double rx,double ry,double rz)
+  {
+    return rx*g[0]+ry*g[1]+rz*g[2];
+  }
+
+  inline double noise_surve(double t)
+  {
+    return t*t*(3.0-2.0*t);
+  }
+
+  inline double noise_lerp(double t,double a,double b)
+  {
+    return a+t*(b-a);
+  }
+  //@}
+
+  void scalar_noise(const int*const* permutations,const double*const* gradients,uint channels,uint octaves,const double* a,double* d,size_t n)
+  {
+    const int M=255;
+    for (size_t k=0;k<n;k++)
+      for (uint o=0;o<octaves;o++)
+	{
+	  const double scale=(1<<o);
+	  const double iscale=1.0/scale;
+
+	  // Crank up the frequency a bit otherwise don't see much variation in base case
+	  const double tx=2.0*(scale*a[k])+10000.0;
+	  const double ty=2.0*(scale*a[n+k])+10000.0;
+	  const double tz=2.0*(scale*a[2*n+k])+10000.0;
+
+	  const int itx=(int)tx;
+	  const int ity=(int)ty;
+	  const int itz=(int)tz;
+
+	  const double rx0=tx-itx;
+	  const double ry0=ty-ity;
+	  const double rz0=tz-itz;
+
+	  const double rx1=rx0-1.0;
+	  const double ry1=ry0-1.0;
+	  const double rz1=rz0-1.0;
+
+	  const int bx0=(itx&M);
+	  const int bx1=((bx0+1)&M);
+	  const int by0=(ity&M);
+	  const int by1=((by0+1)&M);
+	  const int bz0=(itz&M);
+	  const int bz1=((bz0+1)&M);
+
+	  const double sx=noise_surve(rx0);
+	  const double sy=noise_surve(ry0);
+	  const double sz=noise_surve(rz0);
+
+	  for (uint c=0;c<channels;c++)
+	    {
+	      const int* p=permutations[c];
+	      const double* g=gradients[c];
+
+	      const int i=p[bx0];
+	      const int b00=p[(i+by0)&M];
+	      const int b01=p[(i+by1)&M];
+
+	      const int j=p[bx1];
+	      const int b10=p[(j+by0)&M];
+	      const int b11=p[(j+by1)&M];
+
+	      const double a0=noise_lerp(sx,noise_value(g+4*((b00+bz0)&M),rx0,ry0,rz0),noise_value(g+4*((b10+bz0)&M),rx1,ry0,rz0));
+	      const double b0=noise_lerp(sx,noise_value(g+4*((b01+bz0)&M),rx0,ry1,rz0),noise_value(g+4*((b11+bz0)&M),rx1,ry1,rz0));
+	      const double a1=noise_lerp(sx,noise_value(g+4*((b00+bz1)&M),rx0,ry0,rz1),noise_value(g+4*((b10+bz1)&M),rx1,ry0,rz1));
+	      const double b1=noise_lerp(sx,noise_value(g+4*((b01+bz1)&M),rx0,ry1,rz1),noise_value(g+4*((b11+bz1)&M),rx1,ry1,rz1));
+
+	      const double v=1.5*noise_lerp(sz,noise_lerp(sy,a0,b0),noise_lerp(sy,a1,b1));
+	      d[c*n+k]=(o==0 ? v : d[c*n+k]+iscale*v);
+	    }
+	}
+  }
+
+  const SimdKernels simd_kernels_scalar=
+    {
+      "scalar",
+      {
+	1,
+	scalar_add<double>,scalar_multiply<double>,scalar_divide<double>,scalar_maximum<double>,scalar_minimum<double>,
+	scalar_exp<double>,scalar_sin<double>,scalar_cos<double>,
+	scalar_transform<double>,scalar_cone<double>,
+	scalar_escape_time<double>
+      },
+      {
+	1,
+	scalar_add<float>,scalar_multiply<float>,scalar_divide<float>,scalar_maximum<float>,scalar_minimum<float>,
+	scalar_exp<float>,scalar_sin<float>,scalar_cos<float>,
+	scalar_transform<float>,scalar_cone<float>,
+	scalar_escape_time<float>
+      },
+      scalar_noise
+    };
+
+  const SimdKernels& choose_best()
+  {
+    const SimdKernels& chosen=(SimdKernels::avx2() ? *SimdKernels::avx2() : SimdKernels::sse2() ? *SimdKernels::sse2() : SimdKernels::scalar());
+    std::clog << "Using " << chosen.name << " function kernels\n";
+    return chosen;
+  }
+}
+
+const SimdKernels& SimdKernels::scalar()
+{
+  return simd_kernels_scalar;
+}
+
+const SimdKernels* SimdKernels::sse2()
+{
+#ifdef SIMD_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) return &simd_kernels_sse2;
+#endif
+  return 0;
+}
+
+const SimdKernels* SimdKernels::avx2()
+{
+#ifdef SIMD_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return &simd_kernels_avx2;
+#endif
+  return 0;
+}
+
+const SimdKernels& SimdKernels::best()
+{
+  // Function-local static initialisation is thread safe, so this is only decided once.
+  static const SimdKernels& chosen=choose_best();
+  return chosen;
+}
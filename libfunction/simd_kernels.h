@@ -0,0 +1,138 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Interface for struct SimdKernels.
+*/
+
+#ifndef _simd_kernels_h_
+#define _simd_kernels_h_
+
+#include "useful.h"
+
+//! Whether the SSE2 and AVX2 kernel sets are compiled in.
+/*! They rely on the gcc/clang vector extensions and target pragmas, so other compilers just get the scalar kernels.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_KERNELS_X86 1
+#endif
+
+//! Tables of batch kernels for the function program interpreter, one instance per instruction set.
+/*! There is a table of kernels for each scalar type the program can be run in.
+  The componentwise kernels work on arrays of m scalars.
+  transform and cone work on blocks of n points laid out structure-of-arrays:
+  all n x components, then all the y components, then all the z components
+  (as in an XYZBlock, whose data can be passed with n the block's stride).
+  Arrays need not be aligned, and the destination must not overlap the sources.
+
+  The scalar kernels call the C library (in the precision of the scalar type) and are the reference.
+  The vector kernels (including escape_time's counts, and noise) are bit identical to them for everything except the transcendentals,
+  which use the Cephes polynomial approximations:
+  exp is within 2 ulp of the C library's result, and sin and cos within 2.3e-16 (double) or 6e-8 (float) absolute.
+  sin and cos fall back to the C library for lanes with |x|>=2^30 (double) or |x|>=8192 (float),
+  where the argument reduction gets inaccurate.
+ */
+struct SimdKernels
+{
+  //! The kernels for one scalar type.
+  template <typename T> struct Table
+  {
+    //! Number of scalars processed per instruction.
+    uint width;
+
+    //@{
+    //! d[i]=a[i] op b[i] for m scalars, with the same semantics as the scalar function nodes.
+    void (*add)(const T* a,const T* b,T* d,size_t m);
+    void (*multiply)(const T* a,const T* b,T* d,size_t m);
+    void (*divide)(const T* a,const T* b,T* d,size_t m);
+    void (*maximum)(const T* a,const T* b,T* d,size_t m);
+    void (*minimum)(const T* a,const T* b,T* d,size_t m);
+    //@}
+
+    //@{
+    //! d[i]=fn(a[i]) for m scalars.
+    void (*exp)(const T* a,T* d,size_t m);
+    void (*sin)(const T* a,T* d,size_t m);
+    void (*cos)(const T* a,T* d,size_t m);
+    //@}
+
+    //! Transform a block of n points by the 12 column-wise transform components in k (same order of operations as Transform::transformed).
+    void (*transform)(const T* k,const T* a,T* d,size_t n);
+
+    //! Apply FunctionCone to a block of n points.
+    void (*cone)(const T* a,T* d,size_t n);
+
+    //! Escape time of z->z*z+c for m points: d[i] is the number of iterations before |z|>2, or iterations if that isn't reached.
+    /*! z holds the m starting points' real parts then their imaginary parts, and c the same for the constants.
+      Points are iterated a vector at a time until every lane has escaped.
+      Orbits which return exactly to an earlier point, and Mandelbrot orbits (z starting at 0) with c in the main cardioid or period 2 bulb,
+      never escape, so they stop early.
+     */
+    void (*escape_time)(const T* z,const T* c,uint iterations,uint* d,size_t m);
+  };
+
+  //! Instruction set name, for logging.
+  const char* name;
+
+  //! Kernels for double precision.
+  Table<double> double_table;
+
+  //! Kernels for single precision.
+  Table<float> float_table;
+
+  //! Gradient noise (as Noise) summed over octaves at a block of n points, for each of a number of channels with their own tables.
+  /*! a holds the n points laid out structure-of-arrays (as for transform), and d is set to the n values of each channel in turn.
+    Each value is the sum over octaves o of noise(2^o*a)/2^o, accumulated in order of increasing o
+    (so octaves=1 is plain noise).
+    Each channel has a table of Noise::N permutation entries (reduced modulo Noise::N) and a table of Noise::N gradients,
+    each padded to 4 components.
+    The lattice cell and interpolation weights of each point and octave are shared by all the channels.
+    Only double precision is supported: Noise computes in double even when the nodes are evaluated in single precision.
+    The AVX2 version looks up the tables with gathers; the SSE2 one is just the scalar kernel, as without gathers it's no faster.
+   */
+  void (*noise)(const int*const* permutations,const double*const* gradients,uint channels,uint octaves,const double* a,double* d,size_t n);
+
+  //! The kernels for scalar type T.
+  template <typename T> const Table<T>& table() const;
+
+  //! The portable kernels.
+  static const SimdKernels& scalar();
+
+  //! The SSE2 kernels, or null if not compiled in or not supported by this CPU.
+  static const SimdKernels* sse2();
+
+  //! The AVX2 kernels, or null if not compiled in or not supported by this CPU.
+  static const SimdKernels* avx2();
+
+  //! The widest kernels supported by this CPU, chosen on first use.
+  static const SimdKernels& best();
+};
+
+template <> inline const SimdKernels::Table<double>& SimdKernels::table<double>() const
+{
+  return double_table;
+}
+
+template <> inline const SimdKernels::Table<float>& SimdKernels::table<float>() const
+{
+  return float_table;
+}
+
+#endif
@@ -0,0 +1,194 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief The AVX2 SimdKernels.
+*/
+
+#include "simd_kernels.h"
+
+#include <cstring>
+
+#include <immintrin.h>
+
+#ifdef SIMD_KERNELS_X86
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))),apply_to=function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace
+{
+  typedef double VD __attribute__((vector_size(32)));
+  typedef long long ID __attribute__((vector_size(32)));
+  typedef float VF __attribute__((vector_size(32)));
+  typedef int IF __attribute__((vector_size(32)));
+}
+
+#include "simd_kernels_generic.h"
+
+namespace
+{
+  //! Gradient noise, 4 points at a time.
+  /*! The lattice hashing and gradient lookups use the AVX2 gathers;
+    the arithmetic is the same operations as the scalar kernel's, so the results are identical.
+    The points and the sums stay in registers while all the octaves and channels are summed.
+   */
+  void kernel_noise(const int*const* permutations,const double*const* gradients,uint channels,uint octaves,const double* a,double* d,size_t n)
+  {
+    const __m128i mask=_mm_set1_epi32(255);
+    const __m128i one=_mm_set1_epi32(1);
+    const __m256d all=_mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    for (size_t k=0;k<n;k+=4)
+      {
+	const size_t w=(n-k<4 ? n-k : 4);
+	VD x;
+	VD y;
+	VD z;
+	if (w==4)
+	  {
+	    x=load(a+k);
+	    y=load(a+n+k);
+	    z=load(a+2*n+k);
+	  }
+	else
+	  {
+	    double t[3][4]={};
+	    memcpy(t[0],a+k,w*sizeof(double));
+	    memcpy(t[1],a+n+k,w*sizeof(double));
+	    memcpy(t[2],a+2*n+k,w*sizeof(double));
+	    x=load(t[0]);
+	    y=load(t[1]);
+	    z=load(t[2]);
+	  }
+
+	// Channels are summed in groups of 4, so the sums stay in registers.
+	for (uint c0=0;c0<channels;c0+=4)
+	  {
+	    const uint cn=(channels-c0<4 ? channels-c0 : 4);
+	    VD sum[4];
+	    for (uint o=0;o<octaves;o++)
+	      {
+		const double scale=(1<<o);
+		const double iscale=1.0/scale;
+
+		const VD tx=2.0*(scale*x)+10000.0;
+		const VD ty=2.0*(scale*y)+10000.0;
+		const VD tz=2.0*(scale*z)+10000.0;
+
+		// Truncated towards zero, as by the scalar kernel's conversion to int.
+		const __m128i itx=_mm256_cvttpd_epi32((__m256d)tx);
+		const __m128i ity=_mm256_cvttpd_epi32((__m256d)ty);
+		const __m128i itz=_mm256_cvttpd_epi32((__m256d)tz);
+
+		const VD rx0=tx-(VD)_mm256_cvtepi32_pd(itx);
+		const VD ry0=ty-(VD)_mm256_cvtepi32_pd(ity);
+		const VD rz0=tz-(VD)_mm256_cvtepi32_pd(itz);
+
+		const VD rx1=rx0-1.0;
+		const VD ry1=ry0-1.0;
+		const VD rz1=rz0-1.0;
+
+		const __m128i bx0=_mm_and_si128(itx,mask);
+		const __m128i bx1=_mm_and_si128(_mm_add_epi32(bx0,one),mask);
+		const __m128i by0=_mm_and_si128(ity,mask);
+		const __m128i by1=_mm_and_si128(_mm_add_epi32(by0,one),mask);
+		const __m128i bz0=_mm_and_si128(itz,mask);
+		const __m128i bz1=_mm_and_si128(_mm_add_epi32(bz0,one),mask);
+
+		const VD sx=rx0*rx0*(3.0-2.0*rx0);
+		const VD sy=ry0*ry0*(3.0-2.0*ry0);
+		const VD sz=rz0*rz0*(3.0-2.0*rz0);
+
+		for (uint c=0;c<cn;c++)
+		  {
+		    const int* p=permutations[c0+c];
+		    const double* g=gradients[c0+c];
+
+		    const __m128i i=_mm_i32gather_epi32(p,bx0,4);
+		    const __m128i b00=_mm_i32gather_epi32(p,_mm_and_si128(_mm_add_epi32(i,by0),mask),4);
+		    const __m128i b01=_mm_i32gather_epi32(p,_mm_and_si128(_mm_add_epi32(i,by1),mask),4);
+
+		    const __m128i j=_mm_i32gather_epi32(p,bx1,4);
+		    const __m128i b10=_mm_i32gather_epi32(p,_mm_and_si128(_mm_add_epi32(j,by0),mask),4);
+		    const __m128i b11=_mm_i32gather_epi32(p,_mm_and_si128(_mm_add_epi32(j,by1),mask),4);
+
+		    // Corners in the order 000, 100, 010, 110, 001, 101, 011, 111 (x, y, z).
+		    const __m128i corner[8]=
+		      {
+			_mm_add_epi32(b00,bz0),_mm_add_epi32(b10,bz0),_mm_add_epi32(b01,bz0),_mm_add_epi32(b11,bz0),
+			_mm_add_epi32(b00,bz1),_mm_add_epi32(b10,bz1),_mm_add_epi32(b01,bz1),_mm_add_epi32(b11,bz1)
+		      };
+
+		    VD v[8];
+		    for (uint q=0;q<8;q++)
+		      {
+			// Gradients are 4 components apart.
+			const __m128i offset=_mm_slli_epi32(_mm_and_si128(corner[q],mask),2);
+			const VD gx=(VD)_mm256_mask_i32gather_pd(_mm256_setzero_pd(),g  ,offset,all,8);
+			const VD gy=(VD)_mm256_mask_i32gather_pd(_mm256_setzero_pd(),g+1,offset,all,8);
+			const VD gz=(VD)_mm256_mask_i32gather_pd(_mm256_setzero_pd(),g+2,offset,all,8);
+			v[q]=((q&1) ? rx1 : rx0)*gx+((q&2) ? ry1 : ry0)*gy+((q&4) ? rz1 : rz0)*gz;
+		      }
+
+		    const VD a0=v[0]+sx*(v[1]-v[0]);
+		    const VD b0=v[2]+sx*(v[3]-v[2]);
+		    const VD a1=v[4]+sx*(v[5]-v[4]);
+		    const VD b1=v[6]+sx*(v[7]-v[6]);
+
+		    const VD e=a0+sy*(b0-a0);
+		    const VD f=a1+sy*(b1-a1);
+
+		    const VD r=1.5*(e+sz*(f-e));
+		    sum[c]=(o==0 ? r : sum[c]+iscale*r);
+		  }
+	      }
+
+	    for (uint c=0;c<cn;c++)
+	      {
+		double t[4];
+		store(t,sum[c]);
+		memcpy(d+(c0+c)*n+k,t,w*sizeof(double));
+	      }
+	  }
+      }
+  }
+}
+
+extern const SimdKernels simd_kernels_avx2;
+
+const SimdKernels simd_kernels_avx2=
+  {
+    "AVX2",
+    SIMD_KERNELS_TABLE(double),
+    SIMD_KERNELS_TABLE(float),
+    kernel_noise
+  };
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,476 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief Vector kernel bodies shared by the per-instruction-set SimdKernels translation units.
+
+  This is deliberately not a normal header: it is included once, after all other headers,
+  by each of simd_kernels_sse2.cpp and simd_kernels_avx2.cpp while a target pragma is in force,
+  so the same source compiles to different instructions in each.
+  The including file must first define the vector types VD and VF (doubles and floats filling a vector register)
+  and ID and IF (integers of the same sizes).
+  Everything is in an anonymous namespace so the differently compiled copies can't be confused by the linker,
+  and nothing here instantiates library templates (which would be shared between the copies).
+*/
+
+namespace
+{
+  //! Vector types and constants for each scalar type.
+  template <typename T> struct Lanes;
+
+  template <> struct Lanes<double>
+  {
+    typedef VD V;
+    typedef ID I;
+    enum {W=sizeof(VD)/sizeof(double)};
+  };
+
+  template <> struct Lanes<float>
+  {
+    typedef VF V;
+    typedef IF I;
+    enum {W=sizeof(VF)/sizeof(float)};
+  };
+
+  //@{
+  //! Unaligned access to a vector's worth of scalars.
+  template <typename T> inline typename Lanes<T>::V load(const T* p)
+  {
+    typename Lanes<T>::V v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+  }
+  template <typename T> inline void store(T* p,typename Lanes<T>::V v)
+  {
+    memcpy(p,&v,sizeof(v));
+  }
+  //@}
+
+  //! Vector with all lanes c.
+  template <typename T> inline typename Lanes<T>::V splat(T c)
+  {
+    typename Lanes<T>::V v;
+    for (uint i=0;i<Lanes<T>::W;i++) v[i]=c;
+    return v;
+  }
+
+  //! Lanewise mask?a:b, where mask lanes are all ones or all zeros (as returned by a comparison).
+  template <typename V,typename I> inline V select(I mask,V a,V b)
+  {
+    return (V)(((I)a&mask)|((I)b&~mask));
+  }
+
+  //@{
+  //! Mask selecting the sign bit of each lane.
+  inline ID sign_mask(VD)
+  {
+    return (ID)splat(-0.0);
+  }
+  inline IF sign_mask(VF)
+  {
+    return (IF)splat(-0.0f);
+  }
+  //@}
+
+  //@{
+  //! Adding and subtracting 1.5*2^mantissa_bits rounds to the nearest integer (valid for |x|<2^(mantissa_bits-1)).
+  inline VD round_nearest(VD x)
+  {
+    return (x+6755399441055744.0)-6755399441055744.0;
+  }
+  inline VF round_nearest(VF x)
+  {
+    return (x+12582912.0f)-12582912.0f;
+  }
+  //@}
+
+  //! Round down to an integer (valid for 0<=x<2^(mantissa_bits-1)).
+  template <typename V> inline V floor_positive(V x)
+  {
+    const V r=round_nearest(x);
+    return select(r>x,r-1,r);
+  }
+
+  //@{
+  //! Convert integer valued scalars (as for round_nearest) to integers.
+  inline ID to_int(VD x)
+  {
+    return (ID)(x+6755399441055744.0)-(ID)splat(6755399441055744.0);
+  }
+  inline IF to_int(VF x)
+  {
+    return (IF)(x+12582912.0f)-(IF)splat(12582912.0f);
+  }
+  //@}
+
+  //@{
+  //! 2^x for integer valued x in the normal exponent range.
+  inline VD pow2(VD x)
+  {
+    return (VD)((to_int(x)+1023)<<52);
+  }
+  inline VF pow2(VF x)
+  {
+    return (VF)((to_int(x)+127)<<23);
+  }
+  //@}
+
+  //! Cephes exp: reduce to r=x-n*ln2 with |r|<=ln2/2 and use a (2,3) Pade approximant.
+  inline VD exp_v(VD x)
+  {
+    // Clamp to where the result saturates to infinity or zero (NaNs fail both comparisons and pass through).
+    x=select(x>710.0,splat(710.0),x);
+    x=select(x<-746.0,splat(-746.0),x);
+
+    const VD n=round_nearest(x*1.4426950408889634073599);
+    VD r=x-n*6.93145751953125E-1;
+    r=r-n*1.42860682030941723212E-6;
+
+    const VD rr=r*r;
+    const VD p=r*((1.26177193074810590878E-4*rr+3.02994407707441961300E-2)*rr+9.99999999999999999910E-1);
+    const VD q=((3.00198505138664455042E-6*rr+2.52448340349684104192E-3)*rr+2.27265548208155028766E-1)*rr+2.00000000000000000009E0;
+    r=1.0+2.0*(p/(q-p));
+
+    // Scale in two steps so subnormal results and n up to 1025 don't leave the exponent range.
+    const VD n1=round_nearest(0.5*n);
+    return (r*pow2(n1))*pow2(n-n1);
+  }
+
+  //! Cephes expf: as the double version but with a degree 6 polynomial.
+  inline VF exp_v(VF x)
+  {
+    x=select(x>89.0f,splat(89.0f),x);
+    x=select(x<-104.0f,splat(-104.0f),x);
+
+    const VF n=round_nearest(x*1.44269504088896341f);
+    VF r=x-n*0.693359375f;
+    r=r-n*-2.12194440e-4f;
+
+    const VF rr=r*r;
+    r=((((((1.9875691500E-4f*r+1.3981999507E-3f)*r+8.3334519073E-3f)*r+4.1665795894E-2f)*r+1.6666665459E-1f)*r+5.0000001201E-1f)*rr+r)+1.0f;
+
+    const VF n1=round_nearest(0.5f*n);
+    return (r*pow2(n1))*pow2(n-n1);
+  }
+
+  //@{
+  //! Cephes sin and cos polynomials on the reduced argument z, with zz=z*z.
+  inline VD sin_poly(VD z,VD zz)
+  {
+    return z+z*(zz*(((((1.58962301576546568060E-10*zz-2.50507477628578072866E-8)*zz+2.75573136213857245213E-6)*zz-1.98412698295895385996E-4)*zz+8.33333333332211858878E-3)*zz-1.66666666666666307295E-1));
+  }
+  inline VD cos_poly(VD,VD zz)
+  {
+    return (1.0-0.5*zz)+(zz*zz)*(((((-1.13585365213876817300E-11*zz+2.08757008419747316778E-9)*zz-2.75573141792967388112E-7)*zz+2.48015872888517045348E-5)*zz-1.38888888888730564116E-3)*zz+4.16666666666665929218E-2);
+  }
+  inline VF sin_poly(VF z,VF zz)
+  {
+    return ((-1.9515295891E-4f*zz+8.3321608736E-3f)*zz-1.6666654611E-1f)*zz*z+z;
+  }
+  inline VF cos_poly(VF,VF zz)
+  {
+    return ((((2.443315711809948E-005f*zz-1.388731625493765E-003f)*zz+4.166664568298827E-002f)*zz)*zz-0.5f*zz)+1.0f;
+  }
+  //@}
+
+  //@{
+  //! Cephes extended precision pi/4 and the limit on |x| for accurate reduction by it.
+  inline void pio4(VD& dp1,VD& dp2,VD& dp3,VD& limit)
+  {
+    dp1=splat(7.85398125648498535156E-1);
+    dp2=splat(3.77489470793079817668E-8);
+    dp3=splat(2.69515142907905952645E-15);
+    limit=splat(1073741824.0);
+  }
+  inline void pio4(VF& dp1,VF& dp2,VF& dp3,VF& limit)
+  {
+    dp1=splat(0.78515625f);
+    dp2=splat(2.4187564849853515625e-4f);
+    dp3=splat(3.77489497744594108e-8f);
+    limit=splat(8192.0f);
+  }
+  //@}
+
+  //! Cephes sin and cos, reduced modulo pi/4 in extended precision.
+  /*! Lanes with |x| beyond the reduction limit (or non-finite x) aren't reduced accurately; big is set to flag them.
+   */
+  template <typename T> inline typename Lanes<T>::V sincos_v(typename Lanes<T>::V x,bool want_cos,typename Lanes<T>::I& big)
+  {
+    typedef typename Lanes<T>::V V;
+    typedef typename Lanes<T>::I I;
+
+    V dp1,dp2,dp3,limit;
+    pio4(dp1,dp2,dp3,limit);
+
+    const I sign=(I)x&sign_mask(x);
+    const V ax=(V)((I)x&~sign_mask(x));
+    big=~(I)(ax<limit);
+
+    V y=floor_positive(ax*(T)1.27323954473516268615);
+    I j=to_int(y);
+
+    // Odd octants are mapped on to the next even one.
+    const I odd=(I)((j&1)!=0);
+    j=(j+(odd&1))&7;
+    y=select(odd,y+1,y);
+
+    const I flip=(I)(j>3);
+    j=j-(flip&4);
+
+    const V z=((ax-y*dp1)-y*dp2)-y*dp3;
+    const V zz=z*z;
+
+    const I use_other=(I)((j==1)|(j==2));
+    if (want_cos)
+      {
+	const I negate=(flip^(I)(j>1))&sign_mask(x);
+	return (V)((I)select(use_other,sin_poly(z,zz),cos_poly(z,zz))^negate);
+      }
+    else
+      {
+	const I negate=sign^(flip&sign_mask(x));
+	return (V)((I)select(use_other,cos_poly(z,zz),sin_poly(z,zz))^negate);
+      }
+  }
+
+  //! Apply op to whole vectors of m scalars; the remainder is done in a zero padded vector.
+  template <typename T,typename OP> void componentwise(const T* a,const T* b,T* d,size_t m,OP op)
+  {
+    const uint W=Lanes<T>::W;
+    size_t i=0;
+    for (;i+W<=m;i+=W)
+      store(d+i,op(load(a+i),load(b+i)));
+    if (i<m)
+      {
+	T ta[W]={};
+	T tb[W]={};
+	T td[W];
+	memcpy(ta,a+i,(m-i)*sizeof(T));
+	memcpy(tb,b+i,(m-i)*sizeof(T));
+	store(td,op(load(ta),load(tb)));
+	memcpy(d+i,td,(m-i)*sizeof(T));
+      }
+  }
+
+  template <typename T> struct Add
+  {
+    typedef typename Lanes<T>::V V;
+    V operator()(V a,V b) const {return a+b;}
+  };
+
+  template <typename T> struct Multiply
+  {
+    typedef typename Lanes<T>::V V;
+    V operator()(V a,V b) const {return a*b;}
+  };
+
+  template <typename T> struct Divide
+  {
+    typedef typename Lanes<T>::V V;
+    V operator()(V a,V b) const {return select(b==(T)0,splat((T)0),a/b);}
+  };
+
+  //! As std::max.
+  template <typename T> struct Maximum
+  {
+    typedef typename Lanes<T>::V V;
+    V operator()(V a,V b) const {return select(a<b,b,a);}
+  };
+
+  //! As std::min.
+  template <typename T> struct Minimum
+  {
+    typedef typename Lanes<T>::V V;
+    V operator()(V a,V b) const {return select(b<a,b,a);}
+  };
+
+  template <typename T> struct Exp
+  {
+    typedef typename Lanes<T>::V V;
+    V operator()(V a,V) const {return exp_v(a);}
+  };
+
+  //! sin or cos, falling back to the C library for lanes the vector version can't handle.
+  template <typename T,bool COS> struct SinCos
+  {
+    typedef typename Lanes<T>::V V;
+    V operator()(V a,V) const
+    {
+      typename Lanes<T>::I big;
+      V r=sincos_v<T>(a,COS,big);
+      for (uint i=0;i<Lanes<T>::W;i++)
+	if (big[i]) r[i]=(COS ? std::cos(a[i]) : std::sin(a[i]));
+      return r;
+    }
+  };
+
+  template <typename T> void kernel_add(const T* a,const T* b,T* d,size_t m) {componentwise(a,b,d,m,Add<T>());}
+  template <typename T> void kernel_multiply(const T* a,const T* b,T* d,size_t m) {componentwise(a,b,d,m,Multiply<T>());}
+  template <typename T> void kernel_divide(const T* a,const T* b,T* d,size_t m) {componentwise(a,b,d,m,Divide<T>());}
+  template <typename T> void kernel_maximum(const T* a,const T* b,T* d,size_t m) {componentwise(a,b,d,m,Maximum<T>());}
+  template <typename T> void kernel_minimum(const T* a,const T* b,T* d,size_t m) {componentwise(a,b,d,m,Minimum<T>());}
+  template <typename T> void kernel_exp(const T* a,T* d,size_t m) {componentwise(a,a,d,m,Exp<T>());}
+  template <typename T> void kernel_sin(const T* a,T* d,size_t m) {componentwise(a,a,d,m,SinCos<T,false>());}
+  template <typename T> void kernel_cos(const T* a,T* d,size_t m) {componentwise(a,a,d,m,SinCos<T,true>());}
+
+  //! The remainder is done with scalar code, which is bit identical for these.
+  template <typename T> void kernel_transform(const T* k,const T* a,T* d,size_t n)
+  {
+    typedef typename Lanes<T>::V V;
+    const uint W=Lanes<T>::W;
+    size_t i=0;
+    for (;i+W<=n;i+=W)
+      {
+	const V px=load(a+i);
+	const V py=load(a+n+i);
+	const V pz=load(a+2*n+i);
+	store(d+i    ,k[0]+k[3]*px+k[6]*py+k[ 9]*pz);
+	store(d+n+i  ,k[1]+k[4]*px+k[7]*py+k[10]*pz);
+	store(d+2*n+i,k[2]+k[5]*px+k[8]*py+k[11]*pz);
+      }
+    for (;i<n;i++)
+      {
+	const T px=a[i];
+	const T py=a[n+i];
+	const T pz=a[2*n+i];
+	d[i]    =k[0]+k[3]*px+k[6]*py+k[ 9]*pz;
+	d[n+i]  =k[1]+k[4]*px+k[7]*py+k[10]*pz;
+	d[2*n+i]=k[2]+k[5]*px+k[8]*py+k[11]*pz;
+      }
+  }
+
+  template <typename T> void kernel_cone(const T* a,T* d,size_t n)
+  {
+    typedef typename Lanes<T>::V V;
+    const uint W=Lanes<T>::W;
+    size_t i=0;
+    for (;i+W<=n;i+=W)
+      {
+	const V pz=load(a+2*n+i);
+	store(d+i,load(a+i)*pz);
+	store(d+n+i,load(a+n+i)*pz);
+      }
+    for (;i<n;i++)
+      {
+	d[i]=a[i]*a[2*n+i];
+	d[n+i]=a[n+i]*a[2*n+i];
+      }
+    memcpy(d+2*n,a+2*n,n*sizeof(T));
+  }
+
+  //! Whether any lane of a mask is set.
+  template <typename I> inline bool any(I mask)
+  {
+    for (uint i=0;i<sizeof(I)/sizeof(mask[0]);i++)
+      if (mask[i]) return true;
+    return false;
+  }
+
+  //! Lanes iterate together, with a mask of those yet to escape; the same operations as the scalar kernel, so the counts are identical.
+  template <typename T> void kernel_escape_time(const T* z,const T* c,uint iterations,uint* d,size_t m)
+  {
+    typedef typename Lanes<T>::V V;
+    typedef typename Lanes<T>::I I;
+    const uint W=Lanes<T>::W;
+    for (size_t k=0;k<m;k+=W)
+      {
+	const size_t w=(m-k<W ? m-k : W);
+	V zr;
+	V zi;
+	V cr;
+	V ci;
+	if (w==W)
+	  {
+	    zr=load(z+k);
+	    zi=load(z+m+k);
+	    cr=load(c+k);
+	    ci=load(c+m+k);
+	  }
+	else
+	  {
+	    // Lanes past the end are padded with the origin, which is in the set.
+	    T t[4][W]={};
+	    memcpy(t[0],z+k,w*sizeof(T));
+	    memcpy(t[1],z+m+k,w*sizeof(T));
+	    memcpy(t[2],c+k,w*sizeof(T));
+	    memcpy(t[3],c+m+k,w*sizeof(T));
+	    zr=load(t[0]);
+	    zi=load(t[1]);
+	    cr=load(t[2]);
+	    ci=load(t[3]);
+	  }
+
+	// Mandelbrot points in the main cardioid or the period 2 bulb never escape.
+	const V qr=cr-(T)0.25;
+	const V q=qr*qr+ci*ci;
+	const I bounded=(I)((zr==(T)0)&(zi==(T)0)&((q*(q+qr)<(T)0.25*ci*ci)|((cr+(T)1)*(cr+(T)1)+ci*ci<(T)0.0625)));
+
+	I active=~bounded;
+	I periodic=(I)splat((T)0);
+	I count=(I)splat((T)0);
+	V sr=zr;
+	V si=zi;
+	for (uint i=0;i<iterations;i++)
+	  {
+	    const V zr2=zr*zr;
+	    const V zi2=zi*zi;
+
+	    // Checking for every lane having escaped isn't free, so it's only done every few iterations.
+	    active&=~(I)(zr2+zi2>(T)4);
+	    if ((i&3)==0 && !any(active))
+	      break;
+
+	    const V nzr=zr2-zi2+cr;
+	    const V nzi=(T)2*zr*zi+ci;
+
+	    zr=nzr;
+	    zi=nzi;
+
+	    // Active lanes are all ones (-1).
+	    count-=active;
+
+	    const I repeated=active&(I)((zr==sr)&(zi==si));
+	    periodic|=repeated;
+	    active&=~repeated;
+
+	    if (((i+1)&i)==0)
+	      {
+		sr=zr;
+		si=zi;
+	      }
+	  }
+
+	const I never=bounded|periodic;
+	const I result=(count&~never)|(never&((I)splat((T)0)+iterations));
+	for (uint j=0;j<w;j++)
+	  d[k+j]=result[j];
+      }
+  }
+}
+
+//! Initialiser for the SimdKernels::Table of scalar type T.
+#define SIMD_KERNELS_TABLE(T) \
+  { \
+    Lanes<T>::W, \
+    kernel_add<T>,kernel_multiply<T>,kernel_divide<T>,kernel_maximum<T>,kernel_minimum<T>, \
+    kernel_exp<T>,kernel_sin<T>,kernel_cos<T>, \
+    kernel_transform<T>,kernel_cone<T>, \
+    kernel_escape_time<T> \
+  }
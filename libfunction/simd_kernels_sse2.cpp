@@ -0,0 +1,73 @@
+/**************************************************************************/
+/*  Copyright 2012 Tim Day                                                */
+/*                                                                        */
+/*  This file is part of Evolvotron                                       */
+/*                                                                        */
+/*  Evolvotron is free software: you can redistribute it and/or modify    */
+/*  it under the terms of the GNU General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or     */
+/*  (at your option) any later version.                                   */
+/*                                                                        */
+/*  Evolvotron is distributed in the hope that it will be useful,         */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/*  GNU General Public License for more details.                          */
+/*                                                                        */
+/*  You should have received a copy of the GNU General Public License     */
+/*  along with Evolvotron.  If not, see <http://www.gnu.org/licenses/>.   */
+/**************************************************************************/
+
+
+/*! \file
+  \brief The SSE2 SimdKernels.
+*/
+
+#include "simd_kernels.h"
+
+#include <cstring>
+
+#ifdef SIMD_KERNELS_X86
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))),apply_to=function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+namespace
+{
+  typedef double VD __attribute__((vector_size(16)));
+  typedef long long ID __attribute__((vector_size(16)));
+  typedef float VF __attribute__((vector_size(16)));
+  typedef int IF __attribute__((vector_size(16)));
+}
+
+#include "simd_kernels_generic.h"
+
+namespace
+{
+  //! Without gathers, vector noise is no faster than the scalar kernel.
+  void kernel_noise(const int*const* permutations,const double*const* gradients,uint channels,uint octaves,const double* a,double* d,size_t n)
+  {
+    SimdKernels::scalar().noise(permutations,gradients,channels,octaves,a,d,n);
+  }
+}
+
+extern const SimdKernels simd_kernels_sse2;
+
+const SimdKernels simd_kernels_sse2=
+  {
+    "SSE2",
+    SIMD_KERNELS_TABLE(double),
+    SIMD_KERNELS_TABLE(float),
+    kernel_noise
+  };
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -53,6 +53,15 @@ Transform::Transform(const std::vector<real>& v,uint s)
 Transform::~Transform()
 {}
 
+Transform& Transform::operator=(const Transform& t)
+{
+  _translate=t.translate();
+  _basis_x=t.basis_x();
+  _basis_y=t.basis_y();
+  _basis_z=t.basis_z();
+  return *this;
+}
+
 const std::vector<real> Transform::get_columns() const
 {
   std::vector<real> ret(12);
@@ -65,16 +74,46 @@ const std::vector<real> Transform::get_columns() const
   return ret;
 }
 
-const XYZ Transform::transformed(const XYZ& p) const
+bool Transform::is_identity() const
 {
-  return _translate+_basis_x*p.x()+_basis_y*p.y()+_basis_z*p.z();
+  return get_columns()==TransformIdentity().get_columns();
 }
 
-const XYZ Transform::transformed_no_translate(const XYZ& p) const
+template <typename T> const BasicXYZ<T> Transform::transformed(const BasicXYZ<T>& p) const
 {
-  return _basis_x*p.x()+_basis_y*p.y()+_basis_z*p.z();
+  return BasicXYZ<T>(_translate)+BasicXYZ<T>(_basis_x)*p.x()+BasicXYZ<T>(_basis_y)*p.y()+BasicXYZ<T>(_basis_z)*p.z();
 }
 
+/*! The matrix is held in locals for the whole run and each component is computed in the same order as the single point version,
+  so results are identical.
+ */
+template <typename T> void Transform::transformed(const BasicXYZ<T>* in,BasicXYZ<T>* out,size_t n) const
+{
+  const T tx=_translate.x(),ty=_translate.y(),tz=_translate.z();
+  const T xx=_basis_x.x(),xy=_basis_x.y(),xz=_basis_x.z();
+  const T yx=_basis_y.x(),yy=_basis_y.y(),yz=_basis_y.z();
+  const T zx=_basis_z.x(),zy=_basis_z.y(),zz=_basis_z.z();
+  for (size_t i=0;i<n;i++)
+    {
+      const T px=in[i].x(),py=in[i].y(),pz=in[i].z();
+      out[i].x(tx+xx*px+yx*py+zx*pz);
+      out[i].y(ty+xy*px+yy*py+zy*pz);
+      out[i].z(tz+xz*px+yz*py+zz*pz);
+    }
+}
+
+template <typename T> const BasicXYZ<T> Transform::transformed_no_translate(const BasicXYZ<T>& p) const
+{
+  return BasicXYZ<T>(_basis_x)*p.x()+BasicXYZ<T>(_basis_y)*p.y()+BasicXYZ<T>(_basis_z)*p.z();
+}
+
+template const XYZf Transform::transformed<float>(const XYZf& p) const;
+template const XYZ Transform::transformed<double>(const XYZ& p) const;
+template void Transform::transformed<float>(const XYZf* in,XYZf* out,size_t n) const;
+template void Transform::transformed<double>(const XYZ* in,XYZ* out,size_t n) const;
+template const XYZf Transform::transformed_no_translate<float>(const XYZf& p) const;
+template const XYZ Transform::transformed_no_translate<double>(const XYZ& p) const;
+
 Transform& Transform::concatenate_on_right(const Transform& t)
 {
   const XYZ bx(transformed_no_translate(t.basis_x()));
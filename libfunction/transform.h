@@ -46,6 +46,9 @@ class Transform
   //! Constructor specifying column-wise elements.
   Transform(const std::vector<real>& v,uint starting_element=0);
 
+  //! Assignment.
+  Transform& operator=(const Transform&);
+
   //! virtual destructor in case of extension
   virtual ~Transform();
 
@@ -89,11 +92,21 @@ class Transform
   //! Get column-wise element values as a vector
   const std::vector<real> get_columns() const;
 
+  //! Returns true if the transform is exactly the identity.
+  bool is_identity() const;
+
   //! Transform a point
-  const XYZ transformed(const XYZ& p) const;
+  /*! Instantiated for float and double; single precision points are transformed by the rounded matrix.
+   */
+  template <typename T> const BasicXYZ<T> transformed(const BasicXYZ<T>& p) const;
+
+  //! Transform n points, setting out[i] to transformed(in[i]).
+  /*! The in and out arrays may be the same array (but mustn't otherwise overlap).
+   */
+  template <typename T> void transformed(const BasicXYZ<T>* in,BasicXYZ<T>* out,size_t n) const;
 
   //! Transform a point with no translation
-  const XYZ transformed_no_translate(const XYZ& p) const;
+  template <typename T> const BasicXYZ<T> transformed_no_translate(const BasicXYZ<T>& p) const;
 
   //! Concatenate transforms
   Transform& concatenate_on_right(const Transform& t);
@@ -110,13 +123,9 @@ class Transform
   XYZ _basis_z;
 };
 
-inline const XYZ operator*(const Transform& t,const XYZ& p)
+template <typename T> inline const BasicXYZ<T> operator*(const Transform& t,const BasicXYZ<T>& p)
 {
-  return 
-     t.basis_x()*p.x()
-    +t.basis_y()*p.y()
-    +t.basis_z()*p.z()
-    +t.translate();
+  return t.transformed(p);
 }
 
 inline std::ostream& operator<<(std::ostream& out,const Transform& t)
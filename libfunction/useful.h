@@ -34,6 +34,7 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <set>
@@ -51,6 +52,27 @@
 #include <boost/utility.hpp>
 #include <boost/version.hpp>
 
+//@{
+//! Functions evaluated in single precision (see XYZf) call the maths functions unqualified with float arguments.
+/*! These bring the float overloads into the global namespace alongside the C library's double versions,
+  so the arithmetic stays in float rather than being promoted.
+ */
+using std::asin;
+using std::atan2;
+using std::cos;
+using std::exp;
+using std::fabs;
+using std::floor;
+using std::fmod;
+using std::log;
+using std::pow;
+using std::round;
+using std::sin;
+using std::sqrt;
+using std::tan;
+using std::tanh;
+//@}
+
 //! Convenience typedef.
 typedef unsigned int uint;
 
@@ -112,11 +134,11 @@ extern void constraint_violation(const char* test,const char* src_file,uint src_
 #define constraint(TEST) {if (!TEST) {constraint_violation(#TEST,__FILE__,__LINE__);}}
 
 //! Sane modulus function always returning a number in the range [0,y)
-inline real modulusf(real x,real y)
+template <typename T> inline T modulusf(T x,T y)
 {
-  if (y<0.0) y=-y;
-  real r=fmod(x,y);
-  if (r<0.0) r+=y;
+  if (y<T(0.0)) y=-y;
+  T r=fmod(x,y);
+  if (r<T(0.0)) r+=y;
   return r;
 }
 
@@ -133,12 +155,12 @@ inline uint modulusi(int x,int y)
 //! Triangle function: like modulus, but starts ramping down instead of discontinuity at y.
 /*! Always has slope 1.  Setting y=1 ensures x in [0,1]
  */
-inline real trianglef(real x,real y)
+template <typename T> inline T trianglef(T x,T y)
 {
-  if (y<0.0) y=-y;
-  if (x<0.0) x=-x;
-  real r=fmod(x,2.0*y);
-  if (r>y) r=2.0*y-r;
+  if (y<T(0.0)) y=-y;
+  if (x<T(0.0)) x=-x;
+  T r=fmod(x,T(2.0)*y);
+  if (r>y) r=T(2.0)*y-r;
   return r;
 }
 
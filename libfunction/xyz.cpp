@@ -18,7 +18,7 @@
 /**************************************************************************/
 
 /*! \file
-  \brief Implementation for class XYZ.
+  \brief Implementation for classes XYZ and XYZBlock.
 */
 
 #include "xyz.h"
@@ -26,13 +26,6 @@
 #include "random.h"
 #include "xy.h"
 
-/*! Outputs whitespace-separated co-ordinates.
- */
-std::ostream& XYZ::write(std::ostream& out) const
-{
-  return out << x() << " " << y() << " " << z();
-}
-
 RandomXYZInUnitCube::RandomXYZInUnitCube(Random01& rng)
 :XYZ()
 {
@@ -111,10 +104,162 @@ RandomXYZInXYDisc::RandomXYZInXYDisc(Random01& rng,real radius)
     }
 }
 
+namespace
+{
+  //! Bytes per vector used for XYZBlock alignment and padding.
+  const size_t block_bytes=32;
+}
+
+template <typename T> BasicXYZBlock<T>::BasicXYZBlock()
+  :_size(0)
+  ,_stride(0)
+  ,_capacity(0)
+  ,_storage(0)
+  ,_planes(0)
+{}
+
+template <typename T> BasicXYZBlock<T>::BasicXYZBlock(size_t n)
+  :_size(0)
+  ,_stride(0)
+  ,_capacity(0)
+  ,_storage(0)
+  ,_planes(0)
+{
+  resize(n);
+}
+
+template <typename T> BasicXYZBlock<T>::BasicXYZBlock(const BasicXYZ<T>* p,size_t n)
+  :_size(0)
+  ,_stride(0)
+  ,_capacity(0)
+  ,_storage(0)
+  ,_planes(0)
+{
+  assign(p,n);
+}
+
+template <typename T> BasicXYZBlock<T>::BasicXYZBlock(const BasicXYZBlock& v)
+  :_size(0)
+  ,_stride(0)
+  ,_capacity(0)
+  ,_storage(0)
+  ,_planes(0)
+{
+  (*this)=v;
+}
+
+template <typename T> BasicXYZBlock<T>::~BasicXYZBlock()
+{
+  delete [] _storage;
+}
+
+template <typename T> BasicXYZBlock<T>& BasicXYZBlock<T>::operator=(const BasicXYZBlock& v)
+{
+  if (this!=&v)
+    {
+      resize(v.size());
+      std::copy(v.data(),v.data()+3*_stride,_planes);
+    }
+  return *this;
+}
+
+template <typename T> void BasicXYZBlock<T>::swap(BasicXYZBlock& v)
+{
+  std::swap(_size,v._size);
+  std::swap(_stride,v._stride);
+  std::swap(_capacity,v._capacity);
+  std::swap(_storage,v._storage);
+  std::swap(_planes,v._planes);
+}
+
+/*! Storage is only reallocated when the block grows beyond the largest size it has held.
+ */
+template <typename T> void BasicXYZBlock<T>::resize(size_t n)
+{
+  const size_t lanes=block_bytes/sizeof(T);
+  const size_t stride=((n+lanes-1)/lanes)*lanes;
+  if (stride>_capacity || !_storage)
+    {
+      delete [] _storage;
+      // new only guarantees alignment for a T, so allow for up to a vector's worth of slack.
+      _storage=new T[3*stride+lanes];
+      const size_t misalignment=(reinterpret_cast<size_t>(_storage)/sizeof(T))%lanes;
+      _planes=_storage+(misalignment==0 ? 0 : lanes-misalignment);
+      _capacity=stride;
+    }
+  _size=n;
+  _stride=stride;
+  std::fill(_planes,_planes+3*_stride,T(0));
+}
+
+template <typename T> void BasicXYZBlock<T>::assign(const BasicXYZ<T>* p,size_t n)
+{
+  resize(n);
+  for (size_t i=0;i<n;i++)
+    set(i,p[i]);
+}
 
+template <typename T> void BasicXYZBlock<T>::copy_to(BasicXYZ<T>* p) const
+{
+  for (size_t i=0;i<_size;i++)
+    p[i]=(*this)[i];
+}
 
+template <typename T> void BasicXYZBlock<T>::fill(const BasicXYZ<T>& v)
+{
+  std::fill(x(),x()+_size,T(v.x()));
+  std::fill(y(),y()+_size,T(v.y()));
+  std::fill(z(),z()+_size,T(v.z()));
+}
 
+template <typename T> void BasicXYZBlock<T>::operator+=(const BasicXYZBlock& v)
+{
+  assert(v.size()==size());
+  T*const d=data();
+  const T*const a=v.data();
+  for (size_t i=0;i<3*_stride;i++)
+    d[i]+=a[i];
+}
 
+template <typename T> void BasicXYZBlock<T>::operator-=(const BasicXYZBlock& v)
+{
+  assert(v.size()==size());
+  T*const d=data();
+  const T*const a=v.data();
+  for (size_t i=0;i<3*_stride;i++)
+    d[i]-=a[i];
+}
 
+template <typename T> void BasicXYZBlock<T>::operator+=(const BasicXYZ<T>& v)
+{
+  const T vx=v.x();
+  const T vy=v.y();
+  const T vz=v.z();
+  T*const px=x();
+  T*const py=y();
+  T*const pz=z();
+  for (size_t i=0;i<_size;i++)
+    {
+      px[i]+=vx;
+      py[i]+=vy;
+      pz[i]+=vz;
+    }
+}
 
+template <typename T> void BasicXYZBlock<T>::operator*=(real k)
+{
+  const T kt=k;
+  T*const d=data();
+  for (size_t i=0;i<3*_stride;i++)
+    d[i]*=kt;
+}
+
+/*! As XYZ, multiplies by the reciprocal.
+ */
+template <typename T> void BasicXYZBlock<T>::operator/=(real k)
+{
+  (*this)*=(1.0/k);
+}
 
+template class BasicXYZBlock<float>;
+template class BasicXYZBlock<double>;
@@ -32,25 +32,30 @@ class Random01;
 
 //! Class to hold vectors in 3D cartesian co-ordinates.
 /*! Direct access to the x,y,z members is not permitted.
+  The scalar type is a parameter so functions can also be evaluated in single precision;
+  XYZ is the usual double precision instance and XYZf the single precision one.
  */
-class XYZ
+template <typename T> class BasicXYZ
 {
  protected:
-  real _rep[3];
+  T _rep[3];
 
  public:
 
+  //! The scalar type.
+  typedef T Scalar;
+
   //@{
   //! Accessor.
-  real x() const
+  T x() const
     {
       return _rep[0];
     }
-  real y() const
+  T y() const
     {
       return _rep[1];
     }
-  real z() const
+  T z() const
     {
       return _rep[2];
     }
@@ -59,15 +64,15 @@ class XYZ
       return XY(x(),y());
     }
 
-  void x(real v)
+  void x(T v)
     {
       _rep[0]=v;
     }
-  void y(real v)
+  void y(T v)
     {
       _rep[1]=v;
     }
-  void z(real v)
+  void z(T v)
     {
       _rep[2]=v;
     }
@@ -76,11 +81,11 @@ class XYZ
   //! Null constructor.
   /*! NB The components are not cleared to zero. 
    */
-  XYZ()
+  BasicXYZ()
     {}
 
   //! Initialise from an XY and a z component.
-  XYZ(const XY& p,real vz)
+  BasicXYZ(const XY& p,T vz)
     {
       _rep[0]=p.x();
       _rep[1]=p.y();
@@ -88,19 +93,27 @@ class XYZ
     }
   
   //! Initialise from separate components.
-  XYZ(real vx,real vy,real vz)
+  BasicXYZ(T vx,T vy,T vz)
     {
       _rep[0]=vx;
       _rep[1]=vy;
       _rep[2]=vz;
     }
 
+  //! Convert from the other precision.
+  template <typename U> explicit BasicXYZ(const BasicXYZ<U>& v)
+    {
+      _rep[0]=v.x();
+      _rep[1]=v.y();
+      _rep[2]=v.z();
+    }
+
   //! Trivial destructor.
-  ~XYZ()
+  ~BasicXYZ()
     {}
 
   //! Subtract a vector
-  void operator-=(const XYZ& v)
+  void operator-=(const BasicXYZ& v)
     {
       _rep[0]-=v._rep[0];
       _rep[1]-=v._rep[1];
@@ -108,7 +121,7 @@ class XYZ
     }
 
   //! Add a vector
-  void operator+=(const XYZ& v)
+  void operator+=(const BasicXYZ& v)
     {
       _rep[0]+=v._rep[0];
       _rep[1]+=v._rep[1];
@@ -116,7 +129,7 @@ class XYZ
     }
 
   //! Multiply by scalar
-  void operator*=(real k)
+  void operator*=(T k)
     {
       _rep[0]*=k;
       _rep[1]*=k;
@@ -126,14 +139,14 @@ class XYZ
   //! Divide by scalar.
   /*! Implemented assuming one divide and three multiplies is faster than three divides.
    */
-  void operator/=(real k)
+  void operator/=(T k)
     {
-      const real ik(1.0/k);
+      const T ik(T(1.0)/k);
       (*this)*=ik;
     }
 
   //! Assignment. 
-  void assign(const XYZ& v)
+  void assign(const BasicXYZ& v)
     {
       x(v.x());
       y(v.y());
@@ -141,118 +154,131 @@ class XYZ
     }
 
   //! Negation.
-  const XYZ operator-() const
+  const BasicXYZ operator-() const
     {
-      return XYZ(-x(),-y(),-z());
+      return BasicXYZ(-x(),-y(),-z());
     }
 
   //! Return the square of the magnitude.
-  real magnitude2() const
+  T magnitude2() const
     {
       return x()*x()+y()*y()+z()*z();
     }
 
   //! Return the magnitude.
-  real magnitude() const
+  T magnitude() const
     {
-      return sqrt(magnitude2());
+      return std::sqrt(magnitude2());
     }
 
   //! Returns sum of x, y and z components.
-  real sum_of_components() const
+  T sum_of_components() const
     {
       return x()+y()+z();
     }
 
   //! Return the vector normalised.
-  const XYZ normalised() const;
+  const BasicXYZ normalised() const;
 
   //! Normalise this vector.
   void normalise();
 
   //! Returns true if an origin centred cuboid with this vectors semi-axes contains the argument.
-  bool origin_centred_rect_contains(const XYZ& p) const
+  bool origin_centred_rect_contains(const BasicXYZ& p) const
     {
       return (-x()<=p.x() && p.x()<=x() && -y()<=p.y() && p.y()<=y() && -z()<=p.z() && p.z()<=z()); 
     }
 
   //! Write the vector.
-  std::ostream& write(std::ostream&) const;
+  /*! Outputs whitespace-separated co-ordinates.
+   */
+  std::ostream& write(std::ostream& out) const
+    {
+      return out << x() << " " << y() << " " << z();
+    }
 
   //! Helper for common case of creating an instance filled with a common value.
-  static const XYZ fill(real v)
+  static const BasicXYZ fill(T v)
     {
-      return XYZ(v,v,v);
+      return BasicXYZ(v,v,v);
     }
 };
 
+//! Vector in the usual (double) precision.
+typedef BasicXYZ<real> XYZ;
+
+//! Vector in single precision.
+typedef BasicXYZ<float> XYZf;
+
 //! Cross product.
-inline const XYZ operator*(const XYZ& a,const XYZ& b)
+template <typename T> inline const BasicXYZ<T> operator*(const BasicXYZ<T>& a,const BasicXYZ<T>& b)
 {
-  return XYZ(
-	     a.y()*b.z()-a.z()*b.y(),
-	     a.z()*b.x()-a.x()*b.z(),
-	     a.x()*b.y()-a.y()*b.x()
-	     );
+  return BasicXYZ<T>(
+		     a.y()*b.z()-a.z()*b.y(),
+		     a.z()*b.x()-a.x()*b.z(),
+		     a.x()*b.y()-a.y()*b.x()
+		     );
 } 
 
 //! Dot product.
 /*! Perhaps a curious choice of operator but it works for me.
  */
-inline real operator%(const XYZ& a,const XYZ& b)
+template <typename T> inline T operator%(const BasicXYZ<T>& a,const BasicXYZ<T>& b)
 {
   return a.x()*b.x()+a.y()*b.y()+a.z()*b.z();
 } 
 
 //! Vector addition.
-inline const XYZ operator+(const XYZ& a,const XYZ& b)
+template <typename T> inline const BasicXYZ<T> operator+(const BasicXYZ<T>& a,const BasicXYZ<T>& b)
 {
-  return XYZ(a.x()+b.x(),a.y()+b.y(),a.z()+b.z());
+  return BasicXYZ<T>(a.x()+b.x(),a.y()+b.y(),a.z()+b.z());
 }
 
 //! Vector subtraction.
-inline const XYZ operator-(const XYZ& a,const XYZ& b)
+template <typename T> inline const BasicXYZ<T> operator-(const BasicXYZ<T>& a,const BasicXYZ<T>& b)
 {
-  return XYZ(a.x()-b.x(),a.y()-b.y(),a.z()-b.z());
+  return BasicXYZ<T>(a.x()-b.x(),a.y()-b.y(),a.z()-b.z());
 }
 
 //! Multiplication by scalar.
-inline const XYZ operator*(real k,const XYZ& v)
+/*! The scalar isn't used to deduce the precision, so (double) reals scale vectors of either precision.
+ */
+template <typename T> inline const BasicXYZ<T> operator*(typename BasicXYZ<T>::Scalar k,const BasicXYZ<T>& v)
 {  
-  XYZ ret(v);
+  BasicXYZ<T> ret(v);
   ret*=k;
   return ret;
 }
 
 //! Multiplication by scalar.
-inline const XYZ operator*(const XYZ& v,real k)
+template <typename T> inline const BasicXYZ<T> operator*(const BasicXYZ<T>& v,typename BasicXYZ<T>::Scalar k)
 {
-  XYZ ret(v);
+  BasicXYZ<T> ret(v);
   ret*=k;
   return ret;
 }
 
 //! Division by scalar.
-inline const XYZ operator/(const XYZ& v,real k)
+template <typename T> inline const BasicXYZ<T> operator/(const BasicXYZ<T>& v,typename BasicXYZ<T>::Scalar k)
 {
-  return v*(1.0/k);
+  return v*(T(1.0)/k);
 }
 
 //! Modulus all components by 1.0
-inline const XYZ modulusf(const XYZ& p)
+template <typename T> inline const BasicXYZ<T> modulusf(const BasicXYZ<T>& p)
 {
-  return XYZ
+  return BasicXYZ<T>
     (
-     modulusf(p.x(),1.0),
-     modulusf(p.y(),1.0),
-     modulusf(p.z(),1.0)
+     modulusf(p.x(),T(1.0)),
+     modulusf(p.y(),T(1.0)),
+     modulusf(p.z(),T(1.0))
      );
 }
 
 //! Componentwise modulus
-inline const XYZ modulusf(const XYZ& p,const XYZ& q)
+template <typename T> inline const BasicXYZ<T> modulusf(const BasicXYZ<T>& p,const BasicXYZ<T>& q)
 {
-  return XYZ
+  return BasicXYZ<T>
     (
      modulusf(p.x(),q.x()),
      modulusf(p.y(),q.y()),
@@ -262,13 +288,13 @@ inline const XYZ modulusf(const XYZ& p,const XYZ& q)
 
 /*! If magnitude is zero we return zero vector.
  */
-inline const XYZ XYZ::normalised() const
+template <typename T> inline const BasicXYZ<T> BasicXYZ<T>::normalised() const
 {
-  const real m=magnitude();
-  return (m==0.0 ? XYZ(0.0,0.0,0.0) : (*this)/m);
+  const T m=magnitude();
+  return (m==T(0.0) ? BasicXYZ(0.0,0.0,0.0) : (*this)/m);
 }
 
-inline void XYZ::normalise()
+template <typename T> inline void BasicXYZ<T>::normalise()
 {
   (*this)=normalised();
 }
@@ -276,11 +302,154 @@ inline void XYZ::normalise()
 //! Stream output operator.
 /*! Calls write().
  */
-inline std::ostream& operator<<(std::ostream& out,const XYZ& v)
+template <typename T> inline std::ostream& operator<<(std::ostream& out,const BasicXYZ<T>& v)
 {
   return v.write(out);
 }
 
+//! A block of points held structure-of-arrays: all the x components, then all the y, then all the z.
+/*! Arrays of XYZ interleave the components, so vector units can't load a whole lane of x components at once.
+  Here each plane starts on a 32 byte boundary and is padded to a whole number of 32 byte vectors,
+  and the planes are contiguous, so componentwise operations can treat the whole block as one array of 3*stride() scalars.
+  The padding is zeroed on allocation and otherwise carries whatever the operations on the block leave there.
+  The scalar type is a parameter so blocks can also be held in single precision;
+  instantiated for float and double (as XYZBlock).
+ */
+template <typename T> class BasicXYZBlock
+{
+ public:
+
+  //! The scalar type.
+  typedef T Scalar;
+
+  //! Empty block.
+  BasicXYZBlock();
+
+  //! Block of n points, all zero.
+  explicit BasicXYZBlock(size_t n);
+
+  //! Block holding a copy of n points from an array.
+  BasicXYZBlock(const BasicXYZ<T>* p,size_t n);
+
+  //! Copy constructor.
+  BasicXYZBlock(const BasicXYZBlock&);
+
+  //! Destructor.
+  ~BasicXYZBlock();
+
+  //! Assignment.
+  BasicXYZBlock& operator=(const BasicXYZBlock&);
+
+  //! Exchange contents with another block.
+  void swap(BasicXYZBlock&);
+
+  //! Number of points.
+  size_t size() const
+    {
+      return _size;
+    }
+
+  //! Distance in scalars between the start of successive planes (size() rounded up to whole vectors).
+  size_t stride() const
+    {
+      return _stride;
+    }
+
+  //! Change the number of points.  All points are zero afterwards.
+  void resize(size_t n);
+
+  //@{
+  //! Accessor for the start of the planes (3*stride() contiguous scalars).
+  T* data()
+    {
+      return _planes;
+    }
+  const T* data() const
+    {
+      return _planes;
+    }
+  //@}
+
+  //@{
+  //! Accessor for a single plane.
+  T* x() {return _planes;}
+  T* y() {return _planes+_stride;}
+  T* z() {return _planes+2*_stride;}
+  const T* x() const {return _planes;}
+  const T* y() const {return _planes+_stride;}
+  const T* z() const {return _planes+2*_stride;}
+  //@}
+
+  //! Gather a point.
+  const BasicXYZ<T> operator[](size_t i) const
+    {
+      assert(i<_size);
+      return BasicXYZ<T>(_planes[i],_planes[_stride+i],_planes[2*_stride+i]);
+    }
+
+  //! Scatter a point.
+  void set(size_t i,const BasicXYZ<T>& v)
+    {
+      assert(i<_size);
+      _planes[i]=v.x();
+      _planes[_stride+i]=v.y();
+      _planes[2*_stride+i]=v.z();
+    }
+
+  //! Resize to n and copy in n points from an array.
+  void assign(const BasicXYZ<T>* p,size_t n);
+
+  //! Resize to match and copy in the points of a block of another precision.
+  template <typename U> void assign(const BasicXYZBlock<U>& v)
+    {
+      resize(v.size());
+      for (size_t i=0;i<_size;i++)
+	{
+	  _planes[i]=v.x()[i];
+	  _planes[_stride+i]=v.y()[i];
+	  _planes[2*_stride+i]=v.z()[i];
+	}
+    }
+
+  //! Copy the points out to an array of size() points.
+  void copy_to(BasicXYZ<T>* p) const;
+
+  //! Set every point to v.
+  void fill(const BasicXYZ<T>& v);
+
+  //@{
+  //! Componentwise arithmetic over every point, with the same results as the BasicXYZ<T> operators (in the block's precision).
+  void operator+=(const BasicXYZBlock& v);
+  void operator-=(const BasicXYZBlock& v);
+  void operator+=(const BasicXYZ<T>& v);
+  void operator*=(real k);
+  void operator/=(real k);
+  //@}
+
+ private:
+
+  //! Number of points.
+  size_t _size;
+
+  //! Plane stride.
+  size_t _stride;
+
+  //! Largest stride the allocated storage can hold.
+  size_t _capacity;
+
+  //! Allocated storage (including slack for alignment).
+  T* _storage;
+
+  //! Aligned start of the x plane within _storage.
+  T* _planes;
+};
+
+//! Block of points in the usual precision.
+typedef BasicXYZBlock<real> XYZBlock;
+
+//! Block of points in single precision.
+typedef BasicXYZBlock<float> XYZfBlock;
+
 //! Generates a random point in the cube bounded by (0,0,0) and (1.0,1.0,1.0)
 class RandomXYZInUnitCube : public XYZ
 {
@@ -3,4 +3,4 @@ TEMPLATE = subdirs
 # See https://wiki.qt.io/SUBDIRS_-_handling_dependencies re parallelisation.
 CONFIG += ordered
 
-SUBDIRS = libfunction libevolvotron evolvotron evolvotron_render evolvotron_mutate
+SUBDIRS = libfunction libevolvotron evolvotron evolvotron_render evolvotron_mutate evolvotron_bench